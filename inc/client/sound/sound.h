@@ -33,6 +33,8 @@ void S_StartLocalSoundOnce(const char *s);
 void S_FreeAllSounds(void);
 void S_StopAllSounds(void);
 void S_Update(void);
+void S_SetListener(const vec3_t origin, const vec3_t forward,
+                   const vec3_t right, const vec3_t up);
 
 void S_Activate(void);
 
@@ -44,6 +46,7 @@ void S_EndRegistration(void);
 
 void S_RawSamples(int samples, int rate, int width, int channels, const void *data);
 int S_GetSampleRate(void);
+float S_GetMixerTime(void);
 bool S_SupportsFloat(void);
 void S_PauseRawSamples(bool paused);
 
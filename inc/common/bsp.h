@@ -123,6 +123,7 @@ typedef struct mnode_s {
     /* ======> */
     cplane_t            *plane;     // never NULL to differentiate from leafs
     struct mnode_s      *parent;
+    struct mlnode_s     *lnode;
 
 #if USE_REF
     vec3_t              mins;
@@ -151,10 +152,11 @@ typedef struct {
     unsigned            checkcount;         // to avoid repeated testings
 } mbrush_t;
 
-typedef struct {
+typedef struct mleaf_s {
     /* ======> */
     cplane_t            *plane;     // always NULL to differentiate from nodes
     struct mnode_s      *parent;
+    struct mlnode_s     *lnode;
 
 #if USE_REF
     vec3_t              mins;
@@ -174,6 +176,31 @@ typedef struct {
 #endif
 } mleaf_t;
 
+// compact copy of the tree for fast traversal, built at load time. nodes and
+// leafs are stored in depth-first order, so that the first child immediately
+// follows its parent. children are indices relative to the parent.
+typedef struct mlnode_s {
+    union {
+        struct {
+            vec3_t      normal;
+            float       dist;
+        };
+        const mleaf_t   *leaf;
+    };
+    int                 type;           // PLANE_X..PLANE_NON_AXIAL, -1 for leafs
+    int32_t             children[2];
+} mlnode_t;
+
+static inline vec_t BSP_PlaneDiff(const vec3_t v, const mlnode_t *node)
+{
+    // fast axial cases
+    if (node->type < 3)
+        return v[node->type] - node->dist;
+
+    // slow generic case
+    return PlaneDiff(v, node);
+}
+
 typedef struct {
     unsigned    portalnum;
     unsigned    otherarea;
@@ -255,6 +282,9 @@ typedef struct {
     int             numnodes;
     mnode_t         *nodes;
 
+    int             numlnodes;
+    mlnode_t        *lnodes;
+
     int             numleafs;
     mleaf_t         *leafs;
 
@@ -335,6 +365,7 @@ const lightgrid_sample_t *BSP_LookupLightgrid(const lightgrid_t *grid, const uin
 #endif
 
 void BSP_ClusterVis(const bsp_t *bsp, visrow_t *mask, int cluster, int vis);
+mlnode_t *BSP_LinearizeTree(mlnode_t *out, mnode_t *node);
 const mleaf_t *BSP_PointLeaf(const mnode_t *node, const vec3_t p);
 const mmodel_t *BSP_InlineModel(const bsp_t *bsp, const char *name);
 
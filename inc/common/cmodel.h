@@ -70,6 +70,14 @@ void        CM_BoxTrace(trace_t *trace,
                         const vec3_t mins, const vec3_t maxs,
                         const mnode_t *headnode, int brushmask,
                         bool extended);
+#if USE_TESTS
+// same as CM_BoxTrace, but walks pointer linked nodes instead of linear tree
+void        CM_BoxTraceNodes(trace_t *trace,
+                             const vec3_t start, const vec3_t end,
+                             const vec3_t mins, const vec3_t maxs,
+                             const mnode_t *headnode, int brushmask,
+                             bool extended);
+#endif
 void        CM_TransformedBoxTrace(trace_t *trace,
                                    const vec3_t start, const vec3_t end,
                                    const vec3_t mins, const vec3_t maxs,
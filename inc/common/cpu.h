@@ -0,0 +1,66 @@
+/*
+Copyright (C) 2024 Andrey Nazarov
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+//
+// cpu.h -- runtime CPU feature detection for SIMD code paths
+//
+
+#if (defined __i386__) || (defined __x86_64__) || (defined _M_IX86) || (defined _M_X64)
+#define CPU_X86     1
+#else
+#define CPU_X86     0
+#endif
+
+// SSE2 is part of the baseline on all supported x86 targets
+#if CPU_X86 && ((defined __SSE2__) || (defined _M_X64) || (defined _M_IX86_FP && _M_IX86_FP >= 2))
+#define USE_SSE2    1
+#else
+#define USE_SSE2    0
+#endif
+
+// AVX2 code is always compiled in, but needs runtime check
+#if CPU_X86 && ((defined __GNUC__) || (defined _MSC_VER))
+#define USE_AVX2    1
+#else
+#define USE_AVX2    0
+#endif
+
+// NEON is part of the baseline on AArch64
+#if (defined __ARM_NEON) || (defined _M_ARM64)
+#define USE_NEON    1
+#else
+#define USE_NEON    0
+#endif
+
+#if USE_AVX2 && (defined __GNUC__)
+#define q_target_avx2   __attribute__((target("avx2")))
+#else
+#define q_target_avx2
+#endif
+
+#define CPU_SSE2    BIT(0)
+#define CPU_AVX2    BIT(1)
+#define CPU_NEON    BIT(2)
+
+// returns CPU_* flags for SIMD extensions that are both compiled in and
+// supported by the CPU, masked by `sys_simd' cvar if it is registered
+unsigned    Com_GetCpuFeatures(void);
+const char  *Com_CpuFeatureString(unsigned features);
+void        Com_InitCpuFeatures(void);
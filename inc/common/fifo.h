@@ -24,6 +24,12 @@ typedef struct {
     size_t ax, ay, bs;
 } fifo_t;
 
+// contiguous region of FIFO memory for scatter/gather I/O
+typedef struct {
+    void *data;
+    size_t len;
+} fifo_vec_t;
+
 static inline void *FIFO_Reserve(fifo_t *fifo, size_t *len)
 {
     size_t tail;
@@ -118,3 +124,12 @@ static inline bool FIFO_TryWrite(fifo_t *fifo, void *buffer, size_t len)
 }
 
 bool FIFO_ReadMessage(fifo_t *fifo, size_t msglen);
+
+// These work like FIFO_Reserve/Commit and FIFO_Peek/Decommit, but return up
+// to 2 regions covering all free space or all pending data, and commit or
+// decommit across them. Return value is the number of non-empty regions.
+int FIFO_Reservev(fifo_t *fifo, fifo_vec_t vec[2]);
+void FIFO_Commitv(fifo_t *fifo, size_t len);
+int FIFO_Peekv(fifo_t *fifo, fifo_vec_t vec[2]);
+void FIFO_Decommitv(fifo_t *fifo, size_t len);
+bool FIFO_Writev(fifo_t *fifo, const fifo_vec_t *vec, int count);
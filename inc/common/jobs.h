@@ -0,0 +1,45 @@
+/*
+Copyright (C) 2024 Andrey Nazarov
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+//
+// jobs.h -- pool of worker threads for data parallel loops
+//
+
+#define MAX_JOB_THREADS     32
+
+// `thread' is 0 for the calling thread and 1..Com_JobThreads()-1 for
+// workers. Job functions run concurrently and must not call Com_Printf,
+// Com_Error, filesystem or zone functions.
+typedef void (*jobfunc_t)(void *arg, int index, int thread);
+
+// calls func for each index in [0, count) and waits for completion.
+// runs serially if there are no workers or the pool is already busy.
+void    Com_ParallelFor(jobfunc_t func, void *arg, int count);
+
+// returns the number of threads that may execute job functions
+int     Com_JobThreads(void);
+
+// job functions may call non-thread-safe code while holding this lock,
+// since the main thread itself is busy running jobs until they finish
+void    Com_LockJobs(void);
+void    Com_UnlockJobs(void);
+
+void    Com_InitJobs(void);
+void    Com_ShutdownJobs(void);
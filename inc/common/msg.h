@@ -103,7 +103,7 @@ typedef enum {
 extern sizebuf_t    msg_write;
 extern byte         msg_write_buffer[MAX_MSGLEN];
 
-extern sizebuf_t    msg_read;
+extern q_thread_local sizebuf_t msg_read;
 extern byte         msg_read_buffer[MAX_MSGLEN];
 
 extern const entity_packed_t    nullEntityState;
@@ -66,6 +66,10 @@ typedef struct {
 
     sizebuf_t   fragment_in;
     sizebuf_t   fragment_out;
+
+    // if set, outgoing datagrams are passed here instead of being sent
+    void        (*send_cb)(void *arg, const void *data, size_t len);
+    void        *send_arg;
 } netchan_t;
 
 extern cvar_t       *net_qport;
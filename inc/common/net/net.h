@@ -213,8 +213,13 @@ void        NET_UpdateStream(netstream_t *s);
 
 struct pollfd   *NET_AllocPollFd(void);
 void            NET_FreePollFd(struct pollfd *e);
+void            NET_SetPollFdData(struct pollfd *e, void *data);
+void            *NET_GetPollFdData(const struct pollfd *e);
+bool            NET_TracksReady(void);
+struct pollfd   *NET_NextReadyPollFd(int *iter);
 
 int         NET_Sleep(int msec);
+int         NET_SleepUntil(uint64_t deadline);
 #if USE_AC_SERVER
 int         NET_Sleep1(int msec, struct pollfd *e);
 #endif
@@ -110,6 +110,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define MAX_PACKET_ENTITIES     512
 #define MAX_PARSE_ENTITIES      (MAX_PACKET_ENTITIES * UPDATE_BACKUP)
 #define PARSE_ENTITIES_MASK     (MAX_PARSE_ENTITIES - 1)
+#define MAX_PARSE_STATES        (MAX_PARSE_ENTITIES * 2)
+#define PARSE_STATES_MASK       (MAX_PARSE_STATES - 1)
 
 #define MAX_PACKET_USERCMDS     32
 #define MAX_PACKET_FRAMES       4
@@ -207,6 +207,11 @@ void    R_BeginRegistration(const char *map);
 qhandle_t R_RegisterModel(const char *name);
 qhandle_t R_RegisterImage(const char *name, imagetype_t type,
                           imageflags_t flags);
+// images queued with R_PrefetchImage() are decoded in parallel by
+// R_FinishPrefetch(), so that following R_RegisterImage() calls only
+// need to upload them
+void    R_PrefetchImage(const char *name, imagetype_t type, imageflags_t flags);
+void    R_FinishPrefetch(void);
 void    R_SetSky(const char *name, float rotate, bool autorotate, const vec3_t axis);
 void    R_EndRegistration(void);
 
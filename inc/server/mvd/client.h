@@ -36,3 +36,5 @@ void MVD_GameClientNameChanged(edict_t *ent, const char *name);
 void MVD_StreamedStop_f(void);
 void MVD_StreamedRecord_f(void);
 void MVD_File_g(genctx_t *ctx);
+
+bool MVD_RelayGamestate(int id);
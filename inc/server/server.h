@@ -37,6 +37,7 @@ void SV_ErrorEvent(const netadr_t *from, int ee_errno, int ee_info);
 void SV_Init(void);
 void SV_Shutdown(const char *finalmsg, error_type_t type);
 unsigned SV_Frame(unsigned msec);
+uint64_t SV_FrameDeadline(void);
 #if USE_SYSCON
 void SV_SetConsoleTitle(void);
 #endif
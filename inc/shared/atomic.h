@@ -19,9 +19,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #ifdef _MSC_VER
+#include <intrin.h>
 typedef volatile int atomic_int;
 #define atomic_load(p)      (*(p))
 #define atomic_store(p, v)  (*(p) = (v))
+#define atomic_fetch_add(p, v)  _InterlockedExchangeAdd((volatile long *)(p), (v))
 #else
 #include <stdatomic.h>
 #endif
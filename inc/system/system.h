@@ -34,6 +34,7 @@ void    Sys_FreeLibrary(void *handle);
 void    *Sys_GetProcAddress(void *handle, const char *sym);
 
 unsigned    Sys_Milliseconds(void);
+uint64_t    Sys_Microseconds(void);
 void        Sys_Sleep(int msec);
 
 void    Sys_Init(void);
@@ -67,6 +68,7 @@ void    Sys_ListFiles_r(listfiles_t *list, const char *path, int depth);
 
 void    Sys_DebugBreak(void);
 bool    Sys_IsMainThread(void);
+int     Sys_GetNumCpus(void);
 
 #if USE_AC_CLIENT
 bool    Sys_GetAntiCheatAPI(void);
@@ -190,8 +190,13 @@ typedef struct {
 
     centity_state_t baselines[MAX_EDICTS];
 
-    centity_state_t entityStates[MAX_PARSE_ENTITIES];
+    // frames index entityRefs ring, which points into entityStates ring.
+    // unchanged entities share state with the previous frame instead of
+    // copying it, thus entityStates needs to be twice as large.
+    centity_state_t entityStates[MAX_PARSE_STATES];
     unsigned        numEntityStates;
+    unsigned        numStoredStates;
+    uint16_t        entityRefs[MAX_PARSE_ENTITIES];
 
     msgEsFlags_t    esFlags;
     msgPsFlags_t    psFlags;
@@ -412,11 +417,18 @@ typedef struct {
 #define R_FRAMES    cls.measure.frames[1]
 #define M_FRAMES    cls.measure.frames[2]
 #define P_FRAMES    cls.measure.frames[3]
+#define T_MAIN  0
+#define T_REF   1
+#define T_SOUND 2
+#define T_MIXER 3
     struct {
         unsigned    time;
         int         frames[4];
         int         fps[4];
         int         ping;
+        uint64_t    usec[3];            // time spent in main/refresh/sound phases
+        int         samples[3];
+        float       msec[4];            // averages, in milliseconds
     } measure;
 
 // connection information
@@ -1009,6 +1021,7 @@ void    SCR_ClearCenterPrints(void);
 void    SCR_BeginLoadingPlaque(void);
 void    SCR_EndLoadingPlaque(void);
 void    SCR_RegisterMedia(void);
+void    SCR_ClearLayoutCache(void);
 void    SCR_ModeChanged(void);
 void    SCR_LagSample(void);
 void    SCR_LagClear(void);
@@ -107,7 +107,7 @@ static void emit_packet_entities(const server_frame_t *from, const server_frame_
             newnum = MAX_EDICTS;
         } else {
             i = (to->firstEntity + newindex) & PARSE_ENTITIES_MASK;
-            newent = &cl.entityStates[i];
+            newent = &cl.entityStates[cl.entityRefs[i]];
             newnum = newent->number;
         }
 
@@ -115,11 +115,18 @@ static void emit_packet_entities(const server_frame_t *from, const server_frame_
             oldnum = MAX_EDICTS;
         } else {
             i = (from->firstEntity + oldindex) & PARSE_ENTITIES_MASK;
-            oldent = &cl.entityStates[i];
+            oldent = &cl.entityStates[cl.entityRefs[i]];
             oldnum = oldent->number;
         }
 
         if (newnum == oldnum) {
+            // Shared state means entity is unchanged, skip packing it.
+            if (newent == oldent && newnum > cl.maxclients) {
+                oldindex++;
+                newindex++;
+                continue;
+            }
+
             // Delta update from old position. Because the force param is false,
             // this will not result in any bytes being emitted if the entity has
             // not changed at all. Note that players are always 'newentities',
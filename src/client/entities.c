@@ -403,13 +403,13 @@ void CL_DeltaFrame(void)
     // set current and prev, unpack solid, etc
     for (i = 0; i < cl.frame.numEntities; i++) {
         j = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
-        parse_entity_update(&cl.entityStates[j]);
+        parse_entity_update(&cl.entityStates[cl.entityRefs[j]]);
     }
 
     // fire events. due to footstep tracing this must be after updating entities.
     for (i = 0; i < cl.frame.numEntities; i++) {
         j = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
-        parse_entity_event(cl.entityStates[j].number);
+        parse_entity_event(cl.entityStates[cl.entityRefs[j]].number);
     }
 
     if (cls.demo.recording && !cls.demo.paused && !cls.demo.seeking && CL_FRAMESYNC) {
@@ -524,7 +524,7 @@ static void CL_AddPacketEntities(void)
 
     for (pnum = 0; pnum < cl.frame.numEntities; pnum++) {
         i = (cl.frame.firstEntity + pnum) & PARSE_ENTITIES_MASK;
-        s1 = &cl.entityStates[i];
+        s1 = &cl.entityStates[cl.entityRefs[i]];
 
         cent = &cl_entities[s1->number];
 
@@ -1481,10 +1481,7 @@ void CL_CalcViewValues(void)
 
     VectorAdd(cl.refdef.vieworg, viewoffset, cl.refdef.vieworg);
 
-    VectorCopy(cl.refdef.vieworg, listener_origin);
-    VectorCopy(cl.v_forward, listener_forward);
-    VectorCopy(cl.v_right, listener_right);
-    VectorCopy(cl.v_up, listener_up);
+    S_SetListener(cl.refdef.vieworg, cl.v_forward, cl.v_right, cl.v_up);
 }
 
 /*
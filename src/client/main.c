@@ -3013,6 +3013,17 @@ static void CL_MeasureStats(void)
         cls.measure.frames[i] = 0;
     }
 
+    // measure average time per frame of each phase
+    for (i = 0; i < 3; i++) {
+        int samples = cls.measure.samples[i];
+        cls.measure.msec[i] = samples ? cls.measure.usec[i] * 0.001f / samples : 0;
+        cls.measure.usec[i] = 0;
+        cls.measure.samples[i] = 0;
+    }
+
+    // mixer thread runs on its own, this is average time per mix
+    cls.measure.msec[T_MIXER] = S_GetMixerTime();
+
     cls.measure.time = com_localTime;
 }
 
@@ -3222,6 +3233,15 @@ void CL_UpdateFrameTimes(void)
                  __func__, sync_names[sync_mode], main_msec, ref_msec, phys_msec);
 }
 
+static uint64_t CL_MeasureTime(int which, uint64_t start)
+{
+    uint64_t usec = Sys_Microseconds() - start;
+
+    cls.measure.usec[which] += usec;
+    cls.measure.samples[which]++;
+    return usec;
+}
+
 /*
 ==================
 CL_Frame
@@ -3231,6 +3251,7 @@ CL_Frame
 unsigned CL_Frame(unsigned msec)
 {
     bool phys_frame = true, ref_frame = true;
+    uint64_t frame_start, start, other = 0;
 
     time_after_ref = time_before_ref = 0;
 
@@ -3241,6 +3262,8 @@ unsigned CL_Frame(unsigned msec)
     main_extra += msec;
     cls.realtime += msec;
 
+    frame_start = Sys_Microseconds();
+
     CL_ProcessEvents();
 
     switch (sync_mode) {
@@ -3356,7 +3379,9 @@ unsigned CL_Frame(unsigned msec)
         if (host_speeds->integer)
             time_before_ref = Sys_Milliseconds();
 
+        start = Sys_Microseconds();
         SCR_UpdateScreen();
+        other += CL_MeasureTime(T_REF, start);
 
         if (host_speeds->integer)
             time_after_ref = Sys_Milliseconds();
@@ -3367,11 +3392,15 @@ unsigned CL_Frame(unsigned msec)
         R_FRAMES++;
 
         // update audio after the 3D view was drawn
+        start = Sys_Microseconds();
         S_Update();
+        other += CL_MeasureTime(T_SOUND, start);
     } else if (sync_mode == SYNC_SLEEP_10) {
         // force audio and effects update if not rendering
         CL_CalcViewValues();
+        start = Sys_Microseconds();
         S_Update();
+        other += CL_MeasureTime(T_SOUND, start);
     }
 
     // check connection timeout
@@ -3379,6 +3408,10 @@ unsigned CL_Frame(unsigned msec)
 
     C_FRAMES++;
 
+    // main phase is the rest of the frame
+    cls.measure.usec[T_MAIN] += Sys_Microseconds() - frame_start - other;
+    cls.measure.samples[T_MAIN]++;
+
     CL_MeasureStats();
 
     main_extra = 0;
@@ -34,16 +34,34 @@ static void CL_ParseDeltaEntity(server_frame_t           *frame,
                                 uint64_t                 bits)
 {
     centity_state_t     *state;
+    uint16_t            *ref;
+    unsigned            index;
 
     // suck up to MAX_EDICTS for servers that don't cap at MAX_PACKET_ENTITIES
     if (frame->numEntities >= cl.csr.max_edicts) {
         Com_Error(ERR_DROP, "%s: too many entities", __func__);
     }
 
-    state = &cl.entityStates[cl.numEntityStates & PARSE_ENTITIES_MASK];
+    ref = &cl.entityRefs[cl.numEntityStates & PARSE_ENTITIES_MASK];
     cl.numEntityStates++;
     frame->numEntities++;
 
+    // unchanged entity from the old frame can share its state, unless
+    // shuffling origin below would modify it. state must be recent enough
+    // to never be overwritten while any frame referencing it is valid.
+    if (!bits && old != &cl.baselines[newnum]) {
+        index = old - cl.entityStates;
+        if (((cl.numStoredStates - index) & PARSE_STATES_MASK) < MAX_PARSE_ENTITIES &&
+            (old->renderfx & RF_BEAM || VectorCompare(old->origin, old->old_origin))) {
+            *ref = index;
+            return;
+        }
+    }
+
+    index = cl.numStoredStates++ & PARSE_STATES_MASK;
+    state = &cl.entityStates[index];
+    *ref = index;
+
 #if USE_DEBUG
     if (cl_shownet->integer >= 3 && bits) {
         MSG_ShowDeltaEntityBits(bits);
@@ -92,7 +110,7 @@ static void CL_ParsePacketEntities(const server_frame_t *oldframe, server_frame_
             oldnum = MAX_EDICTS;
         } else {
             i = (oldframe->firstEntity + oldindex) & PARSE_ENTITIES_MASK;
-            oldstate = &cl.entityStates[i];
+            oldstate = &cl.entityStates[cl.entityRefs[i]];
             oldnum = oldstate->number;
         }
     }
@@ -121,7 +139,7 @@ static void CL_ParsePacketEntities(const server_frame_t *oldframe, server_frame_
                 oldnum = MAX_EDICTS;
             } else {
                 i = (oldframe->firstEntity + oldindex) & PARSE_ENTITIES_MASK;
-                oldstate = &cl.entityStates[i];
+                oldstate = &cl.entityStates[cl.entityRefs[i]];
                 oldnum = oldstate->number;
             }
         }
@@ -142,7 +160,7 @@ static void CL_ParsePacketEntities(const server_frame_t *oldframe, server_frame_
                 oldnum = MAX_EDICTS;
             } else {
                 i = (oldframe->firstEntity + oldindex) & PARSE_ENTITIES_MASK;
-                oldstate = &cl.entityStates[i];
+                oldstate = &cl.entityStates[cl.entityRefs[i]];
                 oldnum = oldstate->number;
             }
             continue;
@@ -162,7 +180,7 @@ static void CL_ParsePacketEntities(const server_frame_t *oldframe, server_frame_
                 oldnum = MAX_EDICTS;
             } else {
                 i = (oldframe->firstEntity + oldindex) & PARSE_ENTITIES_MASK;
-                oldstate = &cl.entityStates[i];
+                oldstate = &cl.entityStates[cl.entityRefs[i]];
                 oldnum = oldstate->number;
             }
             continue;
@@ -191,7 +209,7 @@ static void CL_ParsePacketEntities(const server_frame_t *oldframe, server_frame_
             oldnum = MAX_EDICTS;
         } else {
             i = (oldframe->firstEntity + oldindex) & PARSE_ENTITIES_MASK;
-            oldstate = &cl.entityStates[i];
+            oldstate = &cl.entityStates[cl.entityRefs[i]];
             oldnum = oldstate->number;
         }
     }
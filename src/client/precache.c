@@ -323,22 +323,34 @@ CL_RegisterImage
 Hack to handle RF_CUSTOMSKIN for remaster
 =================
 */
-static qhandle_t CL_RegisterImage(const char *s)
+static imagetype_t CL_ImageType(const char *s, imageflags_t *flags)
 {
+    *flags = IF_NONE;
+
     // if it's in a subdir and has an extension, it's either a sprite or a skin
     // allow /some/pic.pcx escape syntax
     if (cl.csr.extended && *s != '/' && *s != '\\' && *COM_FileExtension(s)) {
-        if (!FS_pathcmpn(s, CONST_STR_LEN("sprites/psx_flare")))
-            return R_RegisterImage(s, IT_SPRITE, IF_DEFAULT_FLARE);
+        if (!FS_pathcmpn(s, CONST_STR_LEN("sprites/psx_flare"))) {
+            *flags = IF_DEFAULT_FLARE;
+            return IT_SPRITE;
+        }
 
         if (!FS_pathcmpn(s, CONST_STR_LEN("sprites/")))
-            return R_RegisterSprite(s);
+            return IT_SPRITE;
 
         if (strchr(s, '/'))
-            return R_RegisterSkin(s);
+            return IT_SKIN;
     }
 
-    return R_RegisterTempPic(s);
+    return IT_PIC;
+}
+
+static qhandle_t CL_RegisterImage(const char *s)
+{
+    imageflags_t flags;
+    imagetype_t type = CL_ImageType(s, &flags);
+
+    return R_RegisterImage(s, type, flags);
 }
 
 /*
@@ -377,6 +389,19 @@ void CL_PrepRefresh(void)
     }
 
     CL_LoadState(LOAD_IMAGES);
+    for (i = 1; i < cl.csr.max_images; i++) {
+        imageflags_t flags;
+        imagetype_t type;
+
+        name = cl.configstrings[cl.csr.images + i];
+        if (!name[0]) {
+            break;
+        }
+        type = CL_ImageType(name, &flags);
+        R_PrefetchImage(name, type, flags);
+    }
+    R_FinishPrefetch();
+
     for (i = 1; i < cl.csr.max_images; i++) {
         name = cl.configstrings[cl.csr.images + i];
         if (!name[0]) {
@@ -401,6 +426,7 @@ void CL_PrepRefresh(void)
 
     // the renderer can now free unneeded stuff
     R_EndRegistration();
+    SCR_ClearLayoutCache();
 
     // clear any lines of console text
     Con_ClearNotify_f();
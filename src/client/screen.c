@@ -57,6 +57,7 @@ static cvar_t   *scr_showpause;
 #if USE_DEBUG
 static cvar_t   *scr_showstats;
 static cvar_t   *scr_showpmove;
+static cvar_t   *scr_showtimes;
 #endif
 static cvar_t   *scr_showturtle;
 
@@ -1060,19 +1061,26 @@ static void SCR_DrawTurtle(void)
 
 static void SCR_DrawDebugStats(void)
 {
+    static const char names[4][5] = { "main", "ref", "snd", "mix" };
     char buffer[MAX_QPATH];
-    int i, j;
+    int i, j, k;
     int x, y;
 
-    j = scr_showstats->integer;
-    if (j <= 0)
+    j = Q_clip(scr_showstats->integer, 0, cl.max_stats);
+    k = scr_showtimes->integer ? 4 : 0;
+    if (!j && !k)
         return;
 
-    if (j > cl.max_stats)
-        j = cl.max_stats;
-
     x = CONCHAR_WIDTH;
-    y = (scr.hud_height - j * CONCHAR_HEIGHT) / 2;
+    y = (scr.hud_height - (j + k) * CONCHAR_HEIGHT) / 2;
+
+    // average time of frame phases and of mixer thread
+    for (i = 0; i < k; i++) {
+        Q_snprintf(buffer, sizeof(buffer), "%-4s %6.2f ms", names[i], cls.measure.msec[i]);
+        R_DrawString(x, y, 0, MAX_STRING_CHARS, buffer, scr.font_pic);
+        y += CONCHAR_HEIGHT;
+    }
+
     for (i = 0; i < j; i++) {
         Q_snprintf(buffer, sizeof(buffer), "%2d: %d", i, cl.frame.ps.stats[i]);
         if (cl.oldframe.ps.stats[i] != cl.frame.ps.stats[i]) {
@@ -1374,6 +1382,8 @@ void SCR_RegisterMedia(void)
 
     scr_crosshair_changed(scr_crosshair);
     scr_font_changed(scr_font);
+
+    SCR_ClearLayoutCache();
 }
 
 static void scr_scale_changed(cvar_t *self)
@@ -1455,6 +1465,7 @@ void SCR_Init(void)
 #if USE_DEBUG
     scr_showstats = Cvar_Get("scr_showstats", "0", 0);
     scr_showpmove = Cvar_Get("scr_showpmove", "0", 0);
+    scr_showtimes = Cvar_Get("scr_showtimes", "0", 0);
 #endif
 
     scr_hit_marker_time = Cvar_Get("scr_hit_marker_time", "500", 0);
@@ -1693,140 +1704,416 @@ static void SCR_DrawInventory(void)
     }
 }
 
-static void SCR_SkipToEndif(const char **s)
+static void SCR_DrawHealthBar(int x, int y, int value)
 {
-    int i, skip = 1;
-    char *token;
+    if (!value)
+        return;
+
+    int bar_width = scr.hud_width / 3;
+    float percent = (value - 1) / 254.0f;
+    int w = bar_width * percent + 0.5f;
+    int h = CONCHAR_HEIGHT / 2;
+
+    x -= bar_width / 2;
+    R_DrawFill8(x, y, w, h, 240);
+    R_DrawFill8(x + w, y, bar_width - w, h, 4);
+}
+
+/*
+Layout strings are compiled into a program when they change. Each token gets
+an instruction that consumes it along with its arguments, so that `if' can
+resume execution at any token exactly like the original text interpreter.
+Arguments are parsed, stat and client indices validated and named pics
+registered once at compile time.
+*/
+
+typedef enum {
+    LOP_NOP,
+    LOP_ERROR,
+    LOP_XL,
+    LOP_XR,
+    LOP_XV,
+    LOP_YT,
+    LOP_YB,
+    LOP_YV,
+    LOP_PIC,
+    LOP_CLIENT,
+    LOP_CTF,
+    LOP_PICN,
+    LOP_NUM,
+    LOP_HNUM,
+    LOP_ANUM,
+    LOP_RNUM,
+    LOP_STAT_STRING,
+    LOP_STRING,
+    LOP_IF,
+    LOP_COLOR,
+    LOP_HEALTH_BARS,
+} layoutopcode_t;
+
+typedef enum {
+    LSTR_NONE = -1,
+    LSTR_STRING,
+    LSTR_STRING2,
+    LSTR_CSTRING,
+    LSTR_CSTRING2,
+    LSTR_RSTRING,
+    LSTR_RSTRING2,
+} layoutstring_t;
+
+typedef struct {
+    uint8_t     opcode;
+    int8_t      mode;           // layoutstring_t
+    uint16_t    next;           // next instruction
+    uint16_t    skip;           // LOP_IF: next instruction when false
+    int         args[6];
+    const char  *string;        // string argument or error message
+    qhandle_t   pic;
+    color_t     color;
+} layoutop_t;
+
+typedef struct {
+    char        *source;
+    bool        extended;
+    int         max_stats;
+    int         numtokens;
+    layoutop_t  *ops;
+} layoutprog_t;
+
+static layoutprog_t     scr_statusbar_prog;
+static layoutprog_t     scr_layout_prog;
+
+static const char *const layout_strings[] = {
+    "string", "string2", "cstring", "cstring2", "rstring", "rstring2"
+};
+
+static layoutstring_t SCR_LayoutStringMode(const char *s)
+{
+    for (int i = 0; i < q_countof(layout_strings); i++)
+        if (!strcmp(s, layout_strings[i]))
+            return i;
+
+    return LSTR_NONE;
+}
+
+static void SCR_DrawLayoutString(int x, int y, layoutstring_t mode, const char *s)
+{
+    switch (mode) {
+    case LSTR_STRING:
+        HUD_DrawString(x, y, s);
+        break;
+    case LSTR_STRING2:
+        HUD_DrawAltString(x, y, s);
+        break;
+    case LSTR_CSTRING:
+        HUD_DrawCenterString(x + 320 / 2, y, s);
+        break;
+    case LSTR_CSTRING2:
+        HUD_DrawAltCenterString(x + 320 / 2, y, s);
+        break;
+    case LSTR_RSTRING:
+        HUD_DrawRightString(x, y, s);
+        break;
+    case LSTR_RSTRING2:
+        HUD_DrawAltRightString(x, y, s);
+        break;
+    default:
+        break;
+    }
+}
+
+// find the token execution continues at when `if' condition is false
+static int SCR_FindEndif(char **tokens, int numtokens, int i, bool extended)
+{
+    int skip = 1;
+
+    if (!extended) {
+        // skip to the first `endif' token, starting with `if' argument
+        for (i++; i < numtokens; i++)
+            if (!strcmp(tokens[i], "endif"))
+                return i + 1;
+        return numtokens;
+    }
+
+    for (i += 2; i < numtokens; ) {
+        const char *token = tokens[i++];
 
-    while (*s) {
-        token = COM_Parse(s);
         if (!strcmp(token, "xl") || !strcmp(token, "xr") || !strcmp(token, "xv") ||
             !strcmp(token, "yt") || !strcmp(token, "yb") || !strcmp(token, "yv") ||
             !strcmp(token, "pic") || !strcmp(token, "picn") || !strcmp(token, "color") ||
             strstr(token, "string")) {
-            COM_SkipToken(s);
+            i += 1;
             continue;
         }
 
         if (!strcmp(token, "client")) {
-            for (i = 0; i < 6; i++)
-                COM_SkipToken(s);
+            i += 6;
             continue;
         }
 
         if (!strcmp(token, "ctf")) {
-            for (i = 0; i < 5; i++)
-                COM_SkipToken(s);
+            i += 5;
             continue;
         }
 
         if (!strcmp(token, "num") || !strcmp(token, "health_bars")) {
-            COM_SkipToken(s);
-            COM_SkipToken(s);
+            i += 2;
             continue;
         }
 
-        if (!strcmp(token, "hnum")) continue;
-        if (!strcmp(token, "anum")) continue;
-        if (!strcmp(token, "rnum")) continue;
-
         if (!strcmp(token, "if")) {
-            COM_SkipToken(s);
+            i += 1;
             skip++;
             continue;
         }
 
-        if (!strcmp(token, "endif")) {
-            if (--skip > 0)
-                continue;
-            return;
+        if (!strcmp(token, "endif") && --skip == 0)
+            return min(i, numtokens);
+    }
+
+    return numtokens;
+}
+
+#define LAYOUT_ERROR(msg) \
+    do { op->opcode = LOP_ERROR; op->string = msg; } while (0)
+
+static void SCR_CompileLayoutOp(layoutprog_t *prog, char **tokens, int i)
+{
+    static const char empty[1];
+    layoutop_t *op = &prog->ops[i];
+    const char *token = tokens[i];
+    int argc = 0;
+
+#define ARG(n)  (i + 1 + (n) < prog->numtokens ? tokens[i + 1 + (n)] : empty)
+
+    if (token[0] && token[1] && !token[2]) {
+        static const char xy[6][3] = { "xl", "xr", "xv", "yt", "yb", "yv" };
+        for (int j = 0; j < 6; j++) {
+            if (!strcmp(token, xy[j])) {
+                op->opcode = LOP_XL + j;
+                op->args[0] = Q_atoi(ARG(0));
+                argc = 1;
+                goto done;
+            }
         }
     }
+
+    if (!strcmp(token, "pic")) {
+        op->opcode = LOP_PIC;
+        op->args[0] = Q_atoi(ARG(0));
+        if (op->args[0] < 0 || op->args[0] >= cl.max_stats)
+            LAYOUT_ERROR("invalid stat index");
+        argc = 1;
+        goto done;
+    }
+
+    if (!strcmp(token, "client") || !strcmp(token, "ctf")) {
+        op->opcode = token[1] == 'l' ? LOP_CLIENT : LOP_CTF;
+        argc = op->opcode == LOP_CLIENT ? 6 : 5;
+        for (int j = 0; j < argc; j++)
+            op->args[j] = Q_atoi(ARG(j));
+        if (op->args[2] < 0 || op->args[2] >= MAX_CLIENTS)
+            LAYOUT_ERROR("invalid client index");
+        goto done;
+    }
+
+    if (!strcmp(token, "picn")) {
+        op->opcode = LOP_PICN;
+        op->pic = R_RegisterTempPic(ARG(0));
+        argc = 1;
+        goto done;
+    }
+
+    if (!strcmp(token, "num")) {
+        op->opcode = LOP_NUM;
+        op->args[0] = Q_atoi(ARG(0));
+        op->args[1] = Q_atoi(ARG(1));
+        if (op->args[1] < 0 || op->args[1] >= cl.max_stats)
+            LAYOUT_ERROR("invalid stat index");
+        argc = 2;
+        goto done;
+    }
+
+    if (!strcmp(token, "hnum")) {
+        op->opcode = LOP_HNUM;
+        goto done;
+    }
+
+    if (!strcmp(token, "anum")) {
+        op->opcode = LOP_ANUM;
+        goto done;
+    }
+
+    if (!strcmp(token, "rnum")) {
+        op->opcode = LOP_RNUM;
+        goto done;
+    }
+
+    if (!strncmp(token, "stat_", 5)) {
+        op->opcode = LOP_STAT_STRING;
+        op->mode = SCR_LayoutStringMode(token + 5);
+        op->args[0] = Q_atoi(ARG(0));
+        if (op->args[0] < 0 || op->args[0] >= cl.max_stats)
+            LAYOUT_ERROR("invalid stat index");
+        argc = 1;
+        goto done;
+    }
+
+    op->mode = SCR_LayoutStringMode(token);
+    if (op->mode != LSTR_NONE) {
+        op->opcode = LOP_STRING;
+        op->string = ARG(0);
+        argc = 1;
+        goto done;
+    }
+
+    if (!strcmp(token, "if")) {
+        op->opcode = LOP_IF;
+        op->args[0] = Q_atoi(ARG(0));
+        if (op->args[0] < 0 || op->args[0] >= cl.max_stats)
+            LAYOUT_ERROR("invalid stat index");
+        op->skip = SCR_FindEndif(tokens, prog->numtokens, i, prog->extended);
+        argc = 1;
+        goto done;
+    }
+
+    // Q2PRO extension
+    if (!strcmp(token, "color")) {
+        op->opcode = LOP_COLOR;
+        if (!SCR_ParseColor(ARG(0), &op->color))
+            op->opcode = LOP_NOP;
+        argc = 1;
+        goto done;
+    }
+
+    if (!strcmp(token, "health_bars")) {
+        op->opcode = LOP_HEALTH_BARS;
+        op->args[0] = Q_atoi(ARG(0));
+        op->args[1] = Q_atoi(ARG(1));
+        if (op->args[0] < 0 || op->args[0] >= cl.max_stats)
+            LAYOUT_ERROR("invalid stat index");
+        else if (op->args[1] < 0 || op->args[1] >= cl.csr.end)
+            LAYOUT_ERROR("invalid string index");
+        argc = 2;
+        goto done;
+    }
+
+done:
+    op->next = min(i + 1 + argc, prog->numtokens);
+
+#undef ARG
 }
 
-static void SCR_DrawHealthBar(int x, int y, int value)
+#undef LAYOUT_ERROR
+
+static void SCR_FreeLayoutProgram(layoutprog_t *prog)
 {
-    if (!value)
-        return;
+    Z_Free(prog->source);
+    Z_Free(prog->ops);
+    memset(prog, 0, sizeof(*prog));
+}
 
-    int bar_width = scr.hud_width / 3;
-    float percent = (value - 1) / 254.0f;
-    int w = bar_width * percent + 0.5f;
-    int h = CONCHAR_HEIGHT / 2;
+static void SCR_CompileLayoutProgram(layoutprog_t *prog, const char *s)
+{
+    char        **tokens;
+    char        *strings, *p;
+    const char  *data;
+    size_t      len, size;
+    int         i;
+
+    SCR_FreeLayoutProgram(prog);
+
+    len = strlen(s);
+    prog->source = Z_CopyString(s);
+    prog->extended = cl.csr.extended;
+    prog->max_stats = cl.max_stats;
+
+    // each token needs at most its length plus terminator, and is
+    // separated from the next one by at least one character
+    size = len + 1;
+    prog->ops = Z_Mallocz(sizeof(prog->ops[0]) * (len / 2 + 1) + size);
+    strings = p = (char *)(prog->ops + len / 2 + 1);
+    tokens = Z_Malloc(sizeof(tokens[0]) * (len / 2 + 1));
+
+    // tokenize the same way COM_Parse does, including truncation
+    data = s;
+    while (1) {
+        char buffer[MAX_TOKEN_CHARS];
 
-    x -= bar_width / 2;
-    R_DrawFill8(x, y, w, h, 240);
-    R_DrawFill8(x + w, y, bar_width - w, h, 4);
+        COM_ParseToken(&data, buffer, sizeof(buffer));
+        if (!data)
+            break;
+        tokens[prog->numtokens++] = p;
+        p += Q_strlcpy(p, buffer, size - (p - strings)) + 1;
+    }
+
+    for (i = 0; i < prog->numtokens; i++)
+        SCR_CompileLayoutOp(prog, tokens, i);
+
+    Z_Free(tokens);
 }
 
-static void SCR_ExecuteLayoutString(const char *s)
+static void SCR_ExecuteLayoutProgram(layoutprog_t *prog, const char *s)
 {
-    char    buffer[MAX_QPATH];
-    int     x, y;
-    int     value;
-    char    *token;
-    int     width;
-    int     index;
+    char        buffer[MAX_QPATH];
+    int         x, y;
+    int         value;
+    const char  *token;
+    int         index, color;
+    int         i, next;
     clientinfo_t    *ci;
+    const layoutop_t    *op;
 
     if (!s[0])
         return;
 
+    // recompile if source or protocol parameters changed
+    if (!prog->source || strcmp(prog->source, s) ||
+        prog->extended != cl.csr.extended || prog->max_stats != cl.max_stats)
+        SCR_CompileLayoutProgram(prog, s);
+
     x = 0;
     y = 0;
 
-    while (s) {
-        token = COM_Parse(&s);
-        if (token[2] == 0) {
-            if (token[0] == 'x') {
-                if (token[1] == 'l') {
-                    token = COM_Parse(&s);
-                    x = Q_atoi(token);
-                    continue;
-                }
+    for (i = 0; i < prog->numtokens; i = next) {
+        op = &prog->ops[i];
+        next = op->next;
 
-                if (token[1] == 'r') {
-                    token = COM_Parse(&s);
-                    x = scr.hud_width + Q_atoi(token);
-                    continue;
-                }
+        switch (op->opcode) {
+        case LOP_NOP:
+            break;
 
-                if (token[1] == 'v') {
-                    token = COM_Parse(&s);
-                    x = scr.hud_width / 2 - 160 + Q_atoi(token);
-                    continue;
-                }
-            }
+        case LOP_ERROR:
+            Com_Error(ERR_DROP, "%s: %s", __func__, op->string);
+            break;
 
-            if (token[0] == 'y') {
-                if (token[1] == 't') {
-                    token = COM_Parse(&s);
-                    y = Q_atoi(token);
-                    continue;
-                }
+        case LOP_XL:
+            x = op->args[0];
+            break;
 
-                if (token[1] == 'b') {
-                    token = COM_Parse(&s);
-                    y = scr.hud_height + Q_atoi(token);
-                    continue;
-                }
+        case LOP_XR:
+            x = scr.hud_width + op->args[0];
+            break;
 
-                if (token[1] == 'v') {
-                    token = COM_Parse(&s);
-                    y = scr.hud_height / 2 - 120 + Q_atoi(token);
-                    continue;
-                }
-            }
-        }
+        case LOP_XV:
+            x = scr.hud_width / 2 - 160 + op->args[0];
+            break;
+
+        case LOP_YT:
+            y = op->args[0];
+            break;
+
+        case LOP_YB:
+            y = scr.hud_height + op->args[0];
+            break;
 
-        if (!strcmp(token, "pic")) {
+        case LOP_YV:
+            y = scr.hud_height / 2 - 120 + op->args[0];
+            break;
+
+        case LOP_PIC:
             // draw a pic from a stat number
-            token = COM_Parse(&s);
-            value = Q_atoi(token);
-            if (value < 0 || value >= cl.max_stats) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            value = cl.frame.ps.stats[value];
+            value = cl.frame.ps.stats[op->args[0]];
             if (value < 0 || value >= cl.csr.max_images) {
                 Com_Error(ERR_DROP, "%s: invalid pic index", __func__);
             }
@@ -1847,110 +2134,57 @@ static void SCR_ExecuteLayoutString(const char *s)
                     R_DrawPic(x, y, pic);
                 }
             }
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "client")) {
+        case LOP_CLIENT:
             // draw a deathmatch client block
-            int     score, ping, time;
-
-            token = COM_Parse(&s);
-            x = scr.hud_width / 2 - 160 + Q_atoi(token);
-            token = COM_Parse(&s);
-            y = scr.hud_height / 2 - 120 + Q_atoi(token);
-
-            token = COM_Parse(&s);
-            value = Q_atoi(token);
-            if (value < 0 || value >= MAX_CLIENTS) {
-                Com_Error(ERR_DROP, "%s: invalid client index", __func__);
-            }
-            ci = &cl.clientinfo[value];
-
-            token = COM_Parse(&s);
-            score = Q_atoi(token);
-
-            token = COM_Parse(&s);
-            ping = Q_atoi(token);
-
-            token = COM_Parse(&s);
-            time = Q_atoi(token);
+            x = scr.hud_width / 2 - 160 + op->args[0];
+            y = scr.hud_height / 2 - 120 + op->args[1];
+            ci = &cl.clientinfo[op->args[2]];
 
             HUD_DrawAltString(x + 32, y, ci->name);
             HUD_DrawString(x + 32, y + CONCHAR_HEIGHT, "Score: ");
-            Q_snprintf(buffer, sizeof(buffer), "%i", score);
+            Q_snprintf(buffer, sizeof(buffer), "%i", op->args[3]);
             HUD_DrawAltString(x + 32 + 7 * CONCHAR_WIDTH, y + CONCHAR_HEIGHT, buffer);
-            Q_snprintf(buffer, sizeof(buffer), "Ping:  %i", ping);
+            Q_snprintf(buffer, sizeof(buffer), "Ping:  %i", op->args[4]);
             HUD_DrawString(x + 32, y + 2 * CONCHAR_HEIGHT, buffer);
-            Q_snprintf(buffer, sizeof(buffer), "Time:  %i", time);
+            Q_snprintf(buffer, sizeof(buffer), "Time:  %i", op->args[5]);
             HUD_DrawString(x + 32, y + 3 * CONCHAR_HEIGHT, buffer);
 
             if (!ci->icon) {
                 ci = &cl.baseclientinfo;
             }
             R_DrawPic(x, y, ci->icon);
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "ctf")) {
+        case LOP_CTF:
             // draw a ctf client block
-            int     score, ping;
-
-            token = COM_Parse(&s);
-            x = scr.hud_width / 2 - 160 + Q_atoi(token);
-            token = COM_Parse(&s);
-            y = scr.hud_height / 2 - 120 + Q_atoi(token);
-
-            token = COM_Parse(&s);
-            value = Q_atoi(token);
-            if (value < 0 || value >= MAX_CLIENTS) {
-                Com_Error(ERR_DROP, "%s: invalid client index", __func__);
-            }
-            ci = &cl.clientinfo[value];
-
-            token = COM_Parse(&s);
-            score = Q_atoi(token);
-
-            token = COM_Parse(&s);
-            ping = Q_atoi(token);
-            if (ping > 999)
-                ping = 999;
+            x = scr.hud_width / 2 - 160 + op->args[0];
+            y = scr.hud_height / 2 - 120 + op->args[1];
+            ci = &cl.clientinfo[op->args[2]];
 
             Q_snprintf(buffer, sizeof(buffer), "%3d %3d %-12.12s",
-                       score, ping, ci->name);
-            if (value == cl.frame.clientNum) {
+                       op->args[3], min(op->args[4], 999), ci->name);
+            if (op->args[2] == cl.frame.clientNum) {
                 HUD_DrawAltString(x, y, buffer);
             } else {
                 HUD_DrawString(x, y, buffer);
             }
-            continue;
-        }
+            break;
 
-        if (!strcmp(token, "picn")) {
+        case LOP_PICN:
             // draw a pic from a name
-            token = COM_Parse(&s);
-            R_DrawPic(x, y, R_RegisterTempPic(token));
-            continue;
-        }
+            R_DrawPic(x, y, op->pic);
+            break;
 
-        if (!strcmp(token, "num")) {
+        case LOP_NUM:
             // draw a number
-            token = COM_Parse(&s);
-            width = Q_atoi(token);
-            token = COM_Parse(&s);
-            value = Q_atoi(token);
-            if (value < 0 || value >= cl.max_stats) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            value = cl.frame.ps.stats[value];
-            HUD_DrawNumber(x, y, 0, width, value);
-            continue;
-        }
+            value = cl.frame.ps.stats[op->args[1]];
+            HUD_DrawNumber(x, y, 0, op->args[0], value);
+            break;
 
-        if (!strcmp(token, "hnum")) {
+        case LOP_HNUM:
             // health number
-            int     color;
-
-            width = 3;
             value = cl.frame.ps.stats[STAT_HEALTH];
             if (value > 25)
                 color = 0;  // green
@@ -1962,161 +2196,69 @@ static void SCR_ExecuteLayoutString(const char *s)
             if (cl.frame.ps.stats[STAT_FLASHES] & 1)
                 R_DrawPic(x, y, scr.field_pic);
 
-            HUD_DrawNumber(x, y, color, width, value);
-            continue;
-        }
+            HUD_DrawNumber(x, y, color, 3, value);
+            break;
 
-        if (!strcmp(token, "anum")) {
+        case LOP_ANUM:
             // ammo number
-            int     color;
-
-            width = 3;
             value = cl.frame.ps.stats[STAT_AMMO];
             if (value > 5)
                 color = 0;  // green
             else if (value >= 0)
                 color = ((cl.frame.number / CL_FRAMEDIV) >> 2) & 1;     // flash
             else
-                continue;   // negative number = don't show
+                break;      // negative number = don't show
 
             if (cl.frame.ps.stats[STAT_FLASHES] & 4)
                 R_DrawPic(x, y, scr.field_pic);
 
-            HUD_DrawNumber(x, y, color, width, value);
-            continue;
-        }
+            HUD_DrawNumber(x, y, color, 3, value);
+            break;
 
-        if (!strcmp(token, "rnum")) {
+        case LOP_RNUM:
             // armor number
-            int     color;
-
-            width = 3;
             value = cl.frame.ps.stats[STAT_ARMOR];
             if (value < 1)
-                continue;
-
-            color = 0;  // green
+                break;
 
             if (cl.frame.ps.stats[STAT_FLASHES] & 2)
                 R_DrawPic(x, y, scr.field_pic);
 
-            HUD_DrawNumber(x, y, color, width, value);
-            continue;
-        }
+            HUD_DrawNumber(x, y, 0, 3, value);
+            break;
 
-        if (!strncmp(token, "stat_", 5)) {
-            char *cmd = token + 5;
-            token = COM_Parse(&s);
-            index = Q_atoi(token);
-            if (index < 0 || index >= cl.max_stats) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            index = cl.frame.ps.stats[index];
+        case LOP_STAT_STRING:
+            index = cl.frame.ps.stats[op->args[0]];
             if (index < 0 || index >= cl.csr.end) {
                 Com_Error(ERR_DROP, "%s: invalid string index", __func__);
             }
-            token = cl.configstrings[index];
-            if (!strcmp(cmd, "string"))
-                HUD_DrawString(x, y, token);
-            else if (!strcmp(cmd, "string2"))
-                HUD_DrawAltString(x, y, token);
-            else if (!strcmp(cmd, "cstring"))
-                HUD_DrawCenterString(x + 320 / 2, y, token);
-            else if (!strcmp(cmd, "cstring2"))
-                HUD_DrawAltCenterString(x + 320 / 2, y, token);
-            else if (!strcmp(cmd, "rstring"))
-                HUD_DrawRightString(x, y, token);
-            else if (!strcmp(cmd, "rstring2"))
-                HUD_DrawAltRightString(x, y, token);
-            continue;
-        }
-
-        if (!strcmp(token, "cstring")) {
-            token = COM_Parse(&s);
-            HUD_DrawCenterString(x + 320 / 2, y, token);
-            continue;
-        }
-
-        if (!strcmp(token, "cstring2")) {
-            token = COM_Parse(&s);
-            HUD_DrawAltCenterString(x + 320 / 2, y, token);
-            continue;
-        }
-
-        if (!strcmp(token, "string")) {
-            token = COM_Parse(&s);
-            HUD_DrawString(x, y, token);
-            continue;
-        }
-
-        if (!strcmp(token, "string2")) {
-            token = COM_Parse(&s);
-            HUD_DrawAltString(x, y, token);
-            continue;
-        }
-
-        if (!strcmp(token, "rstring")) {
-            token = COM_Parse(&s);
-            HUD_DrawRightString(x, y, token);
-            continue;
-        }
-
-        if (!strcmp(token, "rstring2")) {
-            token = COM_Parse(&s);
-            HUD_DrawAltRightString(x, y, token);
-            continue;
-        }
-
-        if (!strcmp(token, "if")) {
-            token = COM_Parse(&s);
-            value = Q_atoi(token);
-            if (value < 0 || value >= cl.max_stats) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
-            }
-            value = cl.frame.ps.stats[value];
-            if (!value) {   // skip to endif
-                if (cl.csr.extended) {
-                    SCR_SkipToEndif(&s);
-                } else while (strcmp(token, "endif")) {
-                    token = COM_Parse(&s);
-                    if (!s) {
-                        break;
-                    }
-                }
-            }
-            continue;
-        }
-
-        // Q2PRO extension
-        if (!strcmp(token, "color")) {
-            color_t     color;
+            SCR_DrawLayoutString(x, y, op->mode, cl.configstrings[index]);
+            break;
 
-            token = COM_Parse(&s);
-            if (SCR_ParseColor(token, &color)) {
-                color.u8[3] *= scr_alpha->value;
-                R_SetColor(color.u32);
-            }
-            continue;
-        }
+        case LOP_STRING:
+            SCR_DrawLayoutString(x, y, op->mode, op->string);
+            break;
 
-        if (!strcmp(token, "health_bars")) {
-            token = COM_Parse(&s);
-            value = Q_atoi(token);
-            if (value < 0 || value >= cl.max_stats) {
-                Com_Error(ERR_DROP, "%s: invalid stat index", __func__);
+        case LOP_IF:
+            if (!cl.frame.ps.stats[op->args[0]]) {
+                next = op->skip;    // skip to endif
             }
-            value = cl.frame.ps.stats[value];
+            break;
 
-            token = COM_Parse(&s);
-            index = Q_atoi(token);
-            if (index < 0 || index >= cl.csr.end) {
-                Com_Error(ERR_DROP, "%s: invalid string index", __func__);
+        case LOP_COLOR: {
+                // Q2PRO extension
+                color_t rgba = op->color;
+                rgba.u8[3] *= scr_alpha->value;
+                R_SetColor(rgba.u32);
             }
+            break;
 
-            HUD_DrawCenterString(x + 320 / 2, y, cl.configstrings[index]);
+        case LOP_HEALTH_BARS:
+            value = cl.frame.ps.stats[op->args[0]];
+            HUD_DrawCenterString(x + 320 / 2, y, cl.configstrings[op->args[1]]);
             SCR_DrawHealthBar(x + 320 / 2, y + CONCHAR_HEIGHT + 4, value & 0xff);
             SCR_DrawHealthBar(x + 320 / 2, y + CONCHAR_HEIGHT + 12, (value >> 8) & 0xff);
-            continue;
+            break;
         }
     }
 
@@ -2124,6 +2266,13 @@ static void SCR_ExecuteLayoutString(const char *s)
     R_SetAlpha(scr_alpha->value);
 }
 
+// named pics may be freed by the renderer, so force recompilation
+void SCR_ClearLayoutCache(void)
+{
+    SCR_FreeLayoutProgram(&scr_statusbar_prog);
+    SCR_FreeLayoutProgram(&scr_layout_prog);
+}
+
 //=============================================================================
 
 static void SCR_DrawPause(void)
@@ -2220,7 +2369,7 @@ static void SCR_DrawStats(void)
     if (cl.frame.ps.stats[STAT_LAYOUTS] & LAYOUTS_HIDE_HUD)
         return;
 
-    SCR_ExecuteLayoutString(cl.configstrings[CS_STATUSBAR]);
+    SCR_ExecuteLayoutProgram(&scr_statusbar_prog, cl.configstrings[CS_STATUSBAR]);
 }
 
 static void SCR_DrawLayout(void)
@@ -2235,7 +2384,7 @@ static void SCR_DrawLayout(void)
         return;
 
 draw:
-    SCR_ExecuteLayoutString(cl.layout);
+    SCR_ExecuteLayoutProgram(&scr_layout_prog, cl.layout);
 }
 
 static void SCR_Draw2D(void)
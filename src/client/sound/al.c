@@ -406,12 +406,12 @@ static void AL_MergeLoopSounds(void)
         sfx = S_SfxForHandle(cl.sound_precache[sounds[i]]);
         if (!sfx)
             continue;       // bad sound effect
-        sc = sfx->cache;
+        sc = S_LoadSound(sfx);
         if (!sc)
-            continue;
+            continue;       // not loaded yet
 
         num = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
-        ent = &cl.entityStates[num];
+        ent = &cl.entityStates[cl.entityRefs[num]];
 
         vol = S_GetEntityLoopVolume(ent);
         att = S_GetEntityLoopDistMult(ent);
@@ -427,7 +427,7 @@ static void AL_MergeLoopSounds(void)
             sounds[j] = 0;  // don't check this again later
 
             num = (cl.frame.firstEntity + j) & PARSE_ENTITIES_MASK;
-            ent = &cl.entityStates[num];
+            ent = &cl.entityStates[cl.entityRefs[num]];
 
             CL_GetEntitySoundOrigin(ent->number, origin);
             S_SpatializeOrigin(origin,
@@ -512,12 +512,12 @@ static void AL_AddLoopSounds(void)
         sfx = S_SfxForHandle(cl.sound_precache[sounds[i]]);
         if (!sfx)
             continue;       // bad sound effect
-        sc = sfx->cache;
+        sc = S_LoadSound(sfx);
         if (!sc)
-            continue;
+            continue;       // not loaded yet
 
         num = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
-        ent = &cl.entityStates[num];
+        ent = &cl.entityStates[cl.entityRefs[num]];
 
         ch = AL_FindLoopingSound(ent->number, sfx);
         if (ch) {
@@ -18,15 +18,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // snd_dma.c -- main control for any streaming sound output device
 
 #include "sound.h"
+#include "common/cpu.h"
 #include "common/intreadwrite.h"
+#include "system/pthread.h"
 
 #define PAINTBUFFER_SIZE    2048
 
-typedef struct {
-    float   left;
-    float   right;
-} samplepair_t;
-
 dma_t       dma;
 
 cvar_t      *s_khz;
@@ -34,9 +31,14 @@ cvar_t      *s_khz;
 static cvar_t       *s_testsound;
 static cvar_t       *s_swapstereo;
 static cvar_t       *s_mixahead;
+static cvar_t       *s_mixthread;
 
 static float    snd_vol;
 
+static const mixfuncs_t *mix;
+
+static void DMA_SyncMixer(void);
+
 static int          s_rawend;
 static samplepair_t s_rawsamples[MAX_RAW_SAMPLES];
 
@@ -116,6 +118,8 @@ static bool DMA_RawSamples(int samples, int rate, int width, int channels, const
     int outcount = samples / stepscale;
     float vol = snd_vol * volume;
 
+    DMA_SyncMixer();
+
     if (s_rawend < s_paintedtime)
         s_rawend = s_paintedtime;
 
@@ -170,6 +174,7 @@ static bool DMA_RawSamples(int samples, int rate, int width, int channels, const
 
 static int DMA_HaveRawSamples(void)
 {
+    DMA_SyncMixer();
     return Q_clip(s_rawend - s_paintedtime, 0, MAX_RAW_SAMPLES);
 }
 
@@ -180,6 +185,7 @@ static int DMA_NeedRawSamples(void)
 
 static void DMA_DropRawSamples(void)
 {
+    DMA_SyncMixer();
     memset(s_rawsamples, 0, sizeof(s_rawsamples));
     s_rawend = s_paintedtime;
 }
@@ -192,7 +198,7 @@ PAINTBUFFER TRANSFER
 ===============================================================================
 */
 
-static void TransferStereo16(const samplepair_t *samp, int endtime)
+static void TransferStereo16(const samplepair_t *samp, int endtime, byte *buffer)
 {
     int ltime = s_paintedtime;
     int size = dma.samples >> 1;
@@ -203,17 +209,14 @@ static void TransferStereo16(const samplepair_t *samp, int endtime)
         int count = min(size - lpos, endtime - ltime);
 
         // write a linear blast of samples
-        int16_t *out = (int16_t *)dma.buffer + (lpos << 1);
-        for (int i = 0; i < count; i++, samp++, out += 2) {
-            out[0] = Q_clip_int16(samp->left);
-            out[1] = Q_clip_int16(samp->right);
-        }
+        mix->transfer_stereo16((int16_t *)buffer + (lpos << 1), samp, count);
 
+        samp += count;
         ltime += count;
     }
 }
 
-static void TransferStereo(const samplepair_t *samp, int endtime)
+static void TransferStereo(const samplepair_t *samp, int endtime, byte *buffer)
 {
     const float *p = (const float *)samp;
     int count = (endtime - s_paintedtime) * dma.channels;
@@ -223,7 +226,7 @@ static void TransferStereo(const samplepair_t *samp, int endtime)
     int val;
 
     if (dma.samplebits == 16) {
-        int16_t *out = (int16_t *)dma.buffer;
+        int16_t *out = (int16_t *)buffer;
         while (count--) {
             val = *p;
             p += step;
@@ -231,7 +234,7 @@ static void TransferStereo(const samplepair_t *samp, int endtime)
             out_idx = (out_idx + 1) & out_mask;
         }
     } else if (dma.samplebits == 8) {
-        uint8_t *out = (uint8_t *)dma.buffer;
+        uint8_t *out = (uint8_t *)buffer;
         while (count--) {
             val = *p;
             p += step;
@@ -241,7 +244,7 @@ static void TransferStereo(const samplepair_t *samp, int endtime)
     }
 }
 
-static void TransferPaintBuffer(samplepair_t *samp, int endtime)
+static void TransferPaintBuffer(samplepair_t *samp, int endtime, byte *buffer)
 {
     int i;
 
@@ -260,10 +263,10 @@ static void TransferPaintBuffer(samplepair_t *samp, int endtime)
 
     if (dma.samplebits == 16 && dma.channels == 2) {
         // optimized case
-        TransferStereo16(samp, endtime);
+        TransferStereo16(samp, endtime, buffer);
     } else {
         // general case
-        TransferStereo(samp, endtime);
+        TransferStereo(samp, endtime, buffer);
     }
 }
 
@@ -336,98 +339,16 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-typedef void (*paintfunc_t)(const channel_t *, const sfxcache_t *, int, samplepair_t *);
-
-#define PAINTFUNC(name) \
-    static void name(const channel_t *ch, const sfxcache_t *sc, int count, samplepair_t *samp)
-
-PAINTFUNC(PaintMono8)
-{
-    float leftvol = ch->leftvol * snd_vol * 256;
-    float rightvol = ch->rightvol * snd_vol * 256;
-    const uint8_t *sfx = sc->data + ch->pos;
-
-    for (int i = 0; i < count; i++, samp++, sfx++) {
-        samp->left += (*sfx - 128) * leftvol;
-        samp->right += (*sfx - 128) * rightvol;
-    }
-}
-
-PAINTFUNC(PaintStereoDmix8)
-{
-    float leftvol = ch->leftvol * snd_vol * (256 * M_SQRT1_2f);
-    float rightvol = ch->rightvol * snd_vol * (256 * M_SQRT1_2f);
-    const uint8_t *sfx = sc->data + ch->pos * 2;
-
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
-        int sum = (sfx[0] - 128) + (sfx[1] - 128);
-        samp->left += sum * leftvol;
-        samp->right += sum * rightvol;
-    }
-}
-
-PAINTFUNC(PaintStereoFull8)
-{
-    float vol = ch->leftvol * snd_vol * 256;
-    const uint8_t *sfx = sc->data + ch->pos * 2;
-
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
-        samp->left += (sfx[0] - 128) * vol;
-        samp->right += (sfx[1] - 128) * vol;
-    }
-}
-
-PAINTFUNC(PaintMono16)
-{
-    float leftvol = ch->leftvol * snd_vol;
-    float rightvol = ch->rightvol * snd_vol;
-    const int16_t *sfx = (const int16_t *)sc->data + ch->pos;
-
-    for (int i = 0; i < count; i++, samp++, sfx++) {
-        samp->left += *sfx * leftvol;
-        samp->right += *sfx * rightvol;
-    }
-}
-
-PAINTFUNC(PaintStereoDmix16)
-{
-    float leftvol = ch->leftvol * snd_vol * M_SQRT1_2f;
-    float rightvol = ch->rightvol * snd_vol * M_SQRT1_2f;
-    const int16_t *sfx = (const int16_t *)sc->data + ch->pos * 2;
-
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
-        int sum = sfx[0] + sfx[1];
-        samp->left += sum * leftvol;
-        samp->right += sum * rightvol;
-    }
-}
-
-PAINTFUNC(PaintStereoFull16)
-{
-    float vol = ch->leftvol * snd_vol;
-    const int16_t *sfx = (const int16_t *)sc->data + ch->pos * 2;
-
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
-        samp->left += sfx[0] * vol;
-        samp->right += sfx[1] * vol;
-    }
-}
-
-static const paintfunc_t paintfuncs[] = {
-    PaintMono8,
-    PaintStereoDmix8,
-    PaintStereoFull8,
-    PaintMono16,
-    PaintStereoDmix16,
-    PaintStereoFull16,
+// volume scale for each paint function
+static const float paintscale[6] = {
+    256, 256 * M_SQRT1_2f, 256, 1, M_SQRT1_2f, 1
 };
 
-static void PaintChannels(int endtime)
+static void PaintChannels(int endtime, bool underwater, byte *buffer)
 {
     samplepair_t paintbuffer[PAINTBUFFER_SIZE];
     channel_t *ch;
     int i;
-    bool underwater = S_IsUnderWater();
 
     while (s_paintedtime < endtime) {
         // if paintbuffer is smaller than DMA buffer
@@ -456,7 +377,7 @@ static void PaintChannels(int endtime)
                 if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
                     break;
 
-                sfxcache_t *sc = S_LoadSound(ch->sfx);
+                sfxcache_t *sc = ch->sfx->cache;
                 if (!sc)
                     break;
 
@@ -465,8 +386,14 @@ static void PaintChannels(int endtime)
 
                 if (count > 0) {
                     int func = (sc->width - 1) * 3 + (sc->channels - 1) * (S_IsFullVolume(ch) + 1);
-                    Q_assert(func < q_countof(paintfuncs));
-                    paintfuncs[func](ch, sc, count, &paintbuffer[ltime - s_paintedtime]);
+                    Q_assert(func < q_countof(paintscale));
+                    float leftvol = ch->leftvol * snd_vol * paintscale[func];
+                    float rightvol = ch->rightvol * snd_vol * paintscale[func];
+                    if (func % 3 == 2)
+                        rightvol = leftvol;     // full volume stereo
+                    mix->paint[func](&paintbuffer[ltime - s_paintedtime],
+                                     sc->data + ch->pos * sc->width * sc->channels,
+                                     count, leftvol, rightvol);
                     ch->pos += count;
                     ltime += count;
                 }
@@ -501,19 +428,234 @@ static void PaintChannels(int endtime)
         }
 
         // transfer out according to DMA format
-        TransferPaintBuffer(paintbuffer, end);
+        TransferPaintBuffer(paintbuffer, end, buffer);
         s_paintedtime = end;
     }
 }
 
 static void s_volume_changed(cvar_t *self)
 {
+    DMA_SyncMixer();
     snd_vol = Cvar_ClampValue(self, 0, 1);
 }
 
 /*
 ===============================================================================
 
+MIXER THREAD
+
+When enabled, channels are painted on a separate thread that fills ahead
+while the main thread continues with the frame. Sound drivers can't be
+accessed from the mixer thread, so it paints into a shadow copy of DMA
+buffer, which is then copied to DMA buffer by the next DMA_Update().
+
+Everything that accesses mixer state on the main thread must call
+DMA_SyncMixer() first.
+
+===============================================================================
+*/
+
+static struct {
+    bool            initialized;
+    bool            terminate;
+    bool            pending;
+    bool            underwater;
+    int             endtime;
+    int             painted_start;      // painted, but not yet copied
+    int             painted_end;
+    uint64_t        usec;               // time spent painting
+    int             mixes;
+    byte            *buffer;
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+    pthread_t       thread;
+} mixer;
+
+static void *mixer_func(void *arg)
+{
+    pthread_mutex_lock(&mixer.lock);
+    while (1) {
+        while (!mixer.pending && !mixer.terminate)
+            pthread_cond_wait(&mixer.work_cond, &mixer.lock);
+
+        if (mixer.terminate)
+            break;
+
+        pthread_mutex_unlock(&mixer.lock);
+        uint64_t start = Sys_Microseconds();
+        mixer.painted_start = s_paintedtime;
+        PaintChannels(mixer.endtime, mixer.underwater, mixer.buffer);
+        mixer.painted_end = s_paintedtime;
+        start = Sys_Microseconds() - start;
+        pthread_mutex_lock(&mixer.lock);
+
+        mixer.usec += start;
+        mixer.mixes++;
+        mixer.pending = false;
+        pthread_cond_signal(&mixer.done_cond);
+    }
+    pthread_mutex_unlock(&mixer.lock);
+
+    return NULL;
+}
+
+static void DMA_SyncMixer(void)
+{
+    if (!mixer.initialized)
+        return;
+
+    pthread_mutex_lock(&mixer.lock);
+    while (mixer.pending)
+        pthread_cond_wait(&mixer.done_cond, &mixer.lock);
+    pthread_mutex_unlock(&mixer.lock);
+}
+
+static void DMA_KickMixer(int endtime, bool underwater)
+{
+    pthread_mutex_lock(&mixer.lock);
+    mixer.endtime = endtime;
+    mixer.underwater = underwater;
+    mixer.pending = true;
+    pthread_mutex_unlock(&mixer.lock);
+
+    pthread_cond_signal(&mixer.work_cond);
+}
+
+// copies painted samples from shadow buffer into locked DMA buffer
+static void DMA_CopyMixed(void)
+{
+    int width = dma.samplebits >> 3;
+    int mask = dma.samples - 1;
+    int pos = mixer.painted_start * dma.channels & mask;
+    int count = (mixer.painted_end - mixer.painted_start) * dma.channels;
+
+    count = min(count, dma.samples);
+    while (count > 0) {
+        int n = min(count, dma.samples - pos);
+        memcpy(dma.buffer + pos * width, mixer.buffer + pos * width, n * width);
+        pos = (pos + n) & mask;
+        count -= n;
+    }
+
+    mixer.painted_start = mixer.painted_end;
+}
+
+static void DMA_InitMixer(void)
+{
+    if (!s_mixthread->integer)
+        return;
+
+    mixer.buffer = Z_Malloc(dma.samples * dma.samplebits / 8);
+
+    pthread_mutex_init(&mixer.lock, NULL);
+    pthread_cond_init(&mixer.work_cond, NULL);
+    pthread_cond_init(&mixer.done_cond, NULL);
+    if (pthread_create(&mixer.thread, NULL, mixer_func, NULL)) {
+        Com_EPrintf("Couldn't create mixer thread\n");
+        pthread_mutex_destroy(&mixer.lock);
+        pthread_cond_destroy(&mixer.work_cond);
+        pthread_cond_destroy(&mixer.done_cond);
+        Z_Freep(&mixer.buffer);
+        return;
+    }
+
+    mixer.initialized = true;
+}
+
+static void DMA_ShutdownMixer(void)
+{
+    if (!mixer.initialized)
+        return;
+
+    DMA_SyncMixer();
+
+    pthread_mutex_lock(&mixer.lock);
+    mixer.terminate = true;
+    pthread_mutex_unlock(&mixer.lock);
+
+    pthread_cond_signal(&mixer.work_cond);
+
+    Q_assert(!pthread_join(mixer.thread, NULL));
+
+    pthread_mutex_destroy(&mixer.lock);
+    pthread_cond_destroy(&mixer.work_cond);
+    pthread_cond_destroy(&mixer.done_cond);
+    Z_Free(mixer.buffer);
+    memset(&mixer, 0, sizeof(mixer));
+}
+
+/*
+===============================================================================
+
+BENCHMARK
+
+===============================================================================
+*/
+
+static void DMA_MixBench_f(void)
+{
+    samplepair_t ref[PAINTBUFFER_SIZE], buf[PAINTBUFFER_SIZE];
+    int16_t ref_out[PAINTBUFFER_SIZE * 2], out[PAINTBUFFER_SIZE * 2];
+    unsigned features = Com_GetCpuFeatures();
+    int i, j, numch, frames, size;
+    byte *data;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <channels> [seconds]\n", Cmd_Argv(0));
+        return;
+    }
+
+    numch = Q_clip(Q_atoi(Cmd_Argv(1)), 1, 1024);
+    frames = Q_clipf(Cmd_Argc() > 2 ? Q_atof(Cmd_Argv(2)) : 10, 0.1f, 600) * dma.speed;
+
+    // synthetic channels cycle through all sample formats, with odd start
+    // offsets so that leftover samples are also covered
+    size = (PAINTBUFFER_SIZE + 8) * 4;
+    data = Z_Malloc(numch * size);
+    for (i = 0; i < numch * size; i++)
+        data[i] = Q_rand();
+
+    for (i = 0; mix_funcs[i]; i++) {
+        const mixfuncs_t *m = mix_funcs[i];
+        uint64_t start, elapsed;
+        int pos, count;
+        bool exact;
+
+        if ((m->features & features) != m->features) {
+            Com_Printf("%-5s: not supported\n", m->name);
+            continue;
+        }
+
+        start = Sys_Microseconds();
+        for (pos = 0; pos < frames; pos += count) {
+            count = min(frames - pos, PAINTBUFFER_SIZE - 7);
+            memset(buf, 0, count * sizeof(buf[0]));
+            for (j = 0; j < numch; j++)
+                m->paint[j % 6](buf, data + j * size + (j & 7) * 4, count, 0.25f, 0.5f);
+            m->transfer_stereo16(out, buf, count);
+        }
+        elapsed = max(Sys_Microseconds() - start, 1);
+
+        // check results are bit-exact to C version
+        memset(ref, 0, count * sizeof(ref[0]));
+        for (j = 0; j < numch; j++)
+            mix_c.paint[j % 6](ref, data + j * size + (j & 7) * 4, count, 0.25f, 0.5f);
+        mix_c.transfer_stereo16(ref_out, ref, count);
+        exact = !memcmp(ref, buf, count * sizeof(ref[0])) &&
+                !memcmp(ref_out, out, count * sizeof(out[0]) * 2);
+
+        Com_Printf("%-5s: %.2f Msamples/s, %.1fx realtime%s\n", m->name,
+                   (double)frames * numch / elapsed, (double)frames * 1000000 / dma.speed / elapsed,
+                   exact ? "" : " (MISMATCH)");
+    }
+
+    Z_Free(data);
+}
+
+/*
+===============================================================================
+
 INIT / SHUTDOWN
 
 ===============================================================================
@@ -561,6 +703,7 @@ static bool DMA_Init(void)
     s_mixahead = Cvar_Get("s_mixahead", "0.1", CVAR_ARCHIVE);
     s_testsound = Cvar_Get("s_testsound", "0", 0);
     s_swapstereo = Cvar_Get("s_swapstereo", "0", 0);
+    s_mixthread = Cvar_Get("s_mixthread", "0", CVAR_ARCHIVE | CVAR_SOUND);
     cvar_t *s_driver = Cvar_Get("s_driver", "", CVAR_SOUND);
 
     for (i = 0; s_drivers[i]; i++) {
@@ -595,13 +738,24 @@ static bool DMA_Init(void)
     s_numchannels = MAX_CHANNELS;
     s_supports_float = true;
 
+    mix = S_GetMixFuncs();
+
+    DMA_InitMixer();
+
+    Cmd_AddCommand("s_mixbench", DMA_MixBench_f);
+
     Com_Printf("sound sampling rate: %i\n", dma.speed);
+    Com_DPrintf("sound mixer: %s%s\n", mix->name, mixer.initialized ? ", threaded" : "");
 
     return true;
 }
 
 static void DMA_Shutdown(void)
 {
+    DMA_ShutdownMixer();
+
+    Cmd_RemoveCommand("s_mixbench");
+
     snddma->shutdown();
     snddma = NULL;
     s_numchannels = 0;
@@ -612,6 +766,8 @@ static void DMA_Shutdown(void)
 
 static void DMA_Activate(void)
 {
+    DMA_SyncMixer();
+
     if (snddma->activate) {
         S_StopAllSounds();
         snddma->activate(s_active);
@@ -631,6 +787,8 @@ static int DMA_DriftBeginofs(float timeofs)
     static int  s_beginofs;
     int         start;
 
+    DMA_SyncMixer();
+
     // drift s_beginofs
     start = cl.servertime * 0.001f * dma.speed + s_beginofs;
     if (start < s_paintedtime) {
@@ -648,6 +806,11 @@ static int DMA_DriftBeginofs(float timeofs)
 
 static void DMA_ClearBuffer(void)
 {
+    DMA_SyncMixer();
+
+    // drop anything painted by mixer thread
+    mixer.painted_start = mixer.painted_end;
+
     snddma->begin_painting();
     if (dma.buffer)
         memset(dma.buffer, dma.samplebits == 8 ? 0x80 : 0, dma.samples * dma.samplebits / 8);
@@ -670,7 +833,9 @@ static void DMA_Spatialize(channel_t *ch)
         return;
     }
 
-    if (ch->fixed_origin) {
+    // mixer thread can't access entity state, DMA_Update resolves
+    // origins of pending playsounds for it in advance
+    if (ch->fixed_origin || !Sys_IsMainThread()) {
         VectorCopy(ch->origin, origin);
     } else {
         CL_GetEntitySoundOrigin(ch->entnum, origin);
@@ -712,12 +877,12 @@ static void AddLoopSounds(void)
         sfx = S_SfxForHandle(cl.sound_precache[sounds[i]]);
         if (!sfx)
             continue;       // bad sound effect
-        sc = sfx->cache;
+        sc = S_LoadSound(sfx);
         if (!sc)
-            continue;
+            continue;       // not loaded yet
 
         num = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
-        ent = &cl.entityStates[num];
+        ent = &cl.entityStates[cl.entityRefs[num]];
 
         vol = S_GetEntityLoopVolume(ent);
         att = S_GetEntityLoopDistMult(ent);
@@ -732,7 +897,7 @@ static void AddLoopSounds(void)
             sounds[j] = 0;  // don't check this again later
 
             num = (cl.frame.firstEntity + j) & PARSE_ENTITIES_MASK;
-            ent = &cl.entityStates[num];
+            ent = &cl.entityStates[cl.entityRefs[num]];
 
             CL_GetEntitySoundOrigin(ent->number, origin);
             S_SpatializeOrigin(origin,
@@ -788,9 +953,12 @@ static void DMA_Update(void)
 {
     int         i;
     channel_t   *ch;
+    playsound_t *ps;
     int         samples, soundtime, endtime;
     float       sec;
 
+    DMA_SyncMixer();
+
     // update spatialization for dynamic sounds
     for (i = 0, ch = s_channels; i < s_numchannels; i++, ch++) {
         if (!ch->sfx)
@@ -832,6 +1000,10 @@ static void DMA_Update(void)
     if (!dma.buffer)
         return;
 
+    // transfer samples painted by mixer thread
+    if (mixer.painted_start != mixer.painted_end)
+        DMA_CopyMixed();
+
     // update DMA time
     soundtime = DMA_GetTime();
 
@@ -852,9 +1024,20 @@ static void DMA_Update(void)
     samples = dma.samples >> (dma.channels - 1);
     endtime = min(endtime, soundtime + samples);
 
-    PaintChannels(endtime);
+    if (!mixer.initialized) {
+        PaintChannels(endtime, S_IsUnderWater(), dma.buffer);
+        snddma->submit();
+        return;
+    }
 
     snddma->submit();
+
+    // resolve origins of pending playsounds for mixer thread
+    LIST_FOR_EACH(playsound_t, ps, &s_pendingplays, entry)
+        if (!ps->fixed_origin && ps->entnum != -1 && ps->entnum != listener_entnum)
+            CL_GetEntitySoundOrigin(ps->entnum, ps->origin);
+
+    DMA_KickMixer(endtime, S_IsUnderWater());
 }
 
 static int DMA_GetSampleRate(void)
@@ -862,6 +1045,24 @@ static int DMA_GetSampleRate(void)
     return dma.speed;
 }
 
+// returns average time mixer thread spent painting since last call
+static float DMA_GetMixerTime(void)
+{
+    float msec = 0;
+
+    if (!mixer.initialized)
+        return 0;
+
+    pthread_mutex_lock(&mixer.lock);
+    if (mixer.mixes)
+        msec = mixer.usec * 0.001f / mixer.mixes;
+    mixer.usec = 0;
+    mixer.mixes = 0;
+    pthread_mutex_unlock(&mixer.lock);
+
+    return msec;
+}
+
 const sndapi_t snd_dma = {
     .init = DMA_Init,
     .shutdown = DMA_Shutdown,
@@ -878,4 +1079,6 @@ const sndapi_t snd_dma = {
     .play_channel = DMA_Spatialize,
     .stop_all_sounds = DMA_ClearBuffer,
     .get_sample_rate = DMA_GetSampleRate,
+    .sync_mixer = DMA_SyncMixer,
+    .get_mixer_time = DMA_GetMixerTime,
 };
@@ -63,9 +63,11 @@ cvar_t      *s_show;
 #endif
 cvar_t      *s_underwater;
 cvar_t      *s_underwater_gain_hf;
+cvar_t      *s_async;
 
 static cvar_t   *s_enable;
 static cvar_t   *s_auto_focus;
+static cvar_t   *s_cachesize;
 
 // =======================================================================
 // Console functions
@@ -103,6 +105,8 @@ static void S_SoundList_f(void)
         } else {
             if (sfx->name[0] == '*')
                 Com_Printf("  placeholder : %s\n", sfx->name);
+            else if (sfx->pending)
+                Com_Printf("  loading     : %s\n", sfx->name);
             else
                 Com_Printf("  not loaded  : %s (%s)\n",
                            sfx->name, Q_ErrorString(sfx->error));
@@ -111,6 +115,9 @@ static void S_SoundList_f(void)
     }
     Com_Printf("Total sounds: %d (out of %d slots)\n", count, num_sfx);
     Com_Printf("Total resident: %zu\n", total);
+    Com_Printf("Cache hits: %u, misses: %u, evictions: %u, loading: %u\n",
+               s_cachestats.hits, s_cachestats.misses,
+               s_cachestats.evictions, s_cachestats.pending);
 }
 
 static const cmdreg_t c_sound[] = {
@@ -130,6 +137,11 @@ static void s_auto_focus_changed(cvar_t *self)
     S_Activate();
 }
 
+static void s_cachesize_changed(cvar_t *self)
+{
+    S_TrimSoundCache(NULL);
+}
+
 /*
 ================
 S_Init
@@ -153,6 +165,8 @@ void S_Init(void)
     s_auto_focus = Cvar_Get("s_auto_focus", "0", 0);
     s_underwater = Cvar_Get("s_underwater", "1", 0);
     s_underwater_gain_hf = Cvar_Get("s_underwater_gain_hf", "0.25", 0);
+    s_async = Cvar_Get("s_async", "1", 0);
+    s_cachesize = Cvar_Get("s_cachesize", "0", 0);
 
     // start one of available sound engines
     s_started = SS_NOT;
@@ -185,6 +199,8 @@ void S_Init(void)
     s_auto_focus->changed = s_auto_focus_changed;
     s_auto_focus_changed(s_auto_focus);
 
+    s_cachesize->changed = s_cachesize_changed;
+
     num_sfx = 0;
 
     s_paintedtime = 0;
@@ -213,6 +229,68 @@ static void S_FreeSound(sfx_t *sfx)
     memset(sfx, 0, sizeof(*sfx));
 }
 
+/*
+==================
+S_TrimSoundCache
+
+Frees least recently used sounds until total resident size fits into
+s_cachesize megabytes. Sounds referenced by channels or pending playsounds
+are never freed, and neither is `keep'.
+==================
+*/
+void S_TrimSoundCache(const sfx_t *keep)
+{
+    bool        inuse[MAX_SFX];
+    sfx_t       *sfx, *best;
+    playsound_t *ps;
+    size_t      total, limit;
+    int         i;
+
+    if (!s_started || s_registering || s_cachesize->value <= 0)
+        return;
+
+    limit = s_cachesize->value * 0x100000;
+
+    total = 0;
+    for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++)
+        if (sfx->cache)
+            total += sfx->cache->size;
+
+    if (total <= limit)
+        return;
+
+    // make sure mixer thread is not referencing anything
+    if (s_api->sync_mixer)
+        s_api->sync_mixer();
+
+    memset(inuse, 0, sizeof(inuse));
+    for (i = 0; i < s_numchannels; i++)
+        if (s_channels[i].sfx)
+            inuse[s_channels[i].sfx - known_sfx] = true;
+    LIST_FOR_EACH(playsound_t, ps, &s_pendingplays, entry)
+        inuse[ps->sfx - known_sfx] = true;
+    if (keep)
+        inuse[keep - known_sfx] = true;
+
+    while (total > limit) {
+        best = NULL;
+        for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
+            if (!sfx->cache || inuse[i])
+                continue;
+            if (!best || sfx->cache->lru_sequence < best->cache->lru_sequence)
+                best = sfx;
+        }
+        if (!best)
+            break;
+
+        total -= best->cache->size;
+        if (s_api->delete_sfx)
+            s_api->delete_sfx(best);
+        Z_Freep(&best->cache);
+        s_cachestats.evictions++;
+    }
+}
+
 void S_FreeAllSounds(void)
 {
     int     i;
@@ -436,7 +514,7 @@ static sfx_t *S_RegisterSexedSound(int entnum, const char *base)
     sfx = S_FindName(buffer, FS_NormalizePath(buffer));
 
     // see if it exists
-    if (sfx && !sfx->truename && !s_registering && !S_LoadSound(sfx)) {
+    if (sfx && !sfx->truename && !s_registering && !S_LoadSound(sfx) && !sfx->pending) {
         // no, revert to the male sound in the pak0.pak
         if (Q_concat(buffer, MAX_QPATH, "sound/player/male/", base + 1) < MAX_QPATH) {
             FS_NormalizePath(buffer);
@@ -513,6 +591,8 @@ void S_EndRegistration(void)
     }
 
     s_registering = false;
+
+    S_TrimSoundCache(NULL);
 }
 
 
@@ -614,7 +694,7 @@ void S_IssuePlaysound(playsound_t *ps)
     sfxcache_t  *sc;
 
 #if USE_DEBUG
-    if (s_show->integer)
+    if (s_show->integer && Sys_IsMainThread())
         Com_Printf("Issue %i\n", ps->begin);
 #endif
     // pick a channel to play on
@@ -624,7 +704,8 @@ void S_IssuePlaysound(playsound_t *ps)
         return;
     }
 
-    sc = S_LoadSound(ps->sfx);
+    // sound was loaded by S_StartSound and can't be evicted while pending
+    sc = ps->sfx->cache;
     if (!sc) {
         Com_Printf("S_IssuePlaysound: couldn't load %s\n", ps->sfx->name);
         S_FreePlaysound(ps);
@@ -677,6 +758,9 @@ void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSf
     if (!(sfx = S_SfxForHandle(hSfx)))
         return;
 
+    if (s_api->sync_mixer)
+        s_api->sync_mixer();
+
     if (sfx->name[0] == '*') {
         sfx = S_RegisterSexedSound(entnum, sfx->name);
         if (!sfx)
@@ -765,6 +849,9 @@ void S_StopAllSounds(void)
     if (!s_started)
         return;
 
+    if (s_api->sync_mixer)
+        s_api->sync_mixer();
+
     // clear all the playsounds
     memset(s_playsounds, 0, sizeof(s_playsounds));
 
@@ -793,6 +880,13 @@ int S_GetSampleRate(void)
     return 0;
 }
 
+float S_GetMixerTime(void)
+{
+    if (s_started && s_api->get_mixer_time)
+        return s_api->get_mixer_time();
+    return 0;
+}
+
 bool S_SupportsFloat(void)
 {
     return s_supports_float;
@@ -818,7 +912,7 @@ int S_BuildSoundList(int *sounds)
 
     for (i = count = 0; i < cl.frame.numEntities; i++) {
         num = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
-        ent = &cl.entityStates[num];
+        ent = &cl.entityStates[cl.entityRefs[num]];
         if (s_ambient->integer == 2 && !ent->modelindex) {
             sounds[i] = 0;
         } else if (s_ambient->integer == 3 && ent->number != listener_entnum) {
@@ -878,6 +972,31 @@ void S_SpatializeOrigin(const vec3_t origin, float master_vol, float dist_mult,
         *left_vol = 0;
 }
 
+// mixer thread reads listener state, wait for it before changing anything
+static void S_SyncMixer(void)
+{
+    if (s_started && s_api->sync_mixer)
+        s_api->sync_mixer();
+}
+
+/*
+============
+S_SetListener
+
+Called by CL_CalcViewValues
+============
+*/
+void S_SetListener(const vec3_t origin, const vec3_t forward,
+                   const vec3_t right, const vec3_t up)
+{
+    S_SyncMixer();
+
+    VectorCopy(origin, listener_origin);
+    VectorCopy(forward, listener_forward);
+    VectorCopy(right, listener_right);
+    VectorCopy(up, listener_up);
+}
+
 /*
 ============
 S_Update
@@ -904,6 +1023,8 @@ void S_Update(void)
         return;
     }
 
+    S_SyncMixer();
+
     // set listener entity number
     // other parameters should be already set up by CL_CalcViewValues
     if (cls.state != ca_active) {
@@ -18,12 +18,22 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // snd_mem.c: sound caching
 
 #include "sound.h"
+#include "common/async.h"
 #include "common/intreadwrite.h"
 
 #define FORMAT_PCM  1
 
 wavinfo_t s_info;
 
+sndcachestats_t s_cachestats;
+
+static unsigned s_lru_sequence;
+
+static void Wav_SetError(wavinfo_t *info, const char *msg)
+{
+    Q_strlcpy(info->error, msg, sizeof(info->error));
+}
+
 /*
 ===============================================================================
 
@@ -79,7 +89,9 @@ static int64_t sz_seek(void *opaque, int64_t offset, int whence)
     return sz->readcount;
 }
 
-static bool OGG_Load(sizebuf_t *sz)
+// decodes into memory allocated with av_malloc(), resampling to info->rate
+// unless it is zero. May be called from async worker thread.
+static bool OGG_Load(wavinfo_t *info, sizebuf_t *sz)
 {
     AVFormatContext *fmt_ctx = NULL;
     AVIOContext *avio_ctx = NULL;
@@ -95,32 +107,32 @@ static bool OGG_Load(sizebuf_t *sz)
 
     const AVInputFormat *fmt = av_find_input_format("ogg");
     if (!fmt) {
-        Com_SetLastError("Ogg input format not found");
+        Wav_SetError(info, "Ogg input format not found");
         return false;
     }
 
     const AVCodec *dec = avcodec_find_decoder(AV_CODEC_ID_VORBIS);
     if (!dec) {
-        Com_SetLastError("Vorbis decoder not found");
+        Wav_SetError(info, "Vorbis decoder not found");
         return false;
     }
 
     fmt_ctx = avformat_alloc_context();
     if (!fmt_ctx) {
-        Com_SetLastError("Failed to allocate format context");
+        Wav_SetError(info, "Failed to allocate format context");
         return false;
     }
 
     avio_ctx_buffer = av_malloc(avio_ctx_buffer_size);
     if (!avio_ctx_buffer) {
-        Com_SetLastError("Failed to allocate avio buffer");
+        Wav_SetError(info, "Failed to allocate avio buffer");
         goto fail;
     }
 
     avio_ctx = avio_alloc_context(avio_ctx_buffer, avio_ctx_buffer_size,
                                   0, sz, sz_read_packet, NULL, sz_seek);
     if (!avio_ctx) {
-        Com_SetLastError("Failed to allocate avio context");
+        Wav_SetError(info, "Failed to allocate avio context");
         goto fail;
     }
 
@@ -128,51 +140,51 @@ static bool OGG_Load(sizebuf_t *sz)
 
     ret = avformat_open_input(&fmt_ctx, NULL, fmt, NULL);
     if (ret < 0) {
-        Com_SetLastError(av_err2str(ret));
+        Wav_SetError(info, av_err2str(ret));
         goto fail;
     }
 
     if (fmt_ctx->nb_streams != 1) {
-        Com_SetLastError("Multiple Ogg streams are not supported");
+        Wav_SetError(info, "Multiple Ogg streams are not supported");
         goto fail;
     }
 
     st = fmt_ctx->streams[0];
     if (st->codecpar->codec_id != AV_CODEC_ID_VORBIS) {
-        Com_SetLastError("First stream is not Vorbis");
+        Wav_SetError(info, "First stream is not Vorbis");
         goto fail;
     }
 
     if (st->codecpar->ch_layout.nb_channels < 1 || st->codecpar->ch_layout.nb_channels > 2) {
-        Com_SetLastError("Unsupported number of channels");
+        Wav_SetError(info, "Unsupported number of channels");
         goto fail;
     }
 
     if (st->codecpar->sample_rate < 6000 || st->codecpar->sample_rate > 48000) {
-        Com_SetLastError("Unsupported sample rate");
+        Wav_SetError(info, "Unsupported sample rate");
         goto fail;
     }
 
     if (st->duration < 1 || st->duration > MAX_SFX_SAMPLES) {
-        Com_SetLastError("Unsupported duration");
+        Wav_SetError(info, "Unsupported duration");
         goto fail;
     }
 
     dec_ctx = avcodec_alloc_context3(dec);
     if (!dec_ctx) {
-        Com_SetLastError("Failed to allocate codec context");
+        Wav_SetError(info, "Failed to allocate codec context");
         goto fail;
     }
 
     ret = avcodec_parameters_to_context(dec_ctx, st->codecpar);
     if (ret < 0) {
-        Com_SetLastError("Failed to copy codec parameters to decoder context");
+        Wav_SetError(info, "Failed to copy codec parameters to decoder context");
         goto fail;
     }
 
     ret = avcodec_open2(dec_ctx, dec, NULL);
     if (ret < 0) {
-        Com_SetLastError("Failed to open codec");
+        Wav_SetError(info, "Failed to open codec");
         goto fail;
     }
 
@@ -183,17 +195,17 @@ static bool OGG_Load(sizebuf_t *sz)
     out = av_frame_alloc();
     swr_ctx = swr_alloc();
     if (!pkt || !frame || !out || !swr_ctx) {
-        Com_SetLastError("Failed to allocate memory");
+        Wav_SetError(info, "Failed to allocate memory");
         goto fail;
     }
 
-    sample_rate = S_GetSampleRate();
+    sample_rate = info->rate;
     if (!sample_rate)
         sample_rate = dec_ctx->sample_rate;
 
     ret = av_channel_layout_copy(&out->ch_layout, &dec_ctx->ch_layout);
     if (ret < 0) {
-        Com_SetLastError("Failed to copy channel layout");
+        Wav_SetError(info, "Failed to copy channel layout");
         goto fail;
     }
     out->format = AV_SAMPLE_FMT_S16;
@@ -202,7 +214,7 @@ static bool OGG_Load(sizebuf_t *sz)
 
     ret = av_frame_get_buffer(out, 0);
     if (ret < 0) {
-        Com_SetLastError("Failed to allocate audio buffer");
+        Wav_SetError(info, "Failed to allocate audio buffer");
         goto fail;
     }
 
@@ -215,11 +227,15 @@ static bool OGG_Load(sizebuf_t *sz)
     int offset = 0;
     bool eof = false;
 
-    s_info.channels = out->ch_layout.nb_channels;
-    s_info.rate = out->sample_rate;
-    s_info.width = 2;
-    s_info.loopstart = -1;
-    s_info.data = FS_AllocTempMem(bufsize);
+    info->channels = out->ch_layout.nb_channels;
+    info->rate = out->sample_rate;
+    info->width = 2;
+    info->loopstart = -1;
+    info->data = av_malloc(bufsize);
+    if (!info->data) {
+        Wav_SetError(info, "Failed to allocate memory");
+        goto fail;
+    }
 
     while (!eof) {
         ret = avcodec_receive_frame(dec_ctx, frame);
@@ -253,17 +269,17 @@ static bool OGG_Load(sizebuf_t *sz)
             eof = true;
         }
 
-        memcpy(s_info.data + offset, out->data[0], size);
+        memcpy(info->data + offset, out->data[0], size);
         offset += size;
     }
 
     if (ret < 0) {
-        Com_SetLastError(av_err2str(ret));
-        Z_Freep(&s_info.data);
+        Wav_SetError(info, av_err2str(ret));
+        av_freep(&info->data);
         goto fail;
     }
 
-    s_info.samples = offset >> s_info.channels;
+    info->samples = offset >> info->channels;
     res = true;
 
 fail:
@@ -314,28 +330,29 @@ static int FindChunk(sizebuf_t *sz, uint32_t search)
     return 0;
 }
 
-static bool GetWavinfo(sizebuf_t *sz)
+// may be called from async worker thread
+static bool GetWavinfo(wavinfo_t *info, sizebuf_t *sz)
 {
     int tag, samples, width, chunk_len, next_chunk;
 
     tag = SZ_ReadLong(sz);
 
 #if USE_AVCODEC
-    if (tag == MakeLittleLong('O','g','g','S') || !COM_CompareExtension(s_info.name, ".ogg")) {
+    if (tag == MakeLittleLong('O','g','g','S') || !COM_CompareExtension(info->name, ".ogg")) {
         sz->readcount = 0;
-        return OGG_Load(sz);
+        return OGG_Load(info, sz);
     }
 #endif
 
 // find "RIFF" chunk
     if (tag != TAG_RIFF) {
-        Com_SetLastError("Missing RIFF chunk");
+        Wav_SetError(info, "Missing RIFF chunk");
         return false;
     }
 
     sz->readcount += 4;
     if (SZ_ReadLong(sz) != TAG_WAVE) {
-        Com_SetLastError("Missing WAVE chunk");
+        Wav_SetError(info, "Missing WAVE chunk");
         return false;
     }
 
@@ -344,25 +361,25 @@ static bool GetWavinfo(sizebuf_t *sz)
 
 // find "fmt " chunk
     if (!FindChunk(sz, TAG_fmt)) {
-        Com_SetLastError("Missing fmt chunk");
+        Wav_SetError(info, "Missing fmt chunk");
         return false;
     }
 
-    s_info.format = SZ_ReadShort(sz);
-    if (s_info.format != FORMAT_PCM) {
-        Com_SetLastError("Unsupported PCM format");
+    info->format = SZ_ReadShort(sz);
+    if (info->format != FORMAT_PCM) {
+        Wav_SetError(info, "Unsupported PCM format");
         return false;
     }
 
-    s_info.channels = SZ_ReadShort(sz);
-    if (s_info.channels < 1 || s_info.channels > 2) {
-        Com_SetLastError("Unsupported number of channels");
+    info->channels = SZ_ReadShort(sz);
+    if (info->channels < 1 || info->channels > 2) {
+        Wav_SetError(info, "Unsupported number of channels");
         return false;
     }
 
-    s_info.rate = SZ_ReadLong(sz);
-    if (s_info.rate < 6000 || s_info.rate > 48000) {
-        Com_SetLastError("Unsupported sample rate");
+    info->rate = SZ_ReadLong(sz);
+    if (info->rate < 6000 || info->rate > 48000) {
+        Wav_SetError(info, "Unsupported sample rate");
         return false;
     }
 
@@ -372,10 +389,10 @@ static bool GetWavinfo(sizebuf_t *sz)
     case 8:
     case 16:
     case 24:
-        s_info.width = width / 8;
+        info->width = width / 8;
         break;
     default:
-        Com_SetLastError("Unsupported number of bits per sample");
+        Wav_SetError(info, "Unsupported number of bits per sample");
         return false;
     }
 
@@ -383,24 +400,24 @@ static bool GetWavinfo(sizebuf_t *sz)
     sz->readcount = next_chunk;
     chunk_len = FindChunk(sz, TAG_data);
     if (!chunk_len) {
-        Com_SetLastError("Missing data chunk");
+        Wav_SetError(info, "Missing data chunk");
         return false;
     }
 
 // calculate length in samples
-    s_info.samples = chunk_len / (s_info.width * s_info.channels);
-    if (s_info.samples < 1) {
-        Com_SetLastError("No samples");
+    info->samples = chunk_len / (info->width * info->channels);
+    if (info->samples < 1) {
+        Wav_SetError(info, "No samples");
         return false;
     }
-    if (s_info.samples > MAX_SFX_SAMPLES) {
-        Com_SetLastError("Too many samples");
+    if (info->samples > MAX_SFX_SAMPLES) {
+        Wav_SetError(info, "Too many samples");
         return false;
     }
 
 // any errors are non-fatal from this point
-    s_info.data = sz->data + sz->readcount;
-    s_info.loopstart = -1;
+    info->data = sz->data + sz->readcount;
+    info->loopstart = -1;
 
 // find "cue " chunk
     sz->readcount = next_chunk;
@@ -414,11 +431,11 @@ static bool GetWavinfo(sizebuf_t *sz)
 
     sz->readcount += 24;
     samples = SZ_ReadLong(sz);
-    if (samples < 0 || samples >= s_info.samples) {
-        Com_DPrintf("%s has bad loop start\n", s_info.name);
+    if (samples < 0 || samples >= info->samples) {
+        Wav_SetError(info, "bad loop start");
         return true;
     }
-    s_info.loopstart = samples;
+    info->loopstart = samples;
 
 // if the next chunk is a "LIST" chunk, look for a cue length marker
     sz->readcount = next_chunk;
@@ -434,30 +451,30 @@ static bool GetWavinfo(sizebuf_t *sz)
 // this is not a proper parse, but it works with cooledit...
     sz->readcount -= 8;
     samples = SZ_ReadLong(sz);  // samples in loop
-    if (samples < 1 || samples > s_info.samples - s_info.loopstart) {
-        Com_DPrintf("%s has bad loop length\n", s_info.name);
+    if (samples < 1 || samples > info->samples - info->loopstart) {
+        Wav_SetError(info, "bad loop length");
         return true;
     }
-    s_info.samples = s_info.loopstart + samples;
+    info->samples = info->loopstart + samples;
 
     return true;
 }
 
-static void ConvertSamples(void)
+static void ConvertSamples(wavinfo_t *info)
 {
-    uint16_t *data = (uint16_t *)s_info.data;
-    int count = s_info.samples * s_info.channels;
+    uint16_t *data = (uint16_t *)info->data;
+    int count = info->samples * info->channels;
 
 // sigh. truncate 24 bit to 16
-    if (s_info.width == 3) {
+    if (info->width == 3) {
         for (int i = 0; i < count; i++)
-            data[i] = RL32(&s_info.data[i * 3]) >> 8;
-        s_info.width = 2;
+            data[i] = RL32(&info->data[i * 3]) >> 8;
+        info->width = 2;
         return;
     }
 
 #if USE_BIG_ENDIAN
-    if (s_info.width == 2) {
+    if (info->width == 2) {
         for (int i = 0; i < count; i++)
             data[i] = LittleShort(data[i]);
     }
@@ -466,16 +483,108 @@ static void ConvertSamples(void)
 
 // ===============================================================================
 
+/*
+===============================================================================
+
+Sound loading
+
+File I/O is always done on the main thread because filesystem is not thread
+safe. Outside of registration, parsing and decoding is then offloaded to async
+worker thread, and samples are uploaded on the main thread once ready.
+
+===============================================================================
+*/
+
+typedef struct {
+    sfx_t       *sfx;
+    char        name[MAX_QPATH];
+    byte        *data;
+    int         len;
+    bool        ok;
+    wavinfo_t   info;
+} soundload_t;
+
+static void S_DecodeSound(soundload_t *load)
+{
+    sizebuf_t sz;
+
+    SZ_InitRead(&sz, load->data, load->len);
+
+    load->ok = GetWavinfo(&load->info, &sz);
+    if (load->ok && load->info.format == FORMAT_PCM)
+        ConvertSamples(&load->info);
+}
+
+static void S_FreeDecodedSound(soundload_t *load)
+{
+#if USE_AVCODEC
+    if (load->ok && load->info.format != FORMAT_PCM)
+        av_free(load->info.data);
+#endif
+    FS_FreeFile(load->data);
+}
+
+static sfxcache_t *S_UploadSound(soundload_t *load)
+{
+    sfx_t       *s = load->sfx;
+    sfxcache_t  *sc = NULL;
+
+    if (load->ok) {
+        if (load->info.error[0])
+            Com_DPrintf("%s has %s\n", load->name, load->info.error);
+        s_info = load->info;
+        sc = s_api->upload_sfx(s);
+    } else {
+        Com_SetLastError(load->info.error);
+        s->error = Q_ERR_INVALID_FORMAT;
+    }
+
+    if (sc)
+        sc->lru_sequence = ++s_lru_sequence;
+    else
+        Com_EPrintf("Couldn't load %s: %s\n", Com_MakePrintable(load->name), Com_GetLastError());
+
+    S_FreeDecodedSound(load);
+    return sc;
+}
+
+static void load_work_cb(void *arg)
+{
+    S_DecodeSound(arg);
+}
+
+static void load_done_cb(void *arg)
+{
+    soundload_t *load = arg;
+    sfx_t *s = load->sfx;
+
+    s_cachestats.pending--;
+
+    // sfx may have been freed or sound system restarted in the meantime
+    if (s_started && s->pending == load) {
+        s->pending = NULL;
+        if (S_UploadSound(load))
+            S_TrimSoundCache(s);
+    } else {
+        S_FreeDecodedSound(load);
+    }
+
+    Z_Free(load);
+}
+
 /*
 ==============
 S_LoadSound
+
+Returns NULL if sound is not resident yet. Outside of registration this may
+start async load, in which case sound becomes available some frames later.
 ==============
 */
 sfxcache_t *S_LoadSound(sfx_t *s)
 {
-    sizebuf_t   sz;
-    byte        *data;
+    soundload_t *load, tmp;
     sfxcache_t  *sc;
+    byte        *data;
     int         len;
     char        *name;
 
@@ -484,13 +593,18 @@ sfxcache_t *S_LoadSound(sfx_t *s)
 
 // see if still in memory
     sc = s->cache;
-    if (sc)
+    if (sc) {
+        sc->lru_sequence = ++s_lru_sequence;
+        s_cachestats.hits++;
         return sc;
+    }
 
-// don't retry after error
-    if (s->error)
+// don't retry after error, or while still loading
+    if (s->error || s->pending)
         return NULL;
 
+    s_cachestats.misses++;
+
 // load it in
     if (s->truename)
         name = s->truename;
@@ -505,29 +619,33 @@ sfxcache_t *S_LoadSound(sfx_t *s)
         return NULL;
     }
 
-    memset(&s_info, 0, sizeof(s_info));
-    s_info.name = name;
-
-    SZ_InitRead(&sz, data, len);
-
-    if (!GetWavinfo(&sz)) {
-        s->error = Q_ERR_INVALID_FORMAT;
-        goto fail;
+    load = &tmp;
+    if (s_async->integer && !s_registering)
+        load = Z_Malloc(sizeof(*load));
+
+    memset(load, 0, sizeof(*load));
+    load->sfx = s;
+    Q_strlcpy(load->name, name, sizeof(load->name));
+    load->data = data;
+    load->len = len;
+    load->info.name = load->name;
+    load->info.rate = S_GetSampleRate();
+
+    if (load != &tmp) {
+        asyncwork_t work = {
+            .work_cb = load_work_cb,
+            .done_cb = load_done_cb,
+            .cb_arg = load,
+        };
+        s->pending = load;
+        s_cachestats.pending++;
+        Com_QueueAsyncWork(&work);
+        return NULL;
     }
 
-    if (s_info.format == FORMAT_PCM)
-        ConvertSamples();
-
-    sc = s_api->upload_sfx(s);
-
-#if USE_AVCODEC
-    if (s_info.format != FORMAT_PCM)
-        FS_FreeTempMem(s_info.data);
-#endif
-
-fail:
-    if (!sc)
-        Com_EPrintf("Couldn't load %s: %s\n", Com_MakePrintable(name), Com_GetLastError());
-    FS_FreeFile(data);
+    S_DecodeSound(load);
+    sc = S_UploadSound(load);
+    if (sc && !s_registering)
+        S_TrimSoundCache(s);
     return sc;
 }
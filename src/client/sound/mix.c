@@ -0,0 +1,659 @@
+/*
+Copyright (C) 2024 Andrey Nazarov
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// mix.c -- paintbuffer mixing and transfer kernels for DMA backend
+//
+// All SIMD versions produce results bit-exact to the C versions, since they
+// perform the same int->float conversions, multiplies and adds in the same
+// order. Leftover samples are always handled by the C versions.
+//
+
+#include "sound.h"
+#include "common/cpu.h"
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+#if USE_AVX2
+#include <immintrin.h>
+#endif
+#if USE_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+===============================================================================
+
+C VERSIONS
+
+===============================================================================
+*/
+
+#define PAINTFUNC(name) \
+    static void name(samplepair_t *samp, const void *data, int count, float leftvol, float rightvol)
+
+PAINTFUNC(PaintMono8_C)
+{
+    const uint8_t *sfx = data;
+
+    for (int i = 0; i < count; i++, samp++, sfx++) {
+        samp->left += (*sfx - 128) * leftvol;
+        samp->right += (*sfx - 128) * rightvol;
+    }
+}
+
+PAINTFUNC(PaintStereoDmix8_C)
+{
+    const uint8_t *sfx = data;
+
+    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+        int sum = (sfx[0] - 128) + (sfx[1] - 128);
+        samp->left += sum * leftvol;
+        samp->right += sum * rightvol;
+    }
+}
+
+PAINTFUNC(PaintStereoFull8_C)
+{
+    const uint8_t *sfx = data;
+
+    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+        samp->left += (sfx[0] - 128) * leftvol;
+        samp->right += (sfx[1] - 128) * rightvol;
+    }
+}
+
+PAINTFUNC(PaintMono16_C)
+{
+    const int16_t *sfx = data;
+
+    for (int i = 0; i < count; i++, samp++, sfx++) {
+        samp->left += *sfx * leftvol;
+        samp->right += *sfx * rightvol;
+    }
+}
+
+PAINTFUNC(PaintStereoDmix16_C)
+{
+    const int16_t *sfx = data;
+
+    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+        int sum = sfx[0] + sfx[1];
+        samp->left += sum * leftvol;
+        samp->right += sum * rightvol;
+    }
+}
+
+PAINTFUNC(PaintStereoFull16_C)
+{
+    const int16_t *sfx = data;
+
+    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+        samp->left += sfx[0] * leftvol;
+        samp->right += sfx[1] * rightvol;
+    }
+}
+
+static void TransferStereo16_C(int16_t *out, const samplepair_t *samp, int count)
+{
+    for (int i = 0; i < count; i++, samp++, out += 2) {
+        out[0] = Q_clip_int16(samp->left);
+        out[1] = Q_clip_int16(samp->right);
+    }
+}
+
+const mixfuncs_t mix_c = {
+    .name = "c",
+    .paint = {
+        PaintMono8_C,
+        PaintStereoDmix8_C,
+        PaintStereoFull8_C,
+        PaintMono16_C,
+        PaintStereoDmix16_C,
+        PaintStereoFull16_C,
+    },
+    .transfer_stereo16 = TransferStereo16_C,
+};
+
+/*
+===============================================================================
+
+SSE2 VERSIONS
+
+===============================================================================
+*/
+
+#if USE_SSE2
+
+// accumulates 4 mono samples into 4 sample pairs
+static inline void accum_mono_sse2(samplepair_t *samp, __m128 v, __m128 lv, __m128 rv)
+{
+    __m128 l = _mm_mul_ps(v, lv);
+    __m128 r = _mm_mul_ps(v, rv);
+    float *p = (float *)samp;
+
+    _mm_storeu_ps(p + 0, _mm_add_ps(_mm_loadu_ps(p + 0), _mm_unpacklo_ps(l, r)));
+    _mm_storeu_ps(p + 4, _mm_add_ps(_mm_loadu_ps(p + 4), _mm_unpackhi_ps(l, r)));
+}
+
+// accumulates 2 interleaved stereo samples into 2 sample pairs
+static inline void accum_stereo_sse2(samplepair_t *samp, __m128 v, __m128 vol)
+{
+    float *p = (float *)samp;
+
+    _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(v, vol)));
+}
+
+PAINTFUNC(PaintMono8_SSE2)
+{
+    const uint8_t *sfx = data;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi32(128);
+    const __m128 lv = _mm_set1_ps(leftvol);
+    const __m128 rv = _mm_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(sfx + i)), zero);
+        __m128 lo = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpacklo_epi16(x, zero), bias));
+        __m128 hi = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpackhi_epi16(x, zero), bias));
+        accum_mono_sse2(samp + i + 0, lo, lv, rv);
+        accum_mono_sse2(samp + i + 4, hi, lv, rv);
+    }
+
+    PaintMono8_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoDmix8_SSE2)
+{
+    const uint8_t *sfx = data;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i bias = _mm_set1_epi32(256);
+    const __m128 lv = _mm_set1_ps(leftvol);
+    const __m128 rv = _mm_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(sfx + i * 2));
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), ones);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), ones);
+        accum_mono_sse2(samp + i + 0, _mm_cvtepi32_ps(_mm_sub_epi32(lo, bias)), lv, rv);
+        accum_mono_sse2(samp + i + 4, _mm_cvtepi32_ps(_mm_sub_epi32(hi, bias)), lv, rv);
+    }
+
+    PaintStereoDmix8_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoFull8_SSE2)
+{
+    const uint8_t *sfx = data;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi32(128);
+    const __m128 vol = _mm_setr_ps(leftvol, rightvol, leftvol, rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~3); i += 4) {
+        __m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(sfx + i * 2)), zero);
+        __m128 lo = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpacklo_epi16(x, zero), bias));
+        __m128 hi = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_unpackhi_epi16(x, zero), bias));
+        accum_stereo_sse2(samp + i + 0, lo, vol);
+        accum_stereo_sse2(samp + i + 2, hi, vol);
+    }
+
+    PaintStereoFull8_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintMono16_SSE2)
+{
+    const int16_t *sfx = data;
+    const __m128 lv = _mm_set1_ps(leftvol);
+    const __m128 rv = _mm_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(sfx + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+        accum_mono_sse2(samp + i + 0, lo, lv, rv);
+        accum_mono_sse2(samp + i + 4, hi, lv, rv);
+    }
+
+    PaintMono16_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoDmix16_SSE2)
+{
+    const int16_t *sfx = data;
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128 lv = _mm_set1_ps(leftvol);
+    const __m128 rv = _mm_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(sfx + i * 2 + 0));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(sfx + i * 2 + 8));
+        accum_mono_sse2(samp + i + 0, _mm_cvtepi32_ps(_mm_madd_epi16(lo, ones)), lv, rv);
+        accum_mono_sse2(samp + i + 4, _mm_cvtepi32_ps(_mm_madd_epi16(hi, ones)), lv, rv);
+    }
+
+    PaintStereoDmix16_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoFull16_SSE2)
+{
+    const int16_t *sfx = data;
+    const __m128 vol = _mm_setr_ps(leftvol, rightvol, leftvol, rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~3); i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(sfx + i * 2));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+        accum_stereo_sse2(samp + i + 0, lo, vol);
+        accum_stereo_sse2(samp + i + 2, hi, vol);
+    }
+
+    PaintStereoFull16_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+static void TransferStereo16_SSE2(int16_t *out, const samplepair_t *samp, int count)
+{
+    const float *p = (const float *)samp;
+    int i;
+
+    for (i = 0; i < (count & ~3); i += 4) {
+        __m128i lo = _mm_cvttps_epi32(_mm_loadu_ps(p + i * 2 + 0));
+        __m128i hi = _mm_cvttps_epi32(_mm_loadu_ps(p + i * 2 + 4));
+        _mm_storeu_si128((__m128i *)(out + i * 2), _mm_packs_epi32(lo, hi));
+    }
+
+    TransferStereo16_C(out + i * 2, samp + i, count - i);
+}
+
+static const mixfuncs_t mix_sse2 = {
+    .name = "sse2",
+    .features = CPU_SSE2,
+    .paint = {
+        PaintMono8_SSE2,
+        PaintStereoDmix8_SSE2,
+        PaintStereoFull8_SSE2,
+        PaintMono16_SSE2,
+        PaintStereoDmix16_SSE2,
+        PaintStereoFull16_SSE2,
+    },
+    .transfer_stereo16 = TransferStereo16_SSE2,
+};
+
+#endif // USE_SSE2
+
+/*
+===============================================================================
+
+AVX2 VERSIONS
+
+===============================================================================
+*/
+
+#if USE_AVX2
+
+#define PAINTFUNC_AVX2(name) \
+    q_target_avx2 PAINTFUNC(name)
+
+// accumulates 8 mono samples into 8 sample pairs
+static inline q_target_avx2
+void accum_mono_avx2(samplepair_t *samp, __m256 v, __m256 lv, __m256 rv)
+{
+    __m256 l = _mm256_mul_ps(v, lv);
+    __m256 r = _mm256_mul_ps(v, rv);
+    __m256 lo = _mm256_unpacklo_ps(l, r);
+    __m256 hi = _mm256_unpackhi_ps(l, r);
+    float *p = (float *)samp;
+
+    _mm256_storeu_ps(p + 0, _mm256_add_ps(_mm256_loadu_ps(p + 0), _mm256_permute2f128_ps(lo, hi, 0x20)));
+    _mm256_storeu_ps(p + 8, _mm256_add_ps(_mm256_loadu_ps(p + 8), _mm256_permute2f128_ps(lo, hi, 0x31)));
+}
+
+// accumulates 4 interleaved stereo samples into 4 sample pairs
+static inline q_target_avx2
+void accum_stereo_avx2(samplepair_t *samp, __m256 v, __m256 vol)
+{
+    float *p = (float *)samp;
+
+    _mm256_storeu_ps(p, _mm256_add_ps(_mm256_loadu_ps(p), _mm256_mul_ps(v, vol)));
+}
+
+PAINTFUNC_AVX2(PaintMono8_AVX2)
+{
+    const uint8_t *sfx = data;
+    const __m256i bias = _mm256_set1_epi32(128);
+    const __m256 lv = _mm256_set1_ps(leftvol);
+    const __m256 rv = _mm256_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(sfx + i)));
+        accum_mono_avx2(samp + i, _mm256_cvtepi32_ps(_mm256_sub_epi32(x, bias)), lv, rv);
+    }
+
+    PaintMono8_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC_AVX2(PaintStereoDmix8_AVX2)
+{
+    const uint8_t *sfx = data;
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i bias = _mm256_set1_epi32(256);
+    const __m256 lv = _mm256_set1_ps(leftvol);
+    const __m256 rv = _mm256_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(sfx + i * 2)));
+        __m256i sum = _mm256_sub_epi32(_mm256_madd_epi16(x, ones), bias);
+        accum_mono_avx2(samp + i, _mm256_cvtepi32_ps(sum), lv, rv);
+    }
+
+    PaintStereoDmix8_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC_AVX2(PaintStereoFull8_AVX2)
+{
+    const uint8_t *sfx = data;
+    const __m256i bias = _mm256_set1_epi32(128);
+    const __m256 vol = _mm256_setr_ps(leftvol, rightvol, leftvol, rightvol,
+                                      leftvol, rightvol, leftvol, rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~3); i += 4) {
+        __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(sfx + i * 2)));
+        accum_stereo_avx2(samp + i, _mm256_cvtepi32_ps(_mm256_sub_epi32(x, bias)), vol);
+    }
+
+    PaintStereoFull8_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC_AVX2(PaintMono16_AVX2)
+{
+    const int16_t *sfx = data;
+    const __m256 lv = _mm256_set1_ps(leftvol);
+    const __m256 rv = _mm256_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(sfx + i)));
+        accum_mono_avx2(samp + i, _mm256_cvtepi32_ps(x), lv, rv);
+    }
+
+    PaintMono16_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC_AVX2(PaintStereoDmix16_AVX2)
+{
+    const int16_t *sfx = data;
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256 lv = _mm256_set1_ps(leftvol);
+    const __m256 rv = _mm256_set1_ps(rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(sfx + i * 2));
+        accum_mono_avx2(samp + i, _mm256_cvtepi32_ps(_mm256_madd_epi16(x, ones)), lv, rv);
+    }
+
+    PaintStereoDmix16_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC_AVX2(PaintStereoFull16_AVX2)
+{
+    const int16_t *sfx = data;
+    const __m256 vol = _mm256_setr_ps(leftvol, rightvol, leftvol, rightvol,
+                                      leftvol, rightvol, leftvol, rightvol);
+    int i;
+
+    for (i = 0; i < (count & ~3); i += 4) {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(sfx + i * 2)));
+        accum_stereo_avx2(samp + i, _mm256_cvtepi32_ps(x), vol);
+    }
+
+    PaintStereoFull16_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+static q_target_avx2
+void TransferStereo16_AVX2(int16_t *out, const samplepair_t *samp, int count)
+{
+    const float *p = (const float *)samp;
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        __m256i lo = _mm256_cvttps_epi32(_mm256_loadu_ps(p + i * 2 + 0));
+        __m256i hi = _mm256_cvttps_epi32(_mm256_loadu_ps(p + i * 2 + 8));
+        __m256i x = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+        _mm256_storeu_si256((__m256i *)(out + i * 2), x);
+    }
+
+    TransferStereo16_C(out + i * 2, samp + i, count - i);
+}
+
+static const mixfuncs_t mix_avx2 = {
+    .name = "avx2",
+    .features = CPU_AVX2,
+    .paint = {
+        PaintMono8_AVX2,
+        PaintStereoDmix8_AVX2,
+        PaintStereoFull8_AVX2,
+        PaintMono16_AVX2,
+        PaintStereoDmix16_AVX2,
+        PaintStereoFull16_AVX2,
+    },
+    .transfer_stereo16 = TransferStereo16_AVX2,
+};
+
+#endif // USE_AVX2
+
+/*
+===============================================================================
+
+NEON VERSIONS
+
+===============================================================================
+*/
+
+#if USE_NEON
+
+// accumulates 4 mono samples into 4 sample pairs
+static inline void accum_mono_neon(samplepair_t *samp, float32x4_t v, float leftvol, float rightvol)
+{
+    float *p = (float *)samp;
+    float32x4x2_t s = vld2q_f32(p);
+
+    s.val[0] = vaddq_f32(s.val[0], vmulq_n_f32(v, leftvol));
+    s.val[1] = vaddq_f32(s.val[1], vmulq_n_f32(v, rightvol));
+    vst2q_f32(p, s);
+}
+
+// accumulates 4 deinterleaved stereo samples into 4 sample pairs
+static inline void accum_stereo_neon(samplepair_t *samp, float32x4_t l, float32x4_t r, float leftvol, float rightvol)
+{
+    float *p = (float *)samp;
+    float32x4x2_t s = vld2q_f32(p);
+
+    s.val[0] = vaddq_f32(s.val[0], vmulq_n_f32(l, leftvol));
+    s.val[1] = vaddq_f32(s.val[1], vmulq_n_f32(r, rightvol));
+    vst2q_f32(p, s);
+}
+
+#define CVT_LO_S16(x)   vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)))
+#define CVT_HI_S16(x)   vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)))
+
+PAINTFUNC(PaintMono8_NEON)
+{
+    const uint8_t *sfx = data;
+    const int16x8_t bias = vdupq_n_s16(128);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        int16x8_t x = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(sfx + i))), bias);
+        accum_mono_neon(samp + i + 0, CVT_LO_S16(x), leftvol, rightvol);
+        accum_mono_neon(samp + i + 4, CVT_HI_S16(x), leftvol, rightvol);
+    }
+
+    PaintMono8_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoDmix8_NEON)
+{
+    const uint8_t *sfx = data;
+    const int16x8_t bias = vdupq_n_s16(256);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        uint8x8x2_t x = vld2_u8(sfx + i * 2);
+        int16x8_t sum = vsubq_s16(vreinterpretq_s16_u16(vaddl_u8(x.val[0], x.val[1])), bias);
+        accum_mono_neon(samp + i + 0, CVT_LO_S16(sum), leftvol, rightvol);
+        accum_mono_neon(samp + i + 4, CVT_HI_S16(sum), leftvol, rightvol);
+    }
+
+    PaintStereoDmix8_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoFull8_NEON)
+{
+    const uint8_t *sfx = data;
+    const int16x8_t bias = vdupq_n_s16(128);
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        uint8x8x2_t x = vld2_u8(sfx + i * 2);
+        int16x8_t l = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(x.val[0])), bias);
+        int16x8_t r = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(x.val[1])), bias);
+        accum_stereo_neon(samp + i + 0, CVT_LO_S16(l), CVT_LO_S16(r), leftvol, rightvol);
+        accum_stereo_neon(samp + i + 4, CVT_HI_S16(l), CVT_HI_S16(r), leftvol, rightvol);
+    }
+
+    PaintStereoFull8_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintMono16_NEON)
+{
+    const int16_t *sfx = data;
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        int16x8_t x = vld1q_s16(sfx + i);
+        accum_mono_neon(samp + i + 0, CVT_LO_S16(x), leftvol, rightvol);
+        accum_mono_neon(samp + i + 4, CVT_HI_S16(x), leftvol, rightvol);
+    }
+
+    PaintMono16_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoDmix16_NEON)
+{
+    const int16_t *sfx = data;
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        int16x8x2_t x = vld2q_s16(sfx + i * 2);
+        int32x4_t lo = vaddl_s16(vget_low_s16(x.val[0]), vget_low_s16(x.val[1]));
+        int32x4_t hi = vaddl_s16(vget_high_s16(x.val[0]), vget_high_s16(x.val[1]));
+        accum_mono_neon(samp + i + 0, vcvtq_f32_s32(lo), leftvol, rightvol);
+        accum_mono_neon(samp + i + 4, vcvtq_f32_s32(hi), leftvol, rightvol);
+    }
+
+    PaintStereoDmix16_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+PAINTFUNC(PaintStereoFull16_NEON)
+{
+    const int16_t *sfx = data;
+    int i;
+
+    for (i = 0; i < (count & ~7); i += 8) {
+        int16x8x2_t x = vld2q_s16(sfx + i * 2);
+        accum_stereo_neon(samp + i + 0, CVT_LO_S16(x.val[0]), CVT_LO_S16(x.val[1]), leftvol, rightvol);
+        accum_stereo_neon(samp + i + 4, CVT_HI_S16(x.val[0]), CVT_HI_S16(x.val[1]), leftvol, rightvol);
+    }
+
+    PaintStereoFull16_C(samp + i, sfx + i * 2, count - i, leftvol, rightvol);
+}
+
+static void TransferStereo16_NEON(int16_t *out, const samplepair_t *samp, int count)
+{
+    const float *p = (const float *)samp;
+    int i;
+
+    for (i = 0; i < (count & ~3); i += 4) {
+        int32x4_t lo = vcvtq_s32_f32(vld1q_f32(p + i * 2 + 0));
+        int32x4_t hi = vcvtq_s32_f32(vld1q_f32(p + i * 2 + 4));
+        vst1q_s16(out + i * 2, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+
+    TransferStereo16_C(out + i * 2, samp + i, count - i);
+}
+
+static const mixfuncs_t mix_neon = {
+    .name = "neon",
+    .features = CPU_NEON,
+    .paint = {
+        PaintMono8_NEON,
+        PaintStereoDmix8_NEON,
+        PaintStereoFull8_NEON,
+        PaintMono16_NEON,
+        PaintStereoDmix16_NEON,
+        PaintStereoFull16_NEON,
+    },
+    .transfer_stereo16 = TransferStereo16_NEON,
+};
+
+#endif // USE_NEON
+
+/*
+===============================================================================
+
+DISPATCH
+
+===============================================================================
+*/
+
+const mixfuncs_t *const mix_funcs[] = {
+#if USE_AVX2
+    &mix_avx2,
+#endif
+#if USE_SSE2
+    &mix_sse2,
+#endif
+#if USE_NEON
+    &mix_neon,
+#endif
+    &mix_c,
+    NULL
+};
+
+// picks the best set of kernels supported by CPU
+const mixfuncs_t *S_GetMixFuncs(void)
+{
+    unsigned features = Com_GetCpuFeatures();
+
+    for (int i = 0; mix_funcs[i]; i++)
+        if ((mix_funcs[i]->features & features) == mix_funcs[i]->features)
+            return mix_funcs[i];
+
+    return &mix_c;
+}
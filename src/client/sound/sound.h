@@ -35,6 +35,7 @@ typedef struct {
     int         width;
     int         channels;
     int         size;
+    unsigned    lru_sequence;   // bumped on each cache hit
 #if USE_OPENAL
     unsigned    bufnum;
 #endif
@@ -49,6 +50,7 @@ typedef struct {
     sfxcache_t  *cache;
     unsigned    registration_sequence;
     int         error;
+    void        *pending;       // async load in progress
 } sfx_t;
 
 #define PS_FIRST(list)      LIST_FIRST(playsound_t, list, entry)
@@ -98,8 +100,16 @@ typedef struct {
     int         loopstart;
     int         samples;
     byte        *data;
+    char        error[64];
 } wavinfo_t;
 
+typedef struct {
+    unsigned    hits;
+    unsigned    misses;
+    unsigned    evictions;
+    unsigned    pending;
+} sndcachestats_t;
+
 /*
 ====================================================================
 
@@ -127,10 +137,33 @@ typedef struct {
     void (*stop_channel)(channel_t *ch);
     void (*stop_all_sounds)(void);
     int (*get_sample_rate)(void);
+    void (*sync_mixer)(void);
+    float (*get_mixer_time)(void);
 } sndapi_t;
 
 #if USE_SNDDMA
 extern const sndapi_t   snd_dma;
+
+typedef struct {
+    float   left;
+    float   right;
+} samplepair_t;
+
+typedef void (*paintfunc_t)(samplepair_t *samp, const void *data, int count, float leftvol, float rightvol);
+
+// paint functions are indexed by sample format:
+// mono 8, stereo downmix 8, stereo full 8, mono 16, stereo downmix 16, stereo full 16
+typedef struct {
+    const char  *name;
+    unsigned    features;
+    paintfunc_t paint[6];
+    void        (*transfer_stereo16)(int16_t *out, const samplepair_t *samp, int count);
+} mixfuncs_t;
+
+extern const mixfuncs_t mix_c;
+extern const mixfuncs_t *const mix_funcs[];
+
+const mixfuncs_t *S_GetMixFuncs(void);
 #endif
 
 #if USE_OPENAL
@@ -163,6 +196,10 @@ extern list_t       s_pendingplays;
 
 extern wavinfo_t    s_info;
 
+extern sndcachestats_t  s_cachestats;
+
+extern bool         s_registering;
+
 extern cvar_t       *s_volume;
 extern cvar_t       *s_ambient;
 #if USE_DEBUG
@@ -170,6 +207,7 @@ extern cvar_t       *s_show;
 #endif
 extern cvar_t       *s_underwater;
 extern cvar_t       *s_underwater_gain_hf;
+extern cvar_t       *s_async;
 
 #define S_IsFullVolume(ch) \
     ((ch)->entnum == -1 || (ch)->entnum == listener_entnum || (ch)->dist_mult == 0)
@@ -186,6 +224,7 @@ extern cvar_t       *s_underwater_gain_hf;
 
 sfx_t *S_SfxForHandle(qhandle_t hSfx);
 sfxcache_t *S_LoadSound(sfx_t *s);
+void S_TrimSoundCache(const sfx_t *keep);
 channel_t *S_PickChannel(int entnum, int entchannel);
 void S_IssuePlaysound(playsound_t *ps);
 int S_BuildSoundList(int *sounds);
@@ -308,6 +308,22 @@ static int BSP_ValidateTree(bsp_t *bsp)
     return Q_ERR_SUCCESS;
 }
 
+// BSP_ValidateTree ensures that each node and leaf has at most one parent,
+// so the linear tree has no more entries than nodes and leafs combined
+static void BSP_BuildLinearTree(bsp_t *bsp)
+{
+    mlnode_t *out;
+    int i;
+
+    bsp->lnodes = out = BSP_ALLOC(sizeof(*out) * (bsp->numnodes + bsp->numleafs));
+
+    for (i = 0; i < bsp->nummodels; i++)
+        if (!bsp->models[i].headnode->lnode)
+            out = BSP_LinearizeTree(out, bsp->models[i].headnode);
+
+    bsp->numlnodes = out - bsp->lnodes;
+}
+
 // also calculates the last portal number used
 // by CM code to allocate portalopen[] array
 static int BSP_ValidateAreaPortals(bsp_t *bsp)
@@ -838,6 +854,10 @@ int BSP_Load(const char *name, bsp_t **bsp_p)
 
         // round to cacheline
         memsize += Q_ALIGN(count * info->memsize, BSP_ALIGN);
+
+        // nodes and leafs also get linearized copies
+        if (info->load[0] == BSP_LoadNodes || info->load[0] == BSP_LoadLeafs)
+            memsize += Q_ALIGN(count * sizeof(mlnode_t), BSP_ALIGN);
         maxpos = max(maxpos, ofs + len);
     }
 
@@ -876,6 +896,8 @@ int BSP_Load(const char *name, bsp_t **bsp_p)
         goto fail1;
     }
 
+    BSP_BuildLinearTree(bsp);
+
 #if USE_REF
     // load extension lumps
     for (i = 0; i < q_countof(bspx_lumps); i++) {
@@ -1124,16 +1146,48 @@ overrun:
     }
 }
 
-const mleaf_t *BSP_PointLeaf(const mnode_t *node, const vec3_t p)
+/*
+==================
+BSP_LinearizeTree
+
+Stores the tree rooted at `node' into `out' in depth-first order and returns
+pointer past the last entry written. Leafs shared by multiple nodes are
+stored multiple times.
+==================
+*/
+mlnode_t *BSP_LinearizeTree(mlnode_t *out, mnode_t *node)
 {
-    float d;
+    mlnode_t *n = out++;
 
-    while (node->plane) {
-        d = PlaneDiffFast(p, node->plane);
-        node = node->children[d < 0];
+    if (!node->lnode)
+        node->lnode = n;
+
+    if (!node->plane) {
+        n->leaf = (const mleaf_t *)node;
+        n->type = -1;
+        n->children[0] = n->children[1] = 0;
+        return out;
     }
 
-    return (const mleaf_t *)node;
+    VectorCopy(node->plane->normal, n->normal);
+    n->dist = node->plane->dist;
+    n->type = node->plane->type;
+
+    n->children[0] = out - n;
+    out = BSP_LinearizeTree(out, node->children[0]);
+
+    n->children[1] = out - n;
+    return BSP_LinearizeTree(out, node->children[1]);
+}
+
+const mleaf_t *BSP_PointLeaf(const mnode_t *node, const vec3_t p)
+{
+    const mlnode_t *n = node->lnode;
+
+    while (n->type >= 0)
+        n += n->children[BSP_PlaneDiff(p, n) < 0];
+
+    return n->leaf;
 }
 
 /*
@@ -260,6 +260,7 @@ const mleaf_t *CM_LeafNum(const cm_t *cm, int number)
 static cplane_t box_planes[12];
 static mnode_t  box_nodes[6];
 static mnode_t  *box_headnode;
+static mlnode_t box_lnodes[13];
 static mbrush_t box_brush;
 static mbrush_t *box_leafbrush;
 static mbrushside_t box_brushsides[6];
@@ -321,6 +322,8 @@ static void CM_InitBoxHull(void)
         p->signbits = 1 << (i >> 1);
         p->normal[i >> 1] = -1;
     }
+
+    BSP_LinearizeTree(box_lnodes, box_headnode);
 }
 
 /*
@@ -346,6 +349,9 @@ const mnode_t *CM_HeadnodeForBox(const vec3_t mins, const vec3_t maxs)
     box_planes[10].dist = mins[2];
     box_planes[11].dist = -mins[2];
 
+    for (int i = 0; i < 6; i++)
+        box_nodes[i].lnode->dist = box_planes[i * 2].dist;
+
     return box_headnode;
 }
 
@@ -356,52 +362,54 @@ CM_BoxLeafnums
 Fills in a list of all the leafs touched
 =============
 */
-static int              leaf_count, leaf_maxcount;
-static const mleaf_t    **leaf_list;
-static const vec_t      *leaf_mins, *leaf_maxs;
-static const mnode_t    *leaf_topnode;
-
-static void CM_BoxLeafs_r(const mnode_t *node)
+typedef struct {
+    int             count, maxcount;
+    const mleaf_t   **list;
+    const vec_t     *mins, *maxs;
+    const mnode_t   *topnode;
+} leafwork_t;
+
+static void CM_BoxLeafs_r(leafwork_t *w, const mnode_t *node)
 {
     while (node->plane) {
-        box_plane_t s = BoxOnPlaneSideFast(leaf_mins, leaf_maxs, node->plane);
+        box_plane_t s = BoxOnPlaneSideFast(w->mins, w->maxs, node->plane);
         if (s == BOX_INFRONT) {
             node = node->children[0];
         } else if (s == BOX_BEHIND) {
             node = node->children[1];
         } else {
             // go down both
-            if (!leaf_topnode) {
-                leaf_topnode = node;
+            if (!w->topnode) {
+                w->topnode = node;
             }
-            CM_BoxLeafs_r(node->children[0]);
+            CM_BoxLeafs_r(w, node->children[0]);
             node = node->children[1];
         }
     }
 
-    if (leaf_count < leaf_maxcount) {
-        leaf_list[leaf_count++] = (const mleaf_t *)node;
+    if (w->count < w->maxcount) {
+        w->list[w->count++] = (const mleaf_t *)node;
     }
 }
 
+// state is kept on stack, MVD channels may be linked from multiple threads
 int CM_BoxLeafs_headnode(const vec3_t mins, const vec3_t maxs,
                          const mleaf_t **list, int listsize,
                          const mnode_t *headnode, const mnode_t **topnode)
 {
-    leaf_list = list;
-    leaf_count = 0;
-    leaf_maxcount = listsize;
-    leaf_mins = mins;
-    leaf_maxs = maxs;
-
-    leaf_topnode = NULL;
+    leafwork_t w = {
+        .maxcount = listsize,
+        .list = list,
+        .mins = mins,
+        .maxs = maxs,
+    };
 
-    CM_BoxLeafs_r(headnode);
+    CM_BoxLeafs_r(&w, headnode);
 
     if (topnode)
-        *topnode = leaf_topnode;
+        *topnode = w.topnode;
 
-    return leaf_count;
+    return w.count;
 }
 
 /*
@@ -656,9 +664,8 @@ CM_RecursiveHullCheck
 
 ==================
 */
-static void CM_RecursiveHullCheck(const mnode_t *node, float p1f, float p2f, const vec3_t p1, const vec3_t p2)
+static void CM_RecursiveHullCheck(const mlnode_t *node, float p1f, float p2f, const vec3_t p1, const vec3_t p2)
 {
-    const cplane_t  *plane;
     float       t1, t2, offset;
     float       frac, frac2;
     float       idist;
@@ -670,10 +677,9 @@ static void CM_RecursiveHullCheck(const mnode_t *node, float p1f, float p2f, con
         return;     // already hit something nearer
 
 recheck:
-    // if plane is NULL, we are in a leaf node
-    plane = node->plane;
-    if (!plane) {
-        CM_TraceToLeaf((const mleaf_t *)node);
+    // if type is negative, we are in a leaf node
+    if (node->type < 0) {
+        CM_TraceToLeaf(node->leaf);
         return;
     }
 
@@ -681,6 +687,92 @@ recheck:
     // find the point distances to the separating plane
     // and the offset for the size of the box
     //
+    if (node->type < 3) {
+        t1 = p1[node->type] - node->dist;
+        t2 = p2[node->type] - node->dist;
+        offset = trace_extents[node->type];
+    } else {
+        t1 = PlaneDiff(p1, node);
+        t2 = PlaneDiff(p2, node);
+        if (trace_ispoint)
+            offset = 0;
+        else
+            offset = fabsf(trace_extents[0] * node->normal[0]) +
+                     fabsf(trace_extents[1] * node->normal[1]) +
+                     fabsf(trace_extents[2] * node->normal[2]);
+    }
+
+    // see which sides we need to consider
+    if (t1 >= offset && t2 >= offset) {
+        node += node->children[0];
+        goto recheck;
+    }
+    if (t1 < -offset && t2 < -offset) {
+        node += node->children[1];
+        goto recheck;
+    }
+
+    // put the crosspoint DIST_EPSILON pixels on the near side
+    if (t1 < t2) {
+        idist = 1.0f / (t1 - t2);
+        side = 1;
+        frac2 = (t1 + offset + DIST_EPSILON) * idist;
+        frac = (t1 - offset + DIST_EPSILON) * idist;
+    } else if (t1 > t2) {
+        idist = 1.0f / (t1 - t2);
+        side = 0;
+        frac2 = (t1 - offset - DIST_EPSILON) * idist;
+        frac = (t1 + offset + DIST_EPSILON) * idist;
+    } else {
+        side = 0;
+        frac = 1;
+        frac2 = 0;
+    }
+
+    frac = Q_clipf(frac, 0, 1);
+    frac2 = Q_clipf(frac2, 0, 1);
+
+    // move up to the node
+    midf = p1f + (p2f - p1f) * frac;
+    LerpVector(p1, p2, frac, mid);
+
+    CM_RecursiveHullCheck(node + node->children[side], p1f, midf, p1, mid);
+
+    // go past the node
+    midf = p1f + (p2f - p1f) * frac2;
+    LerpVector(p1, p2, frac2, mid);
+
+    CM_RecursiveHullCheck(node + node->children[side ^ 1], midf, p2f, mid, p2);
+}
+
+static void CM_HullCheck(const mnode_t *headnode, const vec3_t start, const vec3_t end)
+{
+    CM_RecursiveHullCheck(headnode->lnode, 0, 1, start, end);
+}
+
+#if USE_TESTS
+
+// reference version that walks pointer linked nodes, for benchmarking
+static void CM_RecursiveHullCheckNodes(const mnode_t *node, float p1f, float p2f, const vec3_t p1, const vec3_t p2)
+{
+    const cplane_t  *plane;
+    float       t1, t2, offset;
+    float       frac, frac2;
+    float       idist;
+    vec3_t      mid;
+    int         side;
+    float       midf;
+
+    if (trace_trace->fraction <= p1f)
+        return;     // already hit something nearer
+
+recheck:
+    plane = node->plane;
+    if (!plane) {
+        CM_TraceToLeaf((const mleaf_t *)node);
+        return;
+    }
+
     if (plane->type < 3) {
         t1 = p1[plane->type] - plane->dist;
         t2 = p2[plane->type] - plane->dist;
@@ -696,7 +788,6 @@ recheck:
                      fabsf(trace_extents[2] * plane->normal[2]);
     }
 
-    // see which sides we need to consider
     if (t1 >= offset && t2 >= offset) {
         node = node->children[0];
         goto recheck;
@@ -706,7 +797,6 @@ recheck:
         goto recheck;
     }
 
-    // put the crosspoint DIST_EPSILON pixels on the near side
     if (t1 < t2) {
         idist = 1.0f / (t1 - t2);
         side = 1;
@@ -726,31 +816,33 @@ recheck:
     frac = Q_clipf(frac, 0, 1);
     frac2 = Q_clipf(frac2, 0, 1);
 
-    // move up to the node
     midf = p1f + (p2f - p1f) * frac;
     LerpVector(p1, p2, frac, mid);
 
-    CM_RecursiveHullCheck(node->children[side], p1f, midf, p1, mid);
+    CM_RecursiveHullCheckNodes(node->children[side], p1f, midf, p1, mid);
 
-    // go past the node
     midf = p1f + (p2f - p1f) * frac2;
     LerpVector(p1, p2, frac2, mid);
 
-    CM_RecursiveHullCheck(node->children[side ^ 1], midf, p2f, mid, p2);
+    CM_RecursiveHullCheckNodes(node->children[side ^ 1], midf, p2f, mid, p2);
 }
 
+static void CM_HullCheckNodes(const mnode_t *headnode, const vec3_t start, const vec3_t end)
+{
+    CM_RecursiveHullCheckNodes(headnode, 0, 1, start, end);
+}
+
+#endif
+
 //======================================================================
 
-/*
-==================
-CM_BoxTrace
-==================
-*/
-void CM_BoxTrace(trace_t *trace,
-                 const vec3_t start, const vec3_t end,
-                 const vec3_t mins, const vec3_t maxs,
-                 const mnode_t *headnode, int brushmask,
-                 bool extended)
+typedef void (*hullcheck_t)(const mnode_t *headnode, const vec3_t start, const vec3_t end);
+
+static void CM_BoxTrace_(trace_t *trace,
+                         const vec3_t start, const vec3_t end,
+                         const vec3_t mins, const vec3_t maxs,
+                         const mnode_t *headnode, int brushmask,
+                         bool extended, hullcheck_t hullcheck)
 {
     const vec_t *bounds[2] = { mins, maxs };
     int i, j;
@@ -813,7 +905,7 @@ void CM_BoxTrace(trace_t *trace,
     //
     // general sweeping through world
     //
-    CM_RecursiveHullCheck(headnode, 0, 1, start, end);
+    hullcheck(headnode, start, end);
 
     if (trace_trace->fraction == 1)
         VectorCopy(end, trace_trace->endpos);
@@ -821,6 +913,31 @@ void CM_BoxTrace(trace_t *trace,
         LerpVector(start, end, trace_trace->fraction, trace_trace->endpos);
 }
 
+/*
+==================
+CM_BoxTrace
+==================
+*/
+void CM_BoxTrace(trace_t *trace,
+                 const vec3_t start, const vec3_t end,
+                 const vec3_t mins, const vec3_t maxs,
+                 const mnode_t *headnode, int brushmask,
+                 bool extended)
+{
+    CM_BoxTrace_(trace, start, end, mins, maxs, headnode, brushmask, extended, CM_HullCheck);
+}
+
+#if USE_TESTS
+void CM_BoxTraceNodes(trace_t *trace,
+                      const vec3_t start, const vec3_t end,
+                      const vec3_t mins, const vec3_t maxs,
+                      const mnode_t *headnode, int brushmask,
+                      bool extended)
+{
+    CM_BoxTrace_(trace, start, end, mins, maxs, headnode, brushmask, extended, CM_HullCheckNodes);
+}
+#endif
+
 /*
 ==================
 CM_TransformedBoxTrace
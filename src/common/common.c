@@ -21,17 +21,20 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //
 
 #include "shared/shared.h"
+#include "shared/atomic.h"
 
 #include "common/async.h"
 #include "common/bsp.h"
 #include "common/cmd.h"
 #include "common/cmodel.h"
 #include "common/common.h"
+#include "common/cpu.h"
 #include "common/cvar.h"
 #include "common/error.h"
 #include "common/field.h"
 #include "common/fifo.h"
 #include "common/files.h"
+#include "common/jobs.h"
 #include "common/math.h"
 #include "common/mdfour.h"
 #include "common/msg.h"
@@ -48,6 +51,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server/server.h"
 #include "system/system.h"
 #include "system/hunk.h"
+#include "system/pthread.h"
 
 #if USE_DEBUG
 #include "features.h"
@@ -90,6 +94,7 @@ cvar_t  *logfile_enable;    // 1 = create new, 2 = append to existing
 cvar_t  *logfile_flush;     // 1 = flush after each print
 cvar_t  *logfile_name;
 cvar_t  *logfile_prefix;
+cvar_t  *logfile_async;
 #if USE_SYSCON
 cvar_t  *console_prefix;
 #endif
@@ -217,14 +222,214 @@ static void Com_Redirect(const char *msg, size_t total)
     }
 }
 
+/*
+==============================================================================
+
+LOG WRITER
+
+Formatted log file output is appended to a single producer, single consumer
+ring buffer and written to disk by a background thread, so that slow storage
+never stalls the main thread. Producer side is lock-free: the mutex is only
+taken to wake up the writer thread when it is idle. When the ring is full,
+messages are dropped and counted instead of blocking.
+
+==============================================================================
+*/
+
+#define LOG_RING_SIZE   0x40000             // must be power of two
+#define LOG_RING_MASK   (LOG_RING_SIZE * 2 - 1)
+
+static struct {
+    char            data[LOG_RING_SIZE];
+    atomic_int      head;       // advanced by main thread only
+    atomic_int      tail;       // advanced by writer thread only
+    atomic_int      sleeping;
+    atomic_int      error;
+    qhandle_t       file;
+    bool            running;
+    bool            terminate;
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  idle_cond;
+
+    // statistics, main thread only
+    unsigned        queued;
+    unsigned        dropped;
+    unsigned        total_dropped;
+    unsigned        syncs;
+} logring;
+
+static void *logring_func(void *arg)
+{
+    while (1) {
+        int tail = atomic_load(&logring.tail);
+        int head = atomic_load(&logring.head);
+
+        if (head == tail) {
+            bool terminate;
+
+            pthread_mutex_lock(&logring.lock);
+            pthread_cond_broadcast(&logring.idle_cond);
+            atomic_store(&logring.sleeping, 1);
+            while (atomic_load(&logring.head) == tail && !logring.terminate)
+                pthread_cond_wait(&logring.work_cond, &logring.lock);
+            atomic_store(&logring.sleeping, 0);
+            terminate = logring.terminate && atomic_load(&logring.head) == tail;
+            pthread_mutex_unlock(&logring.lock);
+
+            if (terminate)
+                break;
+            continue;
+        }
+
+        // write everything up to the end of buffer in one go
+        int pos = tail & (LOG_RING_SIZE - 1);
+        int len = min((head - tail) & LOG_RING_MASK, LOG_RING_SIZE - pos);
+
+        // keep consuming after error so that producer never blocks
+        if (!atomic_load(&logring.error)) {
+            int ret = FS_Write(logring.data + pos, len, logring.file);
+            if (ret != len)
+                atomic_store(&logring.error, ret < 0 ? ret : Q_ERR_FAILURE);
+        }
+
+        atomic_store(&logring.tail, (tail + len) & LOG_RING_MASK);
+    }
+
+    return NULL;
+}
+
+static void logring_wakeup(void)
+{
+    if (atomic_load(&logring.sleeping)) {
+        pthread_mutex_lock(&logring.lock);
+        pthread_cond_signal(&logring.work_cond);
+        pthread_mutex_unlock(&logring.lock);
+    }
+}
+
+static bool logring_append(const char *text, size_t len)
+{
+    int head = atomic_load(&logring.head);
+    int tail = atomic_load(&logring.tail);
+    size_t space = LOG_RING_SIZE - ((head - tail) & LOG_RING_MASK);
+    size_t pos, n;
+
+    if (len > space)
+        return false;
+
+    pos = head & (LOG_RING_SIZE - 1);
+    n = min(len, LOG_RING_SIZE - pos);
+    memcpy(logring.data + pos, text, n);
+    memcpy(logring.data, text + n, len - n);
+
+    atomic_store(&logring.head, (head + (int)len) & LOG_RING_MASK);
+    return true;
+}
+
+static void logring_write(const char *text, size_t len)
+{
+    if (logring.dropped) {
+        char buf[MAX_QPATH];
+        size_t n = Q_scnprintf(buf, sizeof(buf), "*** %u messages dropped ***\n",
+                               logring.dropped);
+
+        // only emit the notice if the message itself fits too
+        if (n + len > LOG_RING_SIZE - ((atomic_load(&logring.head) -
+            atomic_load(&logring.tail)) & LOG_RING_MASK)) {
+            logring.dropped++;
+            logring.total_dropped++;
+            return;
+        }
+
+        logring_append(buf, n);
+        logring.dropped = 0;
+    }
+
+    if (logring_append(text, len)) {
+        logring.queued++;
+        logring_wakeup();
+    } else {
+        logring.dropped++;
+        logring.total_dropped++;
+    }
+}
+
+// waits until everything queued so far has been handed to the filesystem
+static void logring_sync(void)
+{
+    if (!logring.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&logring.lock);
+    while (atomic_load(&logring.tail) != atomic_load(&logring.head)) {
+        pthread_cond_signal(&logring.work_cond);
+        pthread_cond_wait(&logring.idle_cond, &logring.lock);
+    }
+    pthread_mutex_unlock(&logring.lock);
+
+    logring.syncs++;
+}
+
+static void logring_start(qhandle_t f)
+{
+    static bool initialized;
+
+    if (!initialized) {
+        pthread_mutex_init(&logring.lock, NULL);
+        pthread_cond_init(&logring.work_cond, NULL);
+        pthread_cond_init(&logring.idle_cond, NULL);
+        initialized = true;
+    }
+
+    atomic_store(&logring.head, 0);
+    atomic_store(&logring.tail, 0);
+    atomic_store(&logring.sleeping, 0);
+    atomic_store(&logring.error, 0);
+    logring.file = f;
+    logring.terminate = false;
+    logring.queued = logring.dropped = logring.total_dropped = logring.syncs = 0;
+
+    if (pthread_create(&logring.thread, NULL, logring_func, NULL)) {
+        Com_WPrintf("Couldn't create log writer thread, logging synchronously\n");
+        return;
+    }
+
+    logring.running = true;
+}
+
+// drains the ring and stops writer thread, all further output is synchronous
+static void logring_stop(void)
+{
+    if (!logring.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&logring.lock);
+    logring.terminate = true;
+    pthread_cond_signal(&logring.work_cond);
+    pthread_mutex_unlock(&logring.lock);
+
+    pthread_join(logring.thread, NULL);
+    logring.running = false;
+}
+
 static void logfile_close(void)
 {
     if (!com_logFile) {
         return;
     }
 
+    if (logring.running) {
+        Com_DPrintf("Log writer: %u messages queued, %u dropped, %u syncs\n",
+                    logring.queued, logring.total_dropped, logring.syncs);
+    }
+
     Com_Printf("Closing console log.\n");
 
+    logring_stop();
     FS_CloseFile(com_logFile);
     com_logFile = 0;
 }
@@ -253,6 +458,9 @@ static void logfile_open(void)
 
     com_logFile = f;
     com_logNewline = false;
+    if (logfile_async->integer) {
+        logring_start(f);
+    }
     Com_Printf("Logging console to %s\n", buffer);
 }
 
@@ -333,9 +541,20 @@ static void logfile_write(print_type_t type, const char *text)
     format_prefix(type, prefix, sizeof(prefix));
 
     size_t len = prefix_lines(buf, sizeof(buf), text, prefix, &com_logNewline);
-    int ret = FS_Write(buf, len, com_logFile);
-    if (ret == len) {
-        return;
+    int ret;
+
+    if (logring.running) {
+        ret = atomic_load(&logring.error);
+        if (!ret) {
+            logring_write(buf, len);
+            return;
+        }
+        logring_stop();
+    } else {
+        ret = FS_Write(buf, len, com_logFile);
+        if (ret == len) {
+            return;
+        }
     }
 
     // zero handle BEFORE doing anything else to avoid recursion
@@ -578,6 +797,9 @@ void Com_Error(error_type_t code, const char *fmt, ...)
         goto abort;
     }
 
+    // write out everything queued before going synchronous
+    logring_stop();
+
     if (com_logFile) {
         FS_FPrintf(com_logFile, "FATAL: %s\n", com_errorMsg);
     }
@@ -594,6 +816,7 @@ void Com_Error(error_type_t code, const char *fmt, ...)
 
 abort:
     if (com_logFile) {
+        logring_sync();
         FS_Flush(com_logFile);
     }
     com_errorEntered = false;
@@ -634,6 +857,7 @@ void Com_Quit(const char *reason, error_type_t type)
     logfile_close();
     FS_Shutdown();
     Com_ShutdownAsyncWork();
+    Com_ShutdownJobs();
 
     Sys_Quit();
     // doesn't get there
@@ -913,6 +1137,7 @@ void Qcommon_Init(int argc, char **argv)
     logfile_flush = Cvar_Get("logfile_flush", "0", 0);
     logfile_name = Cvar_Get("logfile_name", "console", 0);
     logfile_prefix = Cvar_Get("logfile_prefix", "[%Y-%m-%d %H:%M] ", 0);
+    logfile_async = Cvar_Get("logfile_async", "0", 0);
 #if USE_SYSCON
     console_prefix = Cvar_Get("console_prefix", "", 0);
 #endif
@@ -994,6 +1219,7 @@ void Qcommon_Init(int argc, char **argv)
     logfile_enable->changed = logfile_enable_changed;
     logfile_flush->changed = logfile_param_changed;
     logfile_name->changed = logfile_param_changed;
+    logfile_async->changed = logfile_param_changed;
     logfile_enable_changed(logfile_enable);
 
     FS_AddConfigFiles(true);
@@ -1007,6 +1233,8 @@ void Qcommon_Init(int argc, char **argv)
     Cmd_AddCommand("recycle", Com_Recycle_f);
 #endif
 
+    Com_InitCpuFeatures();
+    Com_InitJobs();
     Netchan_Init();
     NET_Init();
     BSP_Init();
@@ -1065,6 +1293,7 @@ void Qcommon_Frame(void)
 #endif
     unsigned oldtime, msec;
     static unsigned remaining;
+    static uint64_t deadline;
     static float frac;
 
     if (setjmp(com_abortframe)) {
@@ -1082,7 +1311,10 @@ void Qcommon_Frame(void)
 
     // sleep on network sockets when running a dedicated server
     // still do a select(), but don't sleep when running a client!
-    NET_Sleep(remaining);
+    if (deadline)
+        NET_SleepUntil(deadline);
+    else
+        NET_Sleep(remaining);
 
     // calculate time spent running last frame and sleeping
     oldtime = com_eventTime;
@@ -1135,6 +1367,7 @@ void Qcommon_Frame(void)
     NET_UpdateStats();
 
     remaining = SV_Frame(msec);
+    deadline = SV_FrameDeadline();
 
 #if USE_CLIENT
     if (host_speeds->integer)
@@ -0,0 +1,124 @@
+/*
+Copyright (C) 2024 Andrey Nazarov
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "shared/shared.h"
+#include "common/common.h"
+#include "common/cpu.h"
+#include "common/cvar.h"
+
+#if CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+static unsigned cpu_features;
+static bool     cpu_detected;
+static cvar_t   *sys_simd;
+
+#if CPU_X86
+
+static void get_cpuid(unsigned leaf, unsigned sub, unsigned regs[4])
+{
+#ifdef _MSC_VER
+    __cpuidex((int *)regs, leaf, sub);
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t get_xcr0(void)
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static unsigned detect_features(void)
+{
+    unsigned regs[4], max_leaf, features = 0;
+
+    get_cpuid(0, 0, regs);
+    max_leaf = regs[0];
+    if (max_leaf < 1)
+        return 0;
+
+    get_cpuid(1, 0, regs);
+    if (USE_SSE2 && regs[3] & BIT(26))
+        features |= CPU_SSE2;
+
+    // AVX2 requires OS support for saving YMM state
+    if (max_leaf >= 7 && (regs[2] & (BIT(27) | BIT(28))) == (BIT(27) | BIT(28)) &&
+        (get_xcr0() & 6) == 6) {
+        get_cpuid(7, 0, regs);
+        if (USE_AVX2 && regs[1] & BIT(5))
+            features |= CPU_AVX2;
+    }
+
+    return features;
+}
+
+#else
+
+static unsigned detect_features(void)
+{
+    return USE_NEON ? CPU_NEON : 0;
+}
+
+#endif
+
+unsigned Com_GetCpuFeatures(void)
+{
+    if (!cpu_detected) {
+        cpu_features = detect_features();
+        cpu_detected = true;
+    }
+
+    if (sys_simd && !sys_simd->integer)
+        return 0;
+
+    return cpu_features;
+}
+
+const char *Com_CpuFeatureString(unsigned features)
+{
+    static char buffer[32];
+
+    *buffer = 0;
+    if (features & CPU_SSE2)
+        Q_strlcat(buffer, " sse2", sizeof(buffer));
+    if (features & CPU_AVX2)
+        Q_strlcat(buffer, " avx2", sizeof(buffer));
+    if (features & CPU_NEON)
+        Q_strlcat(buffer, " neon", sizeof(buffer));
+
+    return *buffer ? buffer + 1 : "none";
+}
+
+void Com_InitCpuFeatures(void)
+{
+    sys_simd = Cvar_Get("sys_simd", "1", 0);
+
+    Com_DPrintf("CPU features: %s\n", Com_CpuFeatureString(Com_GetCpuFeatures()));
+}
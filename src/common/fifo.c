@@ -106,3 +106,110 @@ bool FIFO_ReadMessage(fifo_t *fifo, size_t msglen)
 
     return true;
 }
+
+static int FIFO_SetVec(fifo_vec_t vec[2], byte *a, size_t alen, byte *b, size_t blen)
+{
+    int count = 0;
+
+    if (alen) {
+        vec[count].data = a;
+        vec[count].len = alen;
+        count++;
+    }
+    if (blen) {
+        vec[count].data = b;
+        vec[count].len = blen;
+        count++;
+    }
+
+    return count;
+}
+
+int FIFO_Reservev(fifo_t *fifo, fifo_vec_t vec[2])
+{
+    if (fifo->bs) {
+        return FIFO_SetVec(vec, fifo->data + fifo->bs, fifo->ax - fifo->bs, NULL, 0);
+    }
+
+    return FIFO_SetVec(vec, fifo->data + fifo->ay, fifo->size - fifo->ay, fifo->data, fifo->ax);
+}
+
+void FIFO_Commitv(fifo_t *fifo, size_t len)
+{
+    size_t tail;
+
+    if (fifo->bs) {
+        fifo->bs += len;
+        return;
+    }
+
+    tail = fifo->size - fifo->ay;
+    if (len <= tail) {
+        fifo->ay += len;
+        return;
+    }
+
+    fifo->ay = fifo->size;
+    fifo->bs = len - tail;
+}
+
+int FIFO_Peekv(fifo_t *fifo, fifo_vec_t vec[2])
+{
+    return FIFO_SetVec(vec, fifo->data + fifo->ax, fifo->ay - fifo->ax, fifo->data, fifo->bs);
+}
+
+void FIFO_Decommitv(fifo_t *fifo, size_t len)
+{
+    size_t head = fifo->ay - fifo->ax;
+
+    if (len < head) {
+        fifo->ax += len;
+        return;
+    }
+
+    fifo->ax = len - head;
+    fifo->ay = fifo->bs;
+    fifo->bs = 0;
+}
+
+// Gathers `count' buffers into FIFO free space directly. Writes nothing and
+// returns false if they don't fit entirely.
+bool FIFO_Writev(fifo_t *fifo, const fifo_vec_t *vec, int count)
+{
+    fifo_vec_t dst[2];
+    size_t total = 0, avail = 0, ofs = 0, len;
+    const byte *src;
+    int i, j, num;
+
+    for (i = 0; i < count; i++) {
+        total += vec[i].len;
+    }
+
+    num = FIFO_Reservev(fifo, dst);
+    for (j = 0; j < num; j++) {
+        avail += dst[j].len;
+    }
+
+    if (total > avail) {
+        return false;
+    }
+
+    for (i = 0, j = 0; i < count; i++) {
+        src = vec[i].data;
+        len = vec[i].len;
+        while (len) {
+            size_t n = min(len, dst[j].len - ofs);
+            memcpy((byte *)dst[j].data + ofs, src, n);
+            src += n;
+            len -= n;
+            ofs += n;
+            if (ofs == dst[j].len) {
+                ofs = 0;
+                j++;
+            }
+        }
+    }
+
+    FIFO_Commitv(fifo, total);
+    return true;
+}
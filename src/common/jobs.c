@@ -0,0 +1,198 @@
+/*
+Copyright (C) 2024 Andrey Nazarov
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "shared/shared.h"
+#include "shared/atomic.h"
+#include "common/common.h"
+#include "common/cvar.h"
+#include "common/jobs.h"
+#include "system/pthread.h"
+#include "system/system.h"
+
+static struct {
+    int             numworkers;
+    pthread_t       threads[MAX_JOB_THREADS - 1];
+    pthread_mutex_t call_lock;
+    pthread_mutex_t serial_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+    unsigned        generation;
+    unsigned        start_generation;   // generation when workers started
+    bool            terminate;
+    int             active;
+
+    // current job
+    jobfunc_t       func;
+    void            *arg;
+    int             count;
+    atomic_int      next;
+} jobs;
+
+static cvar_t   *sys_threads;
+
+static void run_job(int thread)
+{
+    int i;
+
+    while ((i = atomic_fetch_add(&jobs.next, 1)) < jobs.count)
+        jobs.func(jobs.arg, i, thread);
+}
+
+static void *worker_func(void *arg)
+{
+    int thread = (intptr_t)arg;
+    unsigned generation;
+
+    // only wait for jobs published after this worker was counted in
+    pthread_mutex_lock(&jobs.lock);
+    generation = jobs.start_generation;
+    while (1) {
+        while (jobs.generation == generation && !jobs.terminate)
+            pthread_cond_wait(&jobs.work_cond, &jobs.lock);
+        if (jobs.terminate)
+            break;
+        generation = jobs.generation;
+        pthread_mutex_unlock(&jobs.lock);
+
+        run_job(thread);
+
+        pthread_mutex_lock(&jobs.lock);
+        if (--jobs.active == 0)
+            pthread_cond_signal(&jobs.done_cond);
+    }
+    pthread_mutex_unlock(&jobs.lock);
+
+    return NULL;
+}
+
+void Com_ParallelFor(jobfunc_t func, void *arg, int count)
+{
+    int i;
+
+    if (count < 1)
+        return;
+
+    // run serially if nothing to gain, or if called recursively
+    if (!jobs.numworkers || count == 1 || pthread_mutex_trylock(&jobs.call_lock)) {
+        for (i = 0; i < count; i++)
+            func(arg, i, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&jobs.lock);
+    jobs.func = func;
+    jobs.arg = arg;
+    jobs.count = count;
+    atomic_store(&jobs.next, 0);
+    jobs.active = jobs.numworkers;
+    jobs.generation++;
+    pthread_mutex_unlock(&jobs.lock);
+    pthread_cond_broadcast(&jobs.work_cond);
+
+    run_job(0);
+
+    pthread_mutex_lock(&jobs.lock);
+    while (jobs.active)
+        pthread_cond_wait(&jobs.done_cond, &jobs.lock);
+    pthread_mutex_unlock(&jobs.lock);
+
+    pthread_mutex_unlock(&jobs.call_lock);
+}
+
+int Com_JobThreads(void)
+{
+    return jobs.numworkers + 1;
+}
+
+void Com_LockJobs(void)
+{
+    pthread_mutex_lock(&jobs.serial_lock);
+}
+
+void Com_UnlockJobs(void)
+{
+    pthread_mutex_unlock(&jobs.serial_lock);
+}
+
+static void start_workers(void)
+{
+    int i, n = sys_threads->integer;
+
+    if (n <= 0)
+        n = Sys_GetNumCpus();
+    n = Q_clip(n, 1, MAX_JOB_THREADS) - 1;
+
+    pthread_mutex_lock(&jobs.lock);
+    jobs.terminate = false;
+    jobs.start_generation = jobs.generation;
+    pthread_mutex_unlock(&jobs.lock);
+
+    for (i = 0; i < n; i++) {
+        if (pthread_create(&jobs.threads[i], NULL, worker_func, (void *)(intptr_t)(i + 1))) {
+            Com_EPrintf("Couldn't create job thread\n");
+            break;
+        }
+    }
+    jobs.numworkers = i;
+
+    Com_DPrintf("Started %d job threads\n", jobs.numworkers);
+}
+
+static void stop_workers(void)
+{
+    int i;
+
+    if (!jobs.numworkers)
+        return;
+
+    pthread_mutex_lock(&jobs.lock);
+    jobs.terminate = true;
+    pthread_mutex_unlock(&jobs.lock);
+    pthread_cond_broadcast(&jobs.work_cond);
+
+    for (i = 0; i < jobs.numworkers; i++)
+        pthread_join(jobs.threads[i], NULL);
+
+    jobs.numworkers = 0;
+}
+
+static void sys_threads_changed(cvar_t *self)
+{
+    stop_workers();
+    start_workers();
+}
+
+void Com_InitJobs(void)
+{
+    pthread_mutex_init(&jobs.call_lock, NULL);
+    pthread_mutex_init(&jobs.serial_lock, NULL);
+    pthread_mutex_init(&jobs.lock, NULL);
+    pthread_cond_init(&jobs.work_cond, NULL);
+    pthread_cond_init(&jobs.done_cond, NULL);
+
+    sys_threads = Cvar_Get("sys_threads", "0", 0);
+    sys_threads->changed = sys_threads_changed;
+
+    start_workers();
+}
+
+void Com_ShutdownJobs(void)
+{
+    stop_workers();
+}
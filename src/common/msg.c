@@ -35,7 +35,8 @@ Handles byte ordering and avoids alignment errors
 sizebuf_t   msg_write;
 byte        msg_write_buffer[MAX_MSGLEN];
 
-sizebuf_t   msg_read;
+// MVD channels may be parsed by multiple threads
+q_thread_local sizebuf_t    msg_read;
 byte        msg_read_buffer[MAX_MSGLEN];
 
 const entity_packed_t   nullEntityState;
@@ -163,6 +163,14 @@ void Netchan_OutOfBand(netsrc_t sock, const netadr_t *address, const char *forma
 
 // ============================================================================
 
+static void send_packet(netchan_t *chan, const void *data, size_t len)
+{
+    if (chan->send_cb)
+        chan->send_cb(chan->send_arg, data, len);
+    else
+        NET_SendPacket(chan->sock, data, len, &chan->remote_address);
+}
+
 /*
 ===============
 NetchanOld_Transmit
@@ -246,7 +254,7 @@ static int NetchanOld_Transmit(netchan_t *chan, size_t length, const void *data,
 
     // send the datagram
     for (int i = 0; i < numpackets; i++) {
-        NET_SendPacket(chan->sock, send.data, send.cursize, &chan->remote_address);
+        send_packet(chan, send.data, send.cursize);
     }
 
     chan->outgoing_sequence++;
@@ -436,7 +444,7 @@ int Netchan_TransmitNextFragment(netchan_t *chan)
     }
 
     // send the datagram
-    NET_SendPacket(chan->sock, send.data, send.cursize, &chan->remote_address);
+    send_packet(chan, send.data, send.cursize);
 
     return send.cursize;
 }
@@ -530,7 +538,7 @@ static int NetchanNew_Transmit(netchan_t *chan, size_t length, const void *data,
 
     // send the datagram
     for (int i = 0; i < numpackets; i++) {
-        NET_SendPacket(chan->sock, send.data, send.cursize, &chan->remote_address);
+        send_packet(chan, send.data, send.cursize);
     }
 
     chan->outgoing_sequence++;
@@ -51,9 +51,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <netdb.h>
 #include <sys/param.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <poll.h>
 #include <errno.h>
+#if USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 #if USE_ICMP
 #include <linux/errqueue.h>
 #else
@@ -123,8 +128,25 @@ static qhandle_t    net_logFile;
 #define MAX_POLL_FDS    1024
 
 static struct pollfd    io_entries[MAX_POLL_FDS];
+static void             *io_data[MAX_POLL_FDS];     // owner of descriptor
 static int              io_numfds;
 
+#if USE_EPOLL
+// epoll backend state, indexed by io_entries slot
+#define IO_PENDING      BIT(0)  // waiting to be added to epoll set
+#define IO_REGISTERED   BIT(1)  // added to epoll set
+#define IO_READY        BIT(2)  // on the ready list
+#define IO_ALWAYS       BIT(3)  // can't be polled (regular file), always ready
+
+static int              io_epfd = -1;
+static int              io_timerfd = -1;    // for NET_SleepUntil
+static byte             io_state[MAX_POLL_FDS];
+static int              io_pending[MAX_POLL_FDS];
+static int              io_numpending;
+static struct pollfd    *io_ready[MAX_POLL_FDS];
+static int              io_numready;
+#endif
+
 // current rate measurement
 static unsigned     net_rate_time;
 static size_t       net_rate_rcvd;
@@ -459,8 +481,23 @@ static void NET_LogPacket(const netadr_t *address, const char *prefix,
     FS_FPrintf(net_logFile, "\n");
 }
 
+// logs first `length' bytes spread over FIFO regions
+static void NET_LogPacketv(const netadr_t *address, const char *prefix,
+                           const fifo_vec_t *vec, int count, size_t length)
+{
+    size_t len;
+    int i;
+
+    for (i = 0; i < count && length; i++) {
+        len = min(length, vec[i].len);
+        NET_LogPacket(address, prefix, vec[i].data, len);
+        length -= len;
+    }
+}
+
 #else
 #define NET_LogPacket(adr, pre, data, len)  (void)0
+#define NET_LogPacketv(adr, pre, vec, count, len)   (void)0
 #endif
 
 //=============================================================================
@@ -678,6 +715,15 @@ struct pollfd *NET_AllocPollFd(void)
     }
 
     e->events = e->revents = 0;
+    io_data[i] = NULL;
+
+#if USE_EPOLL
+    // file descriptor is not known yet, register it before next wait
+    if (!(io_state[i] & IO_PENDING))
+        io_pending[io_numpending++] = i;
+    io_state[i] = IO_PENDING;
+#endif
+
     return e;
 }
 
@@ -690,6 +736,16 @@ void NET_FreePollFd(struct pollfd *e)
 {
     int i;
 
+#if USE_EPOLL
+    i = e - io_entries;
+    if (io_state[i] & IO_REGISTERED) {
+        // fails harmlessly if descriptor was already closed
+        epoll_ctl(io_epfd, EPOLL_CTL_DEL, e->fd, NULL);
+    }
+    io_state[i] &= IO_PENDING;
+#endif
+
+    io_data[e - io_entries] = NULL;
     e->fd = -1;
     e->events = e->revents = 0;
 
@@ -702,6 +758,195 @@ void NET_FreePollFd(struct pollfd *e)
     io_numfds = i + 1;
 }
 
+/*
+=============
+NET_SetPollFdData
+
+Associates owner with descriptor, so that descriptors returned by
+NET_ReadyPollFds can be mapped back. Cleared when descriptor is freed.
+=============
+*/
+void NET_SetPollFdData(struct pollfd *e, void *data)
+{
+    io_data[e - io_entries] = data;
+}
+
+void *NET_GetPollFdData(const struct pollfd *e)
+{
+    return io_data[e - io_entries];
+}
+
+/*
+=============
+NET_TracksReady
+
+Returns true if NET_NextReadyPollFd can be used. Otherwise caller has to
+check all of its descriptors.
+=============
+*/
+bool NET_TracksReady(void)
+{
+#if USE_EPOLL
+    return io_epfd != -1;
+#else
+    return false;
+#endif
+}
+
+/*
+=============
+NET_NextReadyPollFd
+
+Iterates descriptors that have events reported and not yet consumed which
+the caller is interested in. Writable descriptors with nothing to write are
+not returned. Iterator must be initialized to 0. Descriptors may be freed
+while iterating, they are skipped then.
+=============
+*/
+struct pollfd *NET_NextReadyPollFd(int *iter)
+{
+#if USE_EPOLL
+    struct pollfd *e;
+
+    while (*iter < io_numready) {
+        e = io_ready[(*iter)++];
+        if (io_state[e - io_entries] & IO_READY &&
+            e->revents & (e->events | POLLERR | POLLHUP))
+            return e;
+    }
+#endif
+
+    return NULL;
+}
+
+#if USE_EPOLL
+
+/*
+Edge-triggered epoll backend. Every descriptor is registered once for both
+reading and writing, and kernel reports only readiness changes. Reported
+events are accumulated in `revents' and stay there until consumer clears
+them after getting EAGAIN, which existing socket code already does. Thus
+neither changing `events' nor idle descriptors need any system calls.
+Descriptors with events left over are kept on a ready list, so that wait
+doesn't block while some consumer still has work to do.
+*/
+
+static void io_add_ready(struct pollfd *e)
+{
+    int i = e - io_entries;
+
+    if (!(io_state[i] & IO_READY)) {
+        io_state[i] |= IO_READY;
+        io_ready[io_numready++] = e;
+    }
+}
+
+static void io_register_pending(void)
+{
+    struct epoll_event ev;
+    struct pollfd *e;
+    int i, j;
+
+    for (j = 0; j < io_numpending; j++) {
+        i = io_pending[j];
+        e = &io_entries[i];
+        io_state[i] &= ~IO_PENDING;
+        if (e->fd == -1) {
+            continue;   // freed before use
+        }
+
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.ptr = e;
+        if (epoll_ctl(io_epfd, EPOLL_CTL_ADD, e->fd, &ev) == 0) {
+            io_state[i] |= IO_REGISTERED;
+            continue;
+        }
+
+        // regular files are always ready, just like with poll()
+        if (errno != EPERM)
+            Com_EPrintf("%s: %s\n", __func__, strerror(errno));
+        io_state[i] |= IO_ALWAYS;
+        io_add_ready(e);
+    }
+
+    io_numpending = 0;
+}
+
+// drops descriptors without events from the ready list, returns true
+// if some remaining descriptor has events consumer is waiting for
+static bool io_update_ready(void)
+{
+    struct pollfd *e;
+    bool busy = false;
+    int i, j, count = 0;
+
+    for (j = 0; j < io_numready; j++) {
+        e = io_ready[j];
+        i = e - io_entries;
+        if (!(io_state[i] & IO_READY)) {
+            continue;   // freed, or duplicate after reallocation
+        }
+        io_state[i] &= ~IO_READY;
+
+        if (io_state[i] & IO_ALWAYS) {
+            e->revents |= e->events;
+        }
+
+        if (e->fd == -1 || !(e->revents || io_state[i] & IO_ALWAYS)) {
+            continue;
+        }
+
+        if (e->revents & (e->events | POLLERR | POLLHUP)) {
+            busy = true;
+        }
+
+        io_ready[count++] = e;
+    }
+
+    io_numready = count;
+    for (j = 0; j < count; j++) {
+        io_state[io_ready[j] - io_entries] |= IO_READY;
+    }
+
+    return busy;
+}
+
+static int io_epoll_wait(int msec)
+{
+    struct epoll_event events[64];
+    struct pollfd *e;
+    int i, ret;
+
+    io_register_pending();
+
+    // don't block if there is still some work to do
+    if (io_update_ready()) {
+        msec = 0;
+    }
+
+    ret = epoll_wait(io_epfd, events, q_countof(events), msec);
+    if (ret == -1) {
+        net_error = errno;
+        return net_error == EINTR ? 0 : -1;
+    }
+
+    for (i = 0; i < ret; i++) {
+        e = events[i].data.ptr;
+        if (!e) {
+            // deadline timer expired, acknowledge it
+            uint64_t expirations;
+            ssize_t r q_unused = read(io_timerfd, &expirations, sizeof(expirations));
+            continue;
+        }
+        e->revents |= events[i].events & (POLLIN | POLLOUT | POLLERR | POLLHUP);
+        io_add_ready(e);
+    }
+
+    return io_numready;
+}
+
+#endif // USE_EPOLL
+
 /*
 =============
 NET_Sleep
@@ -719,13 +964,61 @@ int NET_Sleep(int msec)
         return 0;
     }
 
+#if USE_EPOLL
+    if (io_epfd != -1)
+        ret = io_epoll_wait(msec);
+    else {
+        io_numpending = 0;
+        ret = os_poll(io_entries, io_numfds, msec);
+    }
+#else
     ret = os_poll(io_entries, io_numfds, msec);
+#endif
     if (ret == -1)
         Com_EPrintf("%s: %s\n", __func__, NET_ErrorString());
 
     return ret;
 }
 
+/*
+=============
+NET_SleepUntil
+
+Sleeps until absolute deadline in Sys_Microseconds() time base, or until
+some file descriptor is ready. Uses timerfd for sub-millisecond wakeups when
+available. Otherwise sleeps whole milliseconds only, and caller is expected
+to call this repeatedly until deadline is reached.
+=============
+*/
+int NET_SleepUntil(uint64_t deadline)
+{
+    uint64_t now = Sys_Microseconds();
+
+    if (now >= deadline)
+        return NET_Sleep(0);
+
+#if USE_EPOLL
+    if (io_timerfd != -1) {
+        struct itimerspec its = {
+            .it_value = {
+                .tv_sec = deadline / 1000000,
+                .tv_nsec = (deadline % 1000000) * 1000
+            }
+        };
+        int ret;
+
+        if (timerfd_settime(io_timerfd, TFD_TIMER_ABSTIME, &its, NULL) == 0) {
+            ret = io_epoll_wait(-1);
+            if (ret == -1)
+                Com_EPrintf("%s: %s\n", __func__, NET_ErrorString());
+            return ret;
+        }
+    }
+#endif
+
+    return NET_Sleep((deadline - now) / 1000);
+}
+
 #if USE_AC_SERVER
 
 /*
@@ -1536,9 +1829,8 @@ void NET_UpdateStream(netstream_t *s)
 // returns NET_OK only when there was some data read
 neterr_t NET_RunStream(netstream_t *s)
 {
-    int ret;
-    size_t len;
-    void *data;
+    int ret, count;
+    fifo_vec_t vec[2];
     neterr_t result = NET_AGAIN;
     struct pollfd *e = s->socket;
 
@@ -1558,10 +1850,10 @@ neterr_t NET_RunStream(netstream_t *s)
     }
 
     if (e->revents & (POLLIN | POLLHUP)) {
-        // read as much as we can
-        data = FIFO_Reserve(&s->recv, &len);
-        if (len) {
-            ret = os_recv(e->fd, data, len, 0);
+        // read as much as we can, including wrapped part of free space
+        count = FIFO_Reservev(&s->recv, vec);
+        if (count) {
+            ret = os_recvv(e->fd, vec, count);
             if (!ret) {
                 goto closed;
             }
@@ -1571,9 +1863,9 @@ neterr_t NET_RunStream(netstream_t *s)
             if (ret == NET_AGAIN) {
                 e->revents &= ~POLLIN;
             } else {
-                FIFO_Commit(&s->recv, ret);
+                FIFO_Commitv(&s->recv, ret);
 
-                NET_LogPacket(&s->address, "TCP recv", data, ret);
+                NET_LogPacketv(&s->address, "TCP recv", vec, count, ret);
 
                 net_rate_rcvd += ret;
                 net_bytes_rcvd += ret;
@@ -1581,8 +1873,7 @@ neterr_t NET_RunStream(netstream_t *s)
                 result = NET_OK;
 
                 // now see if there's more space to read
-                FIFO_Reserve(&s->recv, &len);
-                if (!len) {
+                if (!FIFO_Reservev(&s->recv, vec)) {
                     e->events &= ~POLLIN;
                 }
             }
@@ -1590,10 +1881,10 @@ neterr_t NET_RunStream(netstream_t *s)
     }
 
     if (e->revents & POLLOUT) {
-        // write as much as we can
-        data = FIFO_Peek(&s->send, &len);
-        if (len) {
-            ret = os_send(e->fd, data, len, 0);
+        // write as much as we can, including wrapped part of pending data
+        count = FIFO_Peekv(&s->send, vec);
+        if (count) {
+            ret = os_sendv(e->fd, vec, count);
             if (!ret) {
                 goto closed;
             }
@@ -1603,9 +1894,9 @@ neterr_t NET_RunStream(netstream_t *s)
             if (ret == NET_AGAIN) {
                 e->revents &= ~POLLOUT;
             } else {
-                FIFO_Decommit(&s->send, ret);
+                NET_LogPacketv(&s->address, "TCP send", vec, count, ret);
 
-                NET_LogPacket(&s->address, "TCP send", data, ret);
+                FIFO_Decommitv(&s->send, ret);
 
                 net_rate_sent += ret;
                 net_bytes_sent += ret;
@@ -1613,8 +1904,7 @@ neterr_t NET_RunStream(netstream_t *s)
                 //result = NET_OK;
 
                 // now see if there's more data to write
-                FIFO_Peek(&s->send, &len);
-                if (!len) {
+                if (!FIFO_Usage(&s->send)) {
                     e->events &= ~POLLOUT;
                 }
             }
@@ -1826,6 +2116,24 @@ void NET_Init(void)
 {
     os_net_init();
 
+#if USE_EPOLL
+    io_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (io_epfd == -1)
+        Com_WPrintf("epoll_create1 failed: %s\n", strerror(errno));
+
+    // timer must use the same clock as Sys_Microseconds()
+    if (io_epfd != -1) {
+        io_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (io_timerfd != -1) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+            if (epoll_ctl(io_epfd, EPOLL_CTL_ADD, io_timerfd, &ev) == -1) {
+                close(io_timerfd);
+                io_timerfd = -1;
+            }
+        }
+    }
+#endif
+
     net_ip = Cvar_Get("net_ip", "", 0);
     net_ip->changed = net_udp_param_changed;
     net_ip6 = Cvar_Get("net_ip6", "", 0);
@@ -1885,6 +2193,17 @@ void NET_Shutdown(void)
     NET_Config(NET_NONE);
     os_net_shutdown();
 
+#if USE_EPOLL
+    if (io_timerfd != -1) {
+        close(io_timerfd);
+        io_timerfd = -1;
+    }
+    if (io_epfd != -1) {
+        close(io_epfd);
+        io_epfd = -1;
+    }
+#endif
+
     Cmd_RemoveCommand("net_restart");
     Cmd_RemoveCommand("net_stats");
     Cmd_RemoveCommand("showip");
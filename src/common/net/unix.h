@@ -172,20 +172,36 @@ static neterr_t os_get_error(void)
     return NET_ERROR;
 }
 
-static int os_recv(qsocket_t sock, void *data, size_t len, int flags)
+static int os_recvv(qsocket_t sock, const fifo_vec_t *vec, int count)
 {
-    int ret = recv(sock, data, len, flags);
+    struct iovec iov[2];
+    ssize_t ret;
+    int i;
 
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = vec[i].data;
+        iov[i].iov_len = vec[i].len;
+    }
+
+    ret = readv(sock, iov, count);
     if (ret == -1)
         return os_get_error();
 
     return ret;
 }
 
-static int os_send(qsocket_t sock, const void *data, size_t len, int flags)
+static int os_sendv(qsocket_t sock, const fifo_vec_t *vec, int count)
 {
-    int ret = send(sock, data, len, flags);
+    struct iovec iov[2];
+    ssize_t ret;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = vec[i].data;
+        iov[i].iov_len = vec[i].len;
+    }
 
+    ret = writev(sock, iov, count);
     if (ret == -1)
         return os_get_error();
 
@@ -183,21 +183,35 @@ static neterr_t os_get_error(void)
     return NET_ERROR;
 }
 
-static int os_recv(qsocket_t sock, void *data, size_t len, int flags)
+static int os_recvv(qsocket_t sock, const fifo_vec_t *vec, int count)
 {
-    int ret = recv(sock, data, len, flags);
+    WSABUF bufs[2];
+    DWORD ret, flags = 0;
+    int i;
 
-    if (ret == SOCKET_ERROR)
+    for (i = 0; i < count; i++) {
+        bufs[i].buf = vec[i].data;
+        bufs[i].len = (ULONG)vec[i].len;
+    }
+
+    if (WSARecv(sock, bufs, count, &ret, &flags, NULL, NULL) == SOCKET_ERROR)
         return os_get_error();
 
     return ret;
 }
 
-static int os_send(qsocket_t sock, const void *data, size_t len, int flags)
+static int os_sendv(qsocket_t sock, const fifo_vec_t *vec, int count)
 {
-    int ret = send(sock, data, len, flags);
+    WSABUF bufs[2];
+    DWORD ret;
+    int i;
 
-    if (ret == SOCKET_ERROR)
+    for (i = 0; i < count; i++) {
+        bufs[i].buf = vec[i].data;
+        bufs[i].len = (ULONG)vec[i].len;
+    }
+
+    if (WSASend(sock, bufs, count, &ret, 0, NULL, NULL) == SOCKET_ERROR)
         return os_get_error();
 
     return ret;
@@ -19,8 +19,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "shared/shared.h"
 #include "common/bsp.h"
 #include "common/cmd.h"
+#include "common/cmodel.h"
 #include "common/common.h"
 #include "common/files.h"
+#include "common/math.h"
 #include "common/mdfour.h"
 #include "common/tests.h"
 #include "common/utils.h"
@@ -196,6 +198,109 @@ static void BSP_Test_f(void)
     FS_FreeList(list);
 }
 
+static const mleaf_t *BSP_PointLeafNodes(const mnode_t *node, const vec3_t p)
+{
+    while (node->plane)
+        node = node->children[PlaneDiffFast(p, node->plane) < 0];
+
+    return (const mleaf_t *)node;
+}
+
+static void BSP_RandomPoint(const mmodel_t *mod, vec3_t p)
+{
+    for (int i = 0; i < 3; i++)
+        p[i] = mod->mins[i] + frand() * (mod->maxs[i] - mod->mins[i]);
+}
+
+// compare linear tree traversal against pointer linked nodes
+static void BSP_Bench_f(void)
+{
+    static const vec3_t mins = { -16, -16, -24 };
+    static const vec3_t maxs = { 16, 16, 32 };
+    char name[MAX_QPATH];
+    const mmodel_t *mod;
+    const mleaf_t **leafs;
+    vec3_t *points;
+    trace_t tr, ref;
+    uint64_t start, linear, nodes;
+    int i, count, ret, errors;
+    bsp_t *bsp;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <map> [count]\n", Cmd_Argv(0));
+        return;
+    }
+
+    if (Q_snprintf(name, sizeof(name), "maps/%s.bsp", Cmd_Argv(1)) >= sizeof(name)) {
+        Com_Printf("Oversize map name\n");
+        return;
+    }
+
+    count = Q_clip(Cmd_Argc() > 2 ? Q_atoi(Cmd_Argv(2)) : 100000, 1, 10000000);
+
+    ret = BSP_Load(name, &bsp);
+    if (!bsp) {
+        Com_EPrintf("Couldn't load %s: %s\n", name, BSP_ErrorString(ret));
+        return;
+    }
+
+    mod = &bsp->models[0];
+    points = Z_Malloc(sizeof(points[0]) * count * 2);
+    for (i = 0; i < count * 2; i++)
+        BSP_RandomPoint(mod, points[i]);
+
+    Com_Printf("%s: %d nodes, %d leafs, %d linear entries\n", name,
+               bsp->numnodes, bsp->numleafs, bsp->numlnodes);
+
+    // point leafs
+    leafs = Z_Malloc(sizeof(leafs[0]) * count * 2);
+    start = Sys_Microseconds();
+    for (i = 0; i < count; i++)
+        leafs[i] = BSP_PointLeaf(mod->headnode, points[i]);
+    linear = max(Sys_Microseconds() - start, 1);
+
+    start = Sys_Microseconds();
+    for (i = 0; i < count; i++)
+        leafs[count + i] = BSP_PointLeafNodes(mod->headnode, points[i]);
+    nodes = max(Sys_Microseconds() - start, 1);
+
+    errors = memcmp(leafs, leafs + count, sizeof(leafs[0]) * count);
+    Z_Free(leafs);
+
+    Com_Printf("pointleaf: %.2f M/s linear, %.2f M/s nodes, %.2fx%s\n",
+               (double)count / linear, (double)count / nodes, (double)nodes / linear,
+               errors ? " (MISMATCH)" : "");
+
+    // alternate point and box traces
+    start = Sys_Microseconds();
+    for (i = 0; i < count; i++)
+        CM_BoxTrace(&tr, points[i * 2], points[i * 2 + 1], (i & 1) ? mins : vec3_origin,
+                    (i & 1) ? maxs : vec3_origin, mod->headnode, MASK_PLAYERSOLID, bsp->extended);
+    linear = max(Sys_Microseconds() - start, 1);
+
+    start = Sys_Microseconds();
+    for (i = 0; i < count; i++)
+        CM_BoxTraceNodes(&tr, points[i * 2], points[i * 2 + 1], (i & 1) ? mins : vec3_origin,
+                         (i & 1) ? maxs : vec3_origin, mod->headnode, MASK_PLAYERSOLID, bsp->extended);
+    nodes = max(Sys_Microseconds() - start, 1);
+
+    errors = 0;
+    for (i = 0; i < count; i++) {
+        CM_BoxTrace(&tr, points[i * 2], points[i * 2 + 1], (i & 1) ? mins : vec3_origin,
+                    (i & 1) ? maxs : vec3_origin, mod->headnode, MASK_PLAYERSOLID, bsp->extended);
+        CM_BoxTraceNodes(&ref, points[i * 2], points[i * 2 + 1], (i & 1) ? mins : vec3_origin,
+                         (i & 1) ? maxs : vec3_origin, mod->headnode, MASK_PLAYERSOLID, bsp->extended);
+        errors += !!memcmp(&tr, &ref, sizeof(tr));
+    }
+
+    Com_Printf("trace: %.2f M/s linear, %.2f M/s nodes, %.2fx%s\n",
+               (double)count / linear, (double)count / nodes, (double)nodes / linear,
+               errors ? " (MISMATCH)" : "");
+
+    Z_Free(points);
+    BSP_Free(bsp);
+}
+
 typedef struct {
     const char *filter;
     const char *string;
@@ -901,6 +1006,7 @@ static const cmdreg_t c_test[] = {
     { "doublefree", Com_DoubleFree_f },
     { "printjunk", Com_PrintJunk_f },
     { "bsptest", BSP_Test_f },
+    { "bsp_bench", BSP_Bench_f },
     { "wildtest", Com_TestWild_f },
     { "normtest", Com_TestNorm_f },
     { "infotest", Com_TestInfo_f },
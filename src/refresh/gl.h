@@ -97,6 +97,8 @@ typedef struct {
         bsp_t       *cache;
         vec_t       *vertices;
         GLuint      buffer;
+        GLuint      index_buffer;   // for gl_world_cache
+        GLuint      indirect_buffer;
         size_t      buffer_size;
         vec_t       size;
     } world;
@@ -256,6 +258,7 @@ extern cvar_t *gl_shaders;
 extern cvar_t *gl_md5_load;
 extern cvar_t *gl_md5_use;
 extern cvar_t *gl_md5_distance;
+extern cvar_t *gl_md5_cache;
 #endif
 extern cvar_t *gl_damageblend_frac;
 extern cvar_t *gl_waterwarp;
@@ -271,6 +274,8 @@ extern cvar_t *gl_novbo;
 extern cvar_t *gl_test;
 #endif
 extern cvar_t *gl_cull_nodes;
+extern cvar_t *gl_world_cache;
+extern cvar_t *gl_stream_ring;
 extern cvar_t *gl_cull_models;
 extern cvar_t *gl_clear;
 extern cvar_t *gl_novis;
@@ -632,6 +637,7 @@ typedef enum {
     GLB_VBO,
     GLB_EBO,
     GLB_UBO,
+    GLB_DIB,
 
     GLB_COUNT
 } glBufferBinding_t;
@@ -720,6 +726,7 @@ typedef struct {
     void (*load_matrix)(GLenum mode, const GLfloat *matrix);
     void (*load_uniforms)(void);
     void (*update_blur)(void);
+    void (*precache)(void);
 
     void (*state_bits)(glStateBits_t bits);
     void (*array_bits)(glArrayBits_t bits);
@@ -797,6 +804,8 @@ static inline glBufferBinding_t GL_BindingForTarget(GLenum target)
         return GLB_EBO;
     case GL_UNIFORM_BUFFER:
         return GLB_UBO;
+    case GL_DRAW_INDIRECT_BUFFER:
+        return GLB_DIB;
     default:
         q_unreachable();
     }
@@ -895,8 +904,22 @@ void GL_ShutdownImages(void);
 
 bool GL_InitFramebuffers(void);
 
+uint64_t GL_HashBytes(uint64_t hash, const void *data, size_t len);
+
 extern cvar_t *gl_intensity;
 
+// image processing kernels, ordered best first in img_funcs[]
+typedef struct {
+    const char  *name;
+    unsigned    features;
+    void        (*mipmap)(byte *out, const byte *in, int width, int height);
+    void        (*resample)(byte *out, const byte *inrow1, const byte *inrow2,
+                            const unsigned *p1, const unsigned *p2, int outwidth);
+    void        (*hq_pattern)(uint8_t *pattern, const int32_t *const planes[4], int stride, int width);
+} imgfuncs_t;
+
+extern const imgfuncs_t *const img_funcs[];
+
 /*
  * gl_tess.c
  *
@@ -913,6 +936,20 @@ typedef struct {
     glStateBits_t   flags;
 } tesselator_t;
 
+typedef struct {
+    GLsizei     first;
+    GLsizei     count;
+} glIndexRange_t;
+
+// layout of glMultiDrawElementsIndirect commands
+typedef struct {
+    GLuint      count;
+    GLuint      instanceCount;
+    GLuint      firstIndex;
+    GLint       baseVertex;
+    GLuint      baseInstance;
+} glDrawCommand_t;
+
 extern tesselator_t tess;
 
 void GL_Flush2D(void);
@@ -928,6 +965,9 @@ void GL_InitArrays(void);
 void GL_ShutdownArrays(void);
 
 void GL_Flush3D(void);
+glStateBits_t GL_FaceTexnums(const mface_t *surf, GLuint texnum[MAX_TMUS]);
+void GL_DrawFaceRanges(const mface_t *surf, const glIndexRange_t *ranges, int numranges);
+void GL_DrawFaceIndirect(const mface_t *surf, int firstcmd, int numcmds);
 
 void GL_AddAlphaFace(mface_t *face);
 void GL_AddSolidFace(mface_t *face);
@@ -941,6 +981,8 @@ void GL_ClearSolidFaces(void);
  */
 void GL_DrawBspModel(mmodel_t *model);
 void GL_DrawWorld(void);
+void GL_InvalidateWorldCache(void);
+void GL_FreeWorldCache(void);
 void GL_SampleLightPoint(vec3_t color);
 void GL_LightPoint(const vec3_t origin, vec3_t color);
 
@@ -959,13 +1001,21 @@ void R_SetSky(const char *name, float rotate, bool autorotate, const vec3_t axis
  *
  */
 void GL_DrawAliasModel(const model_t *model);
+#if USE_MD5
+void GL_SkinAliasModels(void);
+void GL_FreeSkeletonPoses(void);
+#endif
 
 /*
  * hq2x.c
  *
  */
-void HQ2x_Render(uint32_t *output, const uint32_t *input, int width, int height);
-void HQ4x_Render(uint32_t *output, const uint32_t *input, int width, int height);
+void HQ_Pattern_C(uint8_t *pattern, const int32_t *const planes[4], int stride, int width);
+void HQ_Pattern_SSE2(uint8_t *pattern, const int32_t *const planes[4], int stride, int width);
+void HQ_Pattern_AVX2(uint8_t *pattern, const int32_t *const planes[4], int stride, int width);
+
+void HQ2x_Render(const imgfuncs_t *funcs, uint32_t *output, const uint32_t *input, int width, int height);
+void HQ4x_Render(const imgfuncs_t *funcs, uint32_t *output, const uint32_t *input, int width, int height);
 void HQ2x_Init(void);
 
 /*
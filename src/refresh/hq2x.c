@@ -26,6 +26,15 @@ written by Maxim Stepin (MaxSt). it is not 100% identical, but very similar.
 */
 
 #include "gl.h"
+#include "common/cpu.h"
+#include "common/jobs.h"
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+#if USE_AVX2
+#include <immintrin.h>
+#endif
 
 static const uint8_t hqTable[256] = {
     1, 1, 2,  4, 1, 1, 2,  4, 3,  5,  7,  8, 3,  5, 13, 15,
@@ -101,47 +110,47 @@ static inline uint32_t pack(uint64_t n)
     return n;
 }
 
-static q_noinline uint32_t blend_1_1(uint32_t A, uint32_t B)
+static inline uint32_t blend_1_1(uint32_t A, uint32_t B)
 {
     return pack((grow(A) + grow(B)) >> 1);
 }
 
-static q_noinline uint32_t blend_3_1(uint32_t A, uint32_t B)
+static inline uint32_t blend_3_1(uint32_t A, uint32_t B)
 {
     return pack((grow(A) * 3 + grow(B)) >> 2);
 }
 
-static q_noinline uint32_t blend_7_1(uint32_t A, uint32_t B)
+static inline uint32_t blend_7_1(uint32_t A, uint32_t B)
 {
     return pack((grow(A) * 7 + grow(B)) >> 3);
 }
 
-static q_noinline uint32_t blend_5_3(uint32_t A, uint32_t B)
+static inline uint32_t blend_5_3(uint32_t A, uint32_t B)
 {
     return pack((grow(A) * 5 + grow(B) * 3) >> 3);
 }
 
-static q_noinline uint32_t blend_2_1_1(uint32_t A, uint32_t B, uint32_t C)
+static inline uint32_t blend_2_1_1(uint32_t A, uint32_t B, uint32_t C)
 {
     return pack((grow(A) * 2 + grow(B) + grow(C)) >> 2);
 }
 
-static q_noinline uint32_t blend_5_2_1(uint32_t A, uint32_t B, uint32_t C)
+static inline uint32_t blend_5_2_1(uint32_t A, uint32_t B, uint32_t C)
 {
     return pack((grow(A) * 5 + grow(B) * 2 + grow(C)) >> 3);
 }
 
-static q_noinline uint32_t blend_6_1_1(uint32_t A, uint32_t B, uint32_t C)
+static inline uint32_t blend_6_1_1(uint32_t A, uint32_t B, uint32_t C)
 {
     return pack((grow(A) * 6 + grow(B) + grow(C)) >> 3);
 }
 
-static q_noinline uint32_t blend_2_3_3(uint32_t A, uint32_t B, uint32_t C)
+static inline uint32_t blend_2_3_3(uint32_t A, uint32_t B, uint32_t C)
 {
     return pack((grow(A) * 2 + (grow(B) + grow(C)) * 3) >> 3);
 }
 
-static q_noinline uint32_t blend_14_1_1(uint32_t A, uint32_t B, uint32_t C)
+static inline uint32_t blend_14_1_1(uint32_t A, uint32_t B, uint32_t C)
 {
     return pack((grow(A) * 14 + grow(B) + grow(C)) >> 4);
 }
@@ -351,104 +360,330 @@ static q_noinline void hq4x_blend(int rule, uint32_t *p00, uint32_t *p01, uint32
     }
 }
 
-void HQ2x_Render(uint32_t *output, const uint32_t *input, int width, int height)
+/*
+=============================================================================
+
+PATTERN KERNELS
+
+Neighbour comparisons are the bulk of work done by the filter. To avoid
+converting each pixel to YCbCr 9 times, conversion is done once into
+separate Y, Cb, Cr and transparency planes, with 1 pixel border that
+replicates edge pixels. Neighbours can then be fetched with constant
+offsets, and patterns can be computed for several pixels at once.
+
+=============================================================================
+*/
+
+static inline void neighbour_offsets(int ofs[8], int stride)
 {
-    int x, y;
-
-    for (y = 0; y < height; y++) {
-        const uint32_t *in = input + y * width;
-        uint32_t *out0 = output + (y * 2 + 0) * width * 2;
-        uint32_t *out1 = output + (y * 2 + 1) * width * 2;
-
-        int prevline = (y == 0 ? 0 : width);
-        int nextline = (y == height - 1 ? 0 : width);
-
-        for (x = 0; x < width; x++) {
-            int prev = (x == 0 ? 0 : 1);
-            int next = (x == width - 1 ? 0 : 1);
-
-            uint32_t A = *(in - prevline - prev);
-            uint32_t B = *(in - prevline);
-            uint32_t C = *(in - prevline + next);
-            uint32_t D = *(in - prev);
-            uint32_t E = *(in);
-            uint32_t F = *(in + next);
-            uint32_t G = *(in + nextline - prev);
-            uint32_t H = *(in + nextline);
-            uint32_t I = *(in + nextline + next);
-
-            int pattern;
-            pattern  = diff(E, A) << 0;
-            pattern |= diff(E, B) << 1;
-            pattern |= diff(E, C) << 2;
-            pattern |= diff(E, D) << 3;
-            pattern |= diff(E, F) << 4;
-            pattern |= diff(E, G) << 5;
-            pattern |= diff(E, H) << 6;
-            pattern |= diff(E, I) << 7;
-
-            *(out0 + 0) = hq2x_blend(hqTable[pattern], E, A, B, D, F, H); pattern = rotTable[pattern];
-            *(out0 + 1) = hq2x_blend(hqTable[pattern], E, C, F, B, H, D); pattern = rotTable[pattern];
-            *(out1 + 1) = hq2x_blend(hqTable[pattern], E, I, H, F, D, B); pattern = rotTable[pattern];
-            *(out1 + 0) = hq2x_blend(hqTable[pattern], E, G, D, H, B, F);
-
-            in++;
-            out0 += 2;
-            out1 += 2;
+    ofs[0] = -stride - 1;
+    ofs[1] = -stride;
+    ofs[2] = -stride + 1;
+    ofs[3] = -1;
+    ofs[4] = 1;
+    ofs[5] = stride - 1;
+    ofs[6] = stride;
+    ofs[7] = stride + 1;
+}
+
+// must give the same result as diff()
+static inline int pattern_pixel(const int32_t *const p[4], const int ofs[8], int x)
+{
+    int k, d, o, pattern = 0;
+
+    for (k = 0; k < 8; k++) {
+        o = x + ofs[k];
+        if (p[3][x] & p[3][o])
+            d = 0;
+        else if (p[3][x] | p[3][o])
+            d = 1;
+        else
+            d = abs(p[0][x] - p[0][o]) > maxY ||
+                abs(p[1][x] - p[1][o]) > maxCb ||
+                abs(p[2][x] - p[2][o]) > maxCr;
+        pattern |= d << k;
+    }
+
+    return pattern;
+}
+
+void HQ_Pattern_C(uint8_t *pattern, const int32_t *const planes[4], int stride, int width)
+{
+    int x, ofs[8];
+
+    neighbour_offsets(ofs, stride);
+    for (x = 0; x < width; x++)
+        pattern[x] = pattern_pixel(planes, ofs, x);
+}
+
+#if USE_SSE2
+
+static inline __m128i cmpabsgt_sse2(__m128i a, __m128i b, __m128i max)
+{
+    return _mm_or_si128(_mm_cmpgt_epi32(_mm_sub_epi32(a, b), max),
+                        _mm_cmpgt_epi32(_mm_sub_epi32(b, a), max));
+}
+
+void HQ_Pattern_SSE2(uint8_t *pattern, const int32_t *const planes[4], int stride, int width)
+{
+    const __m128i maxy = _mm_set1_epi32(maxY);
+    const __m128i maxcb = _mm_set1_epi32(maxCb);
+    const __m128i maxcr = _mm_set1_epi32(maxCr);
+    int x, k, ofs[8];
+
+    neighbour_offsets(ofs, stride);
+    for (x = 0; x < width - 3; x += 4) {
+        __m128i ey = _mm_loadu_si128((const __m128i *)(planes[0] + x));
+        __m128i ecb = _mm_loadu_si128((const __m128i *)(planes[1] + x));
+        __m128i ecr = _mm_loadu_si128((const __m128i *)(planes[2] + x));
+        __m128i et = _mm_loadu_si128((const __m128i *)(planes[3] + x));
+        __m128i pat = _mm_setzero_si128();
+
+        for (k = 0; k < 8; k++) {
+            int o = x + ofs[k];
+            __m128i ny = _mm_loadu_si128((const __m128i *)(planes[0] + o));
+            __m128i ncb = _mm_loadu_si128((const __m128i *)(planes[1] + o));
+            __m128i ncr = _mm_loadu_si128((const __m128i *)(planes[2] + o));
+            __m128i nt = _mm_loadu_si128((const __m128i *)(planes[3] + o));
+            __m128i d;
+
+            d = cmpabsgt_sse2(ey, ny, maxy);
+            d = _mm_or_si128(d, cmpabsgt_sse2(ecb, ncb, maxcb));
+            d = _mm_or_si128(d, cmpabsgt_sse2(ecr, ncr, maxcr));
+            d = _mm_or_si128(d, _mm_xor_si128(et, nt));
+            d = _mm_andnot_si128(_mm_and_si128(et, nt), d);
+            pat = _mm_or_si128(pat, _mm_and_si128(d, _mm_set1_epi32(1 << k)));
         }
+
+        pat = _mm_packs_epi32(pat, pat);
+        pat = _mm_packus_epi16(pat, pat);
+        WN32(pattern + x, _mm_cvtsi128_si32(pat));
     }
+
+    for (; x < width; x++)
+        pattern[x] = pattern_pixel(planes, ofs, x);
+}
+
+#endif  // USE_SSE2
+
+#if USE_AVX2
+
+static inline q_target_avx2
+__m256i cmpabsgt_avx2(__m256i a, __m256i b, __m256i max)
+{
+    return _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_sub_epi32(a, b), max),
+                           _mm256_cmpgt_epi32(_mm256_sub_epi32(b, a), max));
 }
 
-void HQ4x_Render(uint32_t *output, const uint32_t *input, int width, int height)
+q_target_avx2
+void HQ_Pattern_AVX2(uint8_t *pattern, const int32_t *const planes[4], int stride, int width)
 {
-    int x, y;
-
-    for (y = 0; y < height; y++) {
-        const uint32_t *in = input + y * width;
-        uint32_t *out0 = output + (y * 4 + 0) * width * 4;
-        uint32_t *out1 = output + (y * 4 + 1) * width * 4;
-        uint32_t *out2 = output + (y * 4 + 2) * width * 4;
-        uint32_t *out3 = output + (y * 4 + 3) * width * 4;
-
-        int prevline = (y == 0 ? 0 : width);
-        int nextline = (y == height - 1 ? 0 : width);
-
-        for (x = 0; x < width; x++) {
-            int prev = (x == 0 ? 0 : 1);
-            int next = (x == width - 1 ? 0 : 1);
-
-            uint32_t A = *(in - prevline - prev);
-            uint32_t B = *(in - prevline);
-            uint32_t C = *(in - prevline + next);
-            uint32_t D = *(in - prev);
-            uint32_t E = *(in);
-            uint32_t F = *(in + next);
-            uint32_t G = *(in + nextline - prev);
-            uint32_t H = *(in + nextline);
-            uint32_t I = *(in + nextline + next);
-
-            int pattern;
-            pattern  = diff(E, A) << 0;
-            pattern |= diff(E, B) << 1;
-            pattern |= diff(E, C) << 2;
-            pattern |= diff(E, D) << 3;
-            pattern |= diff(E, F) << 4;
-            pattern |= diff(E, G) << 5;
-            pattern |= diff(E, H) << 6;
-            pattern |= diff(E, I) << 7;
-
-            hq4x_blend(hqTable[pattern], out0 + 0, out0 + 1, out1 + 0, out1 + 1, E, A, B, D, F, H); pattern = rotTable[pattern];
-            hq4x_blend(hqTable[pattern], out0 + 3, out1 + 3, out0 + 2, out1 + 2, E, C, F, B, H, D); pattern = rotTable[pattern];
-            hq4x_blend(hqTable[pattern], out3 + 3, out3 + 2, out2 + 3, out2 + 2, E, I, H, F, D, B); pattern = rotTable[pattern];
-            hq4x_blend(hqTable[pattern], out3 + 0, out2 + 0, out3 + 1, out2 + 1, E, G, D, H, B, F);
-
-            in++;
-            out0 += 4;
-            out1 += 4;
-            out2 += 4;
-            out3 += 4;
+    const __m256i maxy = _mm256_set1_epi32(maxY);
+    const __m256i maxcb = _mm256_set1_epi32(maxCb);
+    const __m256i maxcr = _mm256_set1_epi32(maxCr);
+    int x, k, ofs[8];
+
+    neighbour_offsets(ofs, stride);
+    for (x = 0; x < width - 7; x += 8) {
+        __m256i ey = _mm256_loadu_si256((const __m256i *)(planes[0] + x));
+        __m256i ecb = _mm256_loadu_si256((const __m256i *)(planes[1] + x));
+        __m256i ecr = _mm256_loadu_si256((const __m256i *)(planes[2] + x));
+        __m256i et = _mm256_loadu_si256((const __m256i *)(planes[3] + x));
+        __m256i pat = _mm256_setzero_si256();
+        __m128i res;
+
+        for (k = 0; k < 8; k++) {
+            int o = x + ofs[k];
+            __m256i ny = _mm256_loadu_si256((const __m256i *)(planes[0] + o));
+            __m256i ncb = _mm256_loadu_si256((const __m256i *)(planes[1] + o));
+            __m256i ncr = _mm256_loadu_si256((const __m256i *)(planes[2] + o));
+            __m256i nt = _mm256_loadu_si256((const __m256i *)(planes[3] + o));
+            __m256i d;
+
+            d = cmpabsgt_avx2(ey, ny, maxy);
+            d = _mm256_or_si256(d, cmpabsgt_avx2(ecb, ncb, maxcb));
+            d = _mm256_or_si256(d, cmpabsgt_avx2(ecr, ncr, maxcr));
+            d = _mm256_or_si256(d, _mm256_xor_si256(et, nt));
+            d = _mm256_andnot_si256(_mm256_and_si256(et, nt), d);
+            pat = _mm256_or_si256(pat, _mm256_and_si256(d, _mm256_set1_epi32(1 << k)));
         }
+
+        res = _mm_packs_epi32(_mm256_castsi256_si128(pat), _mm256_extracti128_si256(pat, 1));
+        res = _mm_packus_epi16(res, res);
+        _mm_storel_epi64((__m128i *)(pattern + x), res);
     }
+
+    for (; x < width; x++)
+        pattern[x] = pattern_pixel(planes, ofs, x);
+}
+
+#endif  // USE_AVX2
+
+/*
+=============================================================================
+
+RENDERING
+
+=============================================================================
+*/
+
+typedef struct {
+    const imgfuncs_t    *funcs;
+    uint32_t            *output;
+    const uint32_t      *input;
+    int                 width, height;
+    int                 stride;
+    int32_t             *planes[4];
+    uint8_t             *pattern;
+} hqjob_t;
+
+static void build_planes(void *arg, int index, int thread)
+{
+    hqjob_t *job = arg;
+    const uint32_t *in = job->input + Q_clip(index - 1, 0, job->height - 1) * job->width;
+    int i, x, ofs = index * job->stride;
+    color_t c;
+
+    for (i = 0; i < job->stride; i++, ofs++) {
+        x = Q_clip(i - 1, 0, job->width - 1);
+        c.u32 = in[x];
+        job->planes[0][ofs] = yccTable[0][c.u8[0]] + yccTable[1][c.u8[1]] + yccTable[2][c.u8[2]];
+        job->planes[1][ofs] = yccTable[3][c.u8[0]] + yccTable[4][c.u8[1]] + yccTable[5][c.u8[2]];
+        job->planes[2][ofs] = yccTable[5][c.u8[0]] + yccTable[6][c.u8[1]] + yccTable[7][c.u8[2]];
+        job->planes[3][ofs] = c.u8[3] ? 0 : -1;
+    }
+}
+
+static uint8_t *build_pattern(const hqjob_t *job, int y)
+{
+    const int32_t *planes[4];
+    uint8_t *pattern = job->pattern + y * job->width;
+    int i, ofs = (y + 1) * job->stride + 1;
+
+    for (i = 0; i < 4; i++)
+        planes[i] = job->planes[i] + ofs;
+
+    job->funcs->hq_pattern(pattern, planes, job->stride, job->width);
+    return pattern;
+}
+
+static void render_hq2x(void *arg, int y, int thread)
+{
+    const hqjob_t *job = arg;
+    int x, width = job->width, height = job->height;
+    const uint8_t *patterns = build_pattern(job, y);
+    const uint32_t *in = job->input + y * width;
+    uint32_t *out0 = job->output + (y * 2 + 0) * width * 2;
+    uint32_t *out1 = job->output + (y * 2 + 1) * width * 2;
+
+    int prevline = (y == 0 ? 0 : width);
+    int nextline = (y == height - 1 ? 0 : width);
+
+    for (x = 0; x < width; x++) {
+        int prev = (x == 0 ? 0 : 1);
+        int next = (x == width - 1 ? 0 : 1);
+
+        uint32_t A = *(in - prevline - prev);
+        uint32_t B = *(in - prevline);
+        uint32_t C = *(in - prevline + next);
+        uint32_t D = *(in - prev);
+        uint32_t E = *(in);
+        uint32_t F = *(in + next);
+        uint32_t G = *(in + nextline - prev);
+        uint32_t H = *(in + nextline);
+        uint32_t I = *(in + nextline + next);
+
+        int pattern = patterns[x];
+
+        *(out0 + 0) = hq2x_blend(hqTable[pattern], E, A, B, D, F, H); pattern = rotTable[pattern];
+        *(out0 + 1) = hq2x_blend(hqTable[pattern], E, C, F, B, H, D); pattern = rotTable[pattern];
+        *(out1 + 1) = hq2x_blend(hqTable[pattern], E, I, H, F, D, B); pattern = rotTable[pattern];
+        *(out1 + 0) = hq2x_blend(hqTable[pattern], E, G, D, H, B, F);
+
+        in++;
+        out0 += 2;
+        out1 += 2;
+    }
+}
+
+static void render_hq4x(void *arg, int y, int thread)
+{
+    const hqjob_t *job = arg;
+    int x, width = job->width, height = job->height;
+    const uint8_t *patterns = build_pattern(job, y);
+    const uint32_t *in = job->input + y * width;
+    uint32_t *out0 = job->output + (y * 4 + 0) * width * 4;
+    uint32_t *out1 = job->output + (y * 4 + 1) * width * 4;
+    uint32_t *out2 = job->output + (y * 4 + 2) * width * 4;
+    uint32_t *out3 = job->output + (y * 4 + 3) * width * 4;
+
+    int prevline = (y == 0 ? 0 : width);
+    int nextline = (y == height - 1 ? 0 : width);
+
+    for (x = 0; x < width; x++) {
+        int prev = (x == 0 ? 0 : 1);
+        int next = (x == width - 1 ? 0 : 1);
+
+        uint32_t A = *(in - prevline - prev);
+        uint32_t B = *(in - prevline);
+        uint32_t C = *(in - prevline + next);
+        uint32_t D = *(in - prev);
+        uint32_t E = *(in);
+        uint32_t F = *(in + next);
+        uint32_t G = *(in + nextline - prev);
+        uint32_t H = *(in + nextline);
+        uint32_t I = *(in + nextline + next);
+
+        int pattern = patterns[x];
+
+        hq4x_blend(hqTable[pattern], out0 + 0, out0 + 1, out1 + 0, out1 + 1, E, A, B, D, F, H); pattern = rotTable[pattern];
+        hq4x_blend(hqTable[pattern], out0 + 3, out1 + 3, out0 + 2, out1 + 2, E, C, F, B, H, D); pattern = rotTable[pattern];
+        hq4x_blend(hqTable[pattern], out3 + 3, out3 + 2, out2 + 3, out2 + 2, E, I, H, F, D, B); pattern = rotTable[pattern];
+        hq4x_blend(hqTable[pattern], out3 + 0, out2 + 0, out3 + 1, out2 + 1, E, G, D, H, B, F);
+
+        in++;
+        out0 += 4;
+        out1 += 4;
+        out2 += 4;
+        out3 += 4;
+    }
+}
+
+static void render(const imgfuncs_t *funcs, jobfunc_t func, uint32_t *output,
+                   const uint32_t *input, int width, int height)
+{
+    hqjob_t job;
+    size_t size;
+    int i;
+
+    job.funcs = funcs;
+    job.output = output;
+    job.input = input;
+    job.width = width;
+    job.height = height;
+    job.stride = width + 2;
+
+    size = job.stride * (height + 2);
+    job.planes[0] = FS_AllocTempMem(size * sizeof(int32_t) * 4 + width * height);
+    for (i = 1; i < 4; i++)
+        job.planes[i] = job.planes[i - 1] + size;
+    job.pattern = (uint8_t *)(job.planes[3] + size);
+
+    // rows are independent, process them in parallel
+    Com_ParallelFor(build_planes, &job, height + 2);
+    Com_ParallelFor(func, &job, height);
+
+    FS_FreeTempMem(job.planes[0]);
+}
+
+void HQ2x_Render(const imgfuncs_t *funcs, uint32_t *output, const uint32_t *input, int width, int height)
+{
+    render(funcs, render_hq2x, output, input, width, height);
+}
+
+void HQ4x_Render(const imgfuncs_t *funcs, uint32_t *output, const uint32_t *input, int width, int height)
+{
+    render(funcs, render_hq4x, output, input, width, height);
 }
 
 #define FIX(x)      (int)((x) * (1 << 16))
@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/cvar.h"
 #include "common/files.h"
 #include "common/intreadwrite.h"
+#include "common/jobs.h"
 #include "common/sizebuf.h"
 #include "system/system.h"
 #include "format/pcx.h"
@@ -50,11 +51,63 @@ with this program; if not, write to the Free Software Foundation, Inc.,
     static int IMG_Load##x(const byte *rawdata, size_t rawlen, \
         image_t *image, byte **pic)
 
+static bool img_threaded;   // images are being decoded on job threads
+
 static bool check_image_size(unsigned w, unsigned h)
 {
     return (w < 1 || h < 1 || w > MAX_TEXTURE_SIZE || h > MAX_TEXTURE_SIZE);
 }
 
+// decoders may run on job threads during prefetch, serialize
+// access to zone, console and last error buffer
+static void *IMG_AllocPixels(size_t size)
+{
+    void *ptr;
+
+    if (img_threaded)
+        Com_LockJobs();
+    ptr = FS_AllocTempMem(size);
+    if (img_threaded)
+        Com_UnlockJobs();
+
+    return ptr;
+}
+
+static void IMG_FreePixels(void *ptr)
+{
+    if (img_threaded)
+        Com_LockJobs();
+    FS_FreeTempMem(ptr);
+    if (img_threaded)
+        Com_UnlockJobs();
+}
+
+static void IMG_SetError(const char *msg)
+{
+    if (img_threaded)
+        Com_LockJobs();
+    Com_SetLastError(msg);
+    if (img_threaded)
+        Com_UnlockJobs();
+}
+
+q_printf(1, 2)
+static void IMG_Warning(const char *fmt, ...)
+{
+    char buffer[MAX_STRING_CHARS];
+    va_list ap;
+
+    va_start(ap, fmt);
+    Q_vsnprintf(buffer, sizeof(buffer), fmt, ap);
+    va_end(ap);
+
+    if (img_threaded)
+        Com_LockJobs();
+    Com_WPrintf("%s", buffer);
+    if (img_threaded)
+        Com_UnlockJobs();
+}
+
 /*
 ====================================================================
 
@@ -225,25 +278,25 @@ static int load_pcx(const byte *rawdata, size_t rawlen,
         return Q_ERR_UNKNOWN_FORMAT;
 
     if (pcx->encoding != 1 || pcx->bits_per_pixel != 8) {
-        Com_SetLastError("Unsupported encoding or bits per pixel");
+        IMG_SetError("Unsupported encoding or bits per pixel");
         return Q_ERR_INVALID_FORMAT;
     }
 
     w = (LittleShort(pcx->xmax) - LittleShort(pcx->xmin)) + 1;
     h = (LittleShort(pcx->ymax) - LittleShort(pcx->ymin)) + 1;
     if (check_image_size(w, h)) {
-        Com_SetLastError("Invalid image dimensions");
+        IMG_SetError("Invalid image dimensions");
         return Q_ERR_INVALID_FORMAT;
     }
 
     if (pcx->color_planes != 1 && (palette || pcx->color_planes != 3)) {
-        Com_SetLastError("Unsupported number of color planes");
+        IMG_SetError("Unsupported number of color planes");
         return Q_ERR_INVALID_FORMAT;
     }
 
     bytes_per_line = LittleShort(pcx->bytes_per_line);
     if (bytes_per_line < w) {
-        Com_SetLastError("Invalid number of bytes per line");
+        IMG_SetError("Invalid number of bytes per line");
         return Q_ERR_INVALID_FORMAT;
     }
 
@@ -298,7 +351,7 @@ static int load_pcx(const byte *rawdata, size_t rawlen,
 
         if (is_pal) {
             if (SZ_Remaining(&s) < PCX_PALETTE_SIZE)
-                Com_WPrintf("PCX file %s possibly corrupted\n", image->name);
+                IMG_Warning("PCX file %s possibly corrupted\n", image->name);
 
             if (image->type == IT_SKIN)
                 IMG_FloodFill(pixels, w, h);
@@ -309,7 +362,8 @@ static int load_pcx(const byte *rawdata, size_t rawlen,
 
             IMG_FreePixels(pixels);
         } else {
-            Com_DWPrintf("%s is a 24-bit PCX file. This is not portable.\n", image->name);
+            if (COM_DEVELOPER)
+                IMG_Warning("%s is a 24-bit PCX file. This is not portable.\n", image->name);
             *pic = pixels;
             image->flags |= IF_OPAQUE;
         }
@@ -347,13 +401,13 @@ IMG_LOAD(WAL)
     w = LittleLong(mt->width);
     h = LittleLong(mt->height);
     if (check_image_size(w, h))  {
-        Com_SetLastError("Invalid image dimensions");
+        IMG_SetError("Invalid image dimensions");
         return Q_ERR_INVALID_FORMAT;
     }
 
     offset = LittleLong(mt->offsets[0]);
     if ((uint64_t)offset + w * h > rawlen) {
-        Com_SetLastError("Data out of bounds");
+        IMG_SetError("Data out of bounds");
         return Q_ERR_INVALID_FORMAT;
     }
 
@@ -546,12 +600,12 @@ IMG_LOAD(TGA)
     case TGA_Mono:
         break;
     default:
-        Com_SetLastError("Unsupported targa image type");
+        IMG_SetError("Unsupported targa image type");
         return Q_ERR_INVALID_FORMAT;
     }
 
     if (check_image_size(w, h)) {
-        Com_SetLastError("Invalid image dimensions");
+        IMG_SetError("Invalid image dimensions");
         return Q_ERR_INVALID_FORMAT;
     }
 
@@ -563,7 +617,7 @@ IMG_LOAD(TGA)
     case 32:
         break;
     default:
-        Com_SetLastError("Unsupported number of bits per pixel");
+        IMG_SetError("Unsupported number of bits per pixel");
         return Q_ERR_INVALID_FORMAT;
     }
 
@@ -578,17 +632,17 @@ IMG_LOAD(TGA)
         interleave = 4;
         break;
     default:
-        Com_SetLastError("Unsupported interleaving flag");
+        IMG_SetError("Unsupported interleaving flag");
         return Q_ERR_INVALID_FORMAT;
     }
 
     if (image_type == TGA_Colormap) {
         if (!colormap_type) {
-            Com_SetLastError("Colormapped image but no colormap present");
+            IMG_SetError("Colormapped image but no colormap present");
             return Q_ERR_INVALID_FORMAT;
         }
         if (pixel_size != 8) {
-            Com_SetLastError("Only 8-bit colormaps are supported");
+            IMG_SetError("Only 8-bit colormaps are supported");
             return Q_ERR_INVALID_FORMAT;
         }
     }
@@ -609,12 +663,12 @@ IMG_LOAD(TGA)
         case 32:
             break;
         default:
-            Com_SetLastError("Unsupported number of bits per colormap pixel");
+            IMG_SetError("Unsupported number of bits per colormap pixel");
             return Q_ERR_INVALID_FORMAT;
         }
 
         if (colormap_start + colormap_length > 256) {
-            Com_SetLastError("Too many colormap entries");
+            IMG_SetError("Too many colormap entries");
             return Q_ERR_INVALID_FORMAT;
         }
 
@@ -748,9 +802,9 @@ static void my_output_message_2(j_common_ptr cinfo, bool err_exit)
     (*cinfo->err->format_message)(cinfo, buffer);
 
     if (err_exit)
-        Com_SetLastError(buffer);
+        IMG_SetError(buffer);
     else
-        Com_WPrintf("libjpeg: %s: %s\n", jerr->filename, buffer);
+        IMG_Warning("libjpeg: %s: %s\n", jerr->filename, buffer);
 }
 
 static void my_output_message(j_common_ptr cinfo)
@@ -779,7 +833,7 @@ static int my_jpeg_start_decompress(j_decompress_ptr cinfo, const byte *rawdata,
     jpeg_read_header(cinfo, TRUE);
 
     if (cinfo->out_color_space != JCS_RGB && cinfo->out_color_space != JCS_GRAYSCALE) {
-        Com_SetLastError("Invalid image color space");
+        IMG_SetError("Invalid image color space");
         return Q_ERR_INVALID_FORMAT;
     }
 
@@ -788,12 +842,12 @@ static int my_jpeg_start_decompress(j_decompress_ptr cinfo, const byte *rawdata,
     jpeg_start_decompress(cinfo);
 
     if (cinfo->output_components != 4) {
-        Com_SetLastError("Invalid number of color components");
+        IMG_SetError("Invalid number of color components");
         return Q_ERR_INVALID_FORMAT;
     }
 
     if (check_image_size(cinfo->output_width, cinfo->output_height)) {
-        Com_SetLastError("Invalid image dimensions");
+        IMG_SetError("Invalid image dimensions");
         return Q_ERR_INVALID_FORMAT;
     }
 
@@ -943,7 +997,7 @@ static void my_png_error_fn(png_structp png_ptr, png_const_charp error_msg)
     my_png_error *err = png_get_error_ptr(png_ptr);
 
     if (err->filename)
-        Com_SetLastError(error_msg);
+        IMG_SetError(error_msg);
 
     longjmp(err->setjmp_buffer, -1);
 }
@@ -953,7 +1007,7 @@ static void my_png_warning_fn(png_structp png_ptr, png_const_charp warning_msg)
     my_png_error *err = png_get_error_ptr(png_ptr);
 
     if (err->filename)
-        Com_WPrintf("libpng: %s: %s\n", err->filename, warning_msg);
+        IMG_Warning("libpng: %s: %s\n", err->filename, warning_msg);
 }
 
 static int my_png_read_header(png_structp png_ptr, png_infop info_ptr,
@@ -974,7 +1028,7 @@ static int my_png_read_header(png_structp png_ptr, png_infop info_ptr,
         return Q_ERR_FAILURE;
 
     if (check_image_size(w, h)) {
-        Com_SetLastError("Invalid image dimensions");
+        IMG_SetError("Invalid image dimensions");
         return Q_ERR_INVALID_FORMAT;
     }
 
@@ -1050,7 +1104,7 @@ IMG_LOAD(PNG)
     png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
                                      (png_voidp)&my_err, my_png_error_fn, my_png_warning_fn);
     if (!png_ptr) {
-        Com_SetLastError("png_create_read_struct failed");
+        IMG_SetError("png_create_read_struct failed");
         return Q_ERR_LIBRARY_ERROR;
     }
 
@@ -1117,7 +1171,7 @@ static int IMG_SavePNG(const screenshot_t *s)
                                       (png_voidp)&my_err, my_png_error_fn, my_png_warning_fn);
     if (!png_ptr) {
         if (!s->async)
-            Com_SetLastError("png_create_write_struct failed");
+            IMG_SetError("png_create_write_struct failed");
         return Q_ERR_LIBRARY_ERROR;
     }
 
@@ -1587,6 +1641,7 @@ static void IMG_List_f(void)
 
     Com_Printf("Total images: %d (out of %d slots)\n", count, r_numImages);
     Com_Printf("Total texels: %zu (not counting mipmaps)\n", texels);
+    IMG_PrintCacheStats();
 }
 
 static image_t *alloc_image(void)
@@ -1638,16 +1693,81 @@ static image_t *lookup_image(const char *name,
     return NULL;
 }
 
+#define PREFETCH_GROW   64
+
+typedef struct {
+    image_t         image;  // gets extension of the file actually found
+    imageflags_t    flags;  // as requested
+    imageformat_t   fmt;
+    void            *data;  // raw file contents
+    int             len;
+    byte            *pic;   // decoded pixels, consumed by IMG_Find
+} prefetch_t;
+
+static struct {
+    prefetch_t  *items;
+    int         count;
+    int         pending;    // first item not yet read and decoded
+    prefetch_t  *reading;   // item whose file is being read
+} img_prefetch;
+
+regtimes_t  r_regtimes;
+
+static prefetch_t *find_prefetched(const image_t *image)
+{
+    prefetch_t  *p;
+    int         i;
+
+    for (i = 0, p = img_prefetch.items; i < img_prefetch.pending; i++, p++) {
+        if (!p->pic)
+            continue;
+        if (p->image.type != image->type || p->flags != image->flags)
+            continue;
+        if (!FS_pathcmp(p->image.name, image->name))
+            return p;
+    }
+
+    return NULL;
+}
+
 static int try_image_format(imageformat_t fmt, image_t *image, byte **pic)
 {
-    void    *data;
-    int     ret;
+    prefetch_t  *p;
+    void        *data;
+    int         ret;
+
+    // use pixels decoded in advance, if any
+    if ((p = find_prefetched(image))) {
+        *pic = p->pic;
+        p->pic = NULL;
+        image->flags |= p->image.flags;
+        image->width = p->image.width;
+        image->height = p->image.height;
+        image->upload_width = p->image.upload_width;
+        image->upload_height = p->image.upload_height;
+        image->cache_key = 0;
+        return fmt;
+    }
 
     // load the file
     ret = FS_LoadFile(image->name, &data);
     if (!data)
         return ret;
 
+    // just remember the file, it will be decoded on job thread
+    if (img_prefetch.reading) {
+        img_prefetch.reading->fmt = fmt;
+        img_prefetch.reading->data = data;
+        img_prefetch.reading->len = ret;
+        return fmt;
+    }
+
+    // skip decoding if processed texture was found in cache
+    if (IMG_LoadCached(image, data, ret)) {
+        FS_FreeFile(data);
+        return fmt;
+    }
+
     // decompress the image
     ret = img_loaders[fmt].load(data, ret, image, pic);
 
@@ -1919,6 +2039,7 @@ static image_t *find_or_load_image(const char *name, size_t len,
     unsigned        hash;
     size_t          baselen;
     imageformat_t   fmt;
+    uint64_t        start;
     int             ret;
 
     Q_assert(len < MAX_QPATH);
@@ -1963,6 +2084,7 @@ static image_t *find_or_load_image(const char *name, size_t len,
 
     // load the pic from disk
     pic = NULL;
+    start = Sys_Microseconds();
 
     if (flags & IF_KEEP_EXTENSION) {
         // direct load requested (for testing code)
@@ -1974,6 +2096,8 @@ static image_t *find_or_load_image(const char *name, size_t len,
         ret = load_image_data(image, fmt, true, &pic);
     }
 
+    r_regtimes.load += Sys_Microseconds() - start;
+
     if (ret < 0) {
         print_error(image->name, flags, ret);
         if (flags & IF_PERMANENT) {
@@ -1994,6 +2118,8 @@ static image_t *find_or_load_image(const char *name, size_t len,
     if (r_glowmaps->integer && (type == IT_SKIN || type == IT_WALL))
         check_for_glow_map(image);
 
+    start = Sys_Microseconds();
+
     if (type == IT_SKY && flags & IF_CLASSIC_SKY) {
         // upload the top half of the image (solid)
         image->height /= 2;
@@ -2013,14 +2139,17 @@ static image_t *find_or_load_image(const char *name, size_t len,
 
         IMG_Load(&temporary, pic);
         image->texnum2 = temporary.texnum;
-    } else {
-        // upload the image
+    } else if (pic) {
+        // upload the image (unless it was restored from texture cache)
         IMG_Load(image, pic);
     }
 
     // don't need pics in memory after GL upload
     Z_Free(pic);
 
+    r_regtimes.upload += Sys_Microseconds() - start;
+    r_regtimes.uploaded++;
+
     return image;
 
 fail:
@@ -2064,6 +2193,25 @@ image_t *IMG_ForHandle(qhandle_t h)
     return &r_images[h];
 }
 
+static size_t image_fullname(char *fullname, const char *name, imagetype_t type)
+{
+    size_t len;
+
+    if (type == IT_SKIN || type == IT_SPRITE) {
+        len = FS_NormalizePathBuffer(fullname, name, MAX_QPATH);
+    } else if (*name == '/' || *name == '\\') {
+        len = FS_NormalizePathBuffer(fullname, name + 1, MAX_QPATH);
+    } else {
+        len = Q_concat(fullname, MAX_QPATH, "pics/", name);
+        if (len < MAX_QPATH) {
+            FS_NormalizePath(fullname);
+            len = COM_DefaultExtension(fullname, ".pcx", MAX_QPATH);
+        }
+    }
+
+    return len;
+}
+
 /*
 ===============
 R_RegisterImage
@@ -2085,18 +2233,7 @@ qhandle_t R_RegisterImage(const char *name, imagetype_t type, imageflags_t flags
     if (!r_numImages)
         return 0;
 
-    if (type == IT_SKIN || type == IT_SPRITE) {
-        len = FS_NormalizePathBuffer(fullname, name, sizeof(fullname));
-    } else if (*name == '/' || *name == '\\') {
-        len = FS_NormalizePathBuffer(fullname, name + 1, sizeof(fullname));
-    } else {
-        len = Q_concat(fullname, sizeof(fullname), "pics/", name);
-        if (len < sizeof(fullname)) {
-            FS_NormalizePath(fullname);
-            len = COM_DefaultExtension(fullname, ".pcx", sizeof(fullname));
-        }
-    }
-
+    len = image_fullname(fullname, name, type);
     if (len >= sizeof(fullname)) {
         print_error(fullname, flags, Q_ERR(ENAMETOOLONG));
         return 0;
@@ -2108,6 +2245,180 @@ qhandle_t R_RegisterImage(const char *name, imagetype_t type, imageflags_t flags
     return 0;
 }
 
+/*
+=========================================================
+
+IMAGE PREFETCH
+
+Image files queued during registration are read serially,
+then decoded in parallel on job threads. IMG_Find picks up
+decoded pixels instead of loading the file again, so that
+only processing and GL uploads remain on the main thread.
+
+=========================================================
+*/
+
+static void prefetch_image(const char *name, size_t len, imagetype_t type, imageflags_t flags)
+{
+    prefetch_t  *p;
+    size_t      baselen;
+    unsigned    hash;
+    int         i;
+
+    if (len >= MAX_QPATH)
+        return;
+
+    // skies and direct loads take special paths
+    if (type == IT_SKY || (flags & IF_KEEP_EXTENSION))
+        return;
+
+    baselen = COM_FileExtension(name) - name;
+    if (baselen < 1 || name[baselen] != '.')
+        return;
+
+    // already registered (or known to be missing)
+    hash = FS_HashPathLen(name, baselen, RIMAGES_HASH);
+    if (lookup_image(name, type, hash, baselen))
+        return;
+
+    // already queued
+    for (i = 0, p = img_prefetch.items; i < img_prefetch.count; i++, p++) {
+        if (p->image.type != type || p->image.baselen != baselen)
+            continue;
+        if (!FS_pathcmpn(p->image.name, name, baselen))
+            return;
+    }
+
+    if (!(img_prefetch.count % PREFETCH_GROW))
+        img_prefetch.items = Z_ReallocArray(img_prefetch.items,
+                                            img_prefetch.count + PREFETCH_GROW,
+                                            sizeof(*p), TAG_RENDERER);
+
+    p = &img_prefetch.items[img_prefetch.count];
+    memset(p, 0, sizeof(*p));
+    memcpy(p->image.name, name, len + 1);
+    p->image.baselen = baselen;
+    p->image.type = type;
+    p->image.flags = flags;
+    p->flags = p->image.flags;
+
+    // texture cache doesn't need decoded pixels
+    if (IMG_UseCache(&p->image))
+        return;
+
+    img_prefetch.count++;
+}
+
+// queues image for R_FinishPrefetch, name is interpreted like IMG_Find does
+void IMG_Prefetch(const char *name, imagetype_t type, imageflags_t flags)
+{
+    char    buffer[MAX_QPATH];
+    size_t  len;
+
+    if (!r_numImages)
+        return;
+
+    len = FS_NormalizePathBuffer(buffer, name, sizeof(buffer));
+    prefetch_image(buffer, len, type, flags);
+}
+
+/*
+===============
+R_PrefetchImage
+===============
+*/
+void R_PrefetchImage(const char *name, imagetype_t type, imageflags_t flags)
+{
+    char    fullname[MAX_QPATH];
+    size_t  len;
+
+    Q_assert(name);
+
+    if (!*name || !r_numImages)
+        return;
+
+    len = image_fullname(fullname, name, type);
+    prefetch_image(fullname, len, type, flags);
+}
+
+static void decode_job(void *arg, int index, int thread)
+{
+    prefetch_t *p = (prefetch_t *)arg + index;
+
+    if (!p->data)
+        return;
+
+    // errors will be reported when the image is loaded again by IMG_Find
+    if (img_loaders[p->fmt].load(p->data, p->len, &p->image, &p->pic) < 0)
+        p->pic = NULL;
+}
+
+/*
+===============
+R_FinishPrefetch
+===============
+*/
+void R_FinishPrefetch(void)
+{
+    prefetch_t      *p;
+    imageformat_t   fmt;
+    uint64_t        start, mid;
+    int             i, count;
+
+    count = img_prefetch.count - img_prefetch.pending;
+    if (count < 1)
+        return;
+
+    start = Sys_Microseconds();
+
+    // filesystem is not thread safe, read files serially
+    p = img_prefetch.items + img_prefetch.pending;
+    for (i = 0; i < count; i++, p++) {
+        for (fmt = 0; fmt < IM_MAX; fmt++)
+            if (!Q_stricmp(p->image.name + p->image.baselen + 1, img_loaders[fmt].ext))
+                break;
+
+        img_prefetch.reading = p;
+        load_image_data(&p->image, fmt, false, &p->pic);
+    }
+    img_prefetch.reading = NULL;
+
+    mid = Sys_Microseconds();
+
+    img_threaded = true;
+    Com_ParallelFor(decode_job, img_prefetch.items + img_prefetch.pending, count);
+    img_threaded = false;
+
+    p = img_prefetch.items + img_prefetch.pending;
+    for (i = 0; i < count; i++, p++) {
+        if (p->data) {
+            FS_FreeFile(p->data);
+            p->data = NULL;
+        }
+        if (p->pic)
+            r_regtimes.prefetched++;
+    }
+
+    img_prefetch.pending = img_prefetch.count;
+
+    r_regtimes.read += mid - start;
+    r_regtimes.decode += Sys_Microseconds() - mid;
+}
+
+void IMG_FreePrefetch(void)
+{
+    prefetch_t  *p;
+    int         i;
+
+    for (i = 0, p = img_prefetch.items; i < img_prefetch.count; i++, p++) {
+        Z_Free(p->data);
+        Z_Free(p->pic);
+    }
+
+    Z_Free(img_prefetch.items);
+    memset(&img_prefetch, 0, sizeof(img_prefetch));
+}
+
 /*
 =============
 R_GetPicSize
@@ -2279,6 +2590,7 @@ void IMG_Init(void)
 void IMG_Shutdown(void)
 {
     Cmd_Deregister(img_cmd);
+    IMG_FreePrefetch();
     memset(r_images, 0, R_NUM_AUTO_IMG * sizeof(r_images[0]));   // clear R_NOTEXTURE
     r_numImages = 0;
 }
@@ -29,9 +29,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/error.h"
 #include "refresh/refresh.h"
 
-#define IMG_AllocPixels(x)  FS_AllocTempMem(x)
-#define IMG_FreePixels(x)   FS_FreeTempMem(x)
-
 #define LUMINANCE(r, g, b) ((r) * 0.2126f + (g) * 0.7152f + (b) * 0.0722f)
 
 #define U32_ALPHA   MakeColor(  0,   0,   0, 255)
@@ -67,6 +64,7 @@ typedef struct image_s {
     unsigned        texnum, texnum2; // gl texture binding
     float           sl, sh, tl, th;
     float           aspect;
+    uint64_t        cache_key; // processed texture cache key
 } image_t;
 
 #define MAX_RIMAGES     8192
@@ -95,6 +93,27 @@ image_t *IMG_ForHandle(qhandle_t h);
 void IMG_Unload(image_t *image);
 void IMG_Load(image_t *image, byte *pic);
 
+bool IMG_UseCache(const image_t *image);
+bool IMG_LoadCached(image_t *image, const void *data, size_t len);
+void IMG_PrintCacheStats(void);
+
+void IMG_Prefetch(const char *name, imagetype_t type, imageflags_t flags);
+void IMG_FreePrefetch(void);
+
+// map load timing breakdown, in microseconds
+typedef struct {
+    uint64_t    start;
+    uint64_t    world;      // excluding images
+    uint64_t    read;       // reading prefetched image files
+    uint64_t    decode;     // decoding prefetched images in parallel
+    uint64_t    load;       // loading images that were not prefetched
+    uint64_t    upload;     // processing and uploading images
+    int         prefetched;
+    int         uploaded;
+} regtimes_t;
+
+extern regtimes_t r_regtimes;
+
 typedef struct screenshot_s screenshot_t;
 
 typedef int (*save_cb_t)(const screenshot_t *);
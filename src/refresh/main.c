@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
  */
 
 #include "gl.h"
+#include "common/jobs.h"
 
 glRefdef_t glr;
 glStatic_t gl_static;
@@ -58,6 +59,7 @@ cvar_t *gl_shaders;
 cvar_t *gl_md5_load;
 cvar_t *gl_md5_use;
 cvar_t *gl_md5_distance;
+cvar_t *gl_md5_cache;
 #endif
 cvar_t *gl_damageblend_frac;
 cvar_t *gl_waterwarp;
@@ -83,6 +85,8 @@ cvar_t *gl_novbo;
 cvar_t *gl_test;
 #endif
 cvar_t *gl_cull_nodes;
+cvar_t *gl_world_cache;
+cvar_t *gl_stream_ring;
 cvar_t *gl_cull_models;
 cvar_t *gl_clear;
 cvar_t *gl_clearcolor;
@@ -833,6 +837,10 @@ void R_RenderFrame(const refdef_t *fd)
 
     GL_ClassifyEntities();
 
+#if USE_MD5
+    GL_SkinAliasModels();
+#endif
+
     GL_DrawEntities(glr.ents.bmodels);
 
     GL_DrawEntities(glr.ents.opaque);
@@ -1045,6 +1053,11 @@ static void gl_novis_changed(cvar_t *self)
     glr.viewcluster1 = glr.viewcluster2 = -2;
 }
 
+static void gl_world_cache_changed(cvar_t *self)
+{
+    GL_InvalidateWorldCache();
+}
+
 static void gl_swapinterval_changed(cvar_t *self)
 {
     if (vid && vid->swap_interval)
@@ -1103,6 +1116,7 @@ static void GL_Register(void)
     gl_md5_load = Cvar_Get("gl_md5_load", "1", CVAR_FILES);
     gl_md5_use = Cvar_Get("gl_md5_use", "1", 0);
     gl_md5_distance = Cvar_Get("gl_md5_distance", "2048", 0);
+    gl_md5_cache = Cvar_Get("gl_md5_cache", "1", 0);
 #endif
     gl_damageblend_frac = Cvar_Get("gl_damageblend_frac", "0.2", 0);
     gl_waterwarp = Cvar_Get("gl_waterwarp", "0", 0);
@@ -1130,6 +1144,9 @@ static void GL_Register(void)
     gl_test = Cvar_Get("gl_test", "0", 0);
 #endif
     gl_cull_nodes = Cvar_Get("gl_cull_nodes", "1", 0);
+    gl_world_cache = Cvar_Get("gl_world_cache", "0", 0);
+    gl_world_cache->changed = gl_world_cache_changed;
+    gl_stream_ring = Cvar_Get("gl_stream_ring", "1", CVAR_REFRESH);
     gl_cull_models = Cvar_Get("gl_cull_models", "1", 0);
     gl_clear = Cvar_Get("gl_clear", "0", 0);
     gl_clearcolor = Cvar_Get("gl_clearcolor", "black", 0);
@@ -1385,6 +1402,9 @@ void R_Shutdown(bool total)
     GL_DeleteQueries();
     GL_ShutdownImages();
     MOD_Shutdown();
+#if USE_MD5
+    GL_FreeSkeletonPoses();
+#endif
 
     if (!total)
         return;
@@ -1481,7 +1501,30 @@ void R_BeginRegistration(const char *name)
     memset(&glr, 0, sizeof(glr));
     glr.viewcluster1 = glr.viewcluster2 = -2;
 
+    IMG_FreePrefetch();
+    memset(&r_regtimes, 0, sizeof(r_regtimes));
+    r_regtimes.start = Sys_Microseconds();
+
     GL_LoadWorld(name);
+
+    r_regtimes.world = Sys_Microseconds() - r_regtimes.start - r_regtimes.read -
+        r_regtimes.decode - r_regtimes.load - r_regtimes.upload;
+}
+
+static void print_registration_times(void)
+{
+#if USE_DEBUG
+    const regtimes_t *t = &r_regtimes;
+    uint64_t total = Sys_Microseconds() - t->start;
+    uint64_t other = total - t->world - t->read - t->decode - t->load - t->upload;
+
+    Com_DPrintf("Registration took %"PRIu64" ms: world %"PRIu64", image read %"PRIu64
+                ", decode %"PRIu64" (%d images on %d threads), load %"PRIu64
+                ", upload %"PRIu64" (%d images), other %"PRIu64"\n",
+                total / 1000, t->world / 1000, t->read / 1000, t->decode / 1000,
+                t->prefetched, Com_JobThreads(), t->load / 1000, t->upload / 1000,
+                t->uploaded, other / 1000);
+#endif
 }
 
 /*
@@ -1491,10 +1534,18 @@ R_EndRegistration
 */
 void R_EndRegistration(void)
 {
+    IMG_FreePrefetch();
     IMG_FreeUnused();
     MOD_FreeUnused();
     Scrap_Upload();
+    if (gl_backend->precache)
+        gl_backend->precache();
     gl_static.registering = false;
+
+    if (r_regtimes.start) {
+        print_registration_times();
+        r_regtimes.start = 0;
+    }
 }
 
 /*
@@ -17,6 +17,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "gl.h"
+#include "common/cpu.h"
+#include "common/jobs.h"
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
 
 typedef enum {
     SHADOW_NO,
@@ -47,10 +53,6 @@ static drawshadow_t drawshadow;
 static mat4_t       m_shadow_view;
 static mat4_t       m_shadow_model;     // fog hack
 
-#if USE_MD5
-static md5_joint_t  temp_skeleton[MD5_MAX_JOINTS];
-#endif
-
 static void setup_dotshading(void)
 {
     float cp, cy, sp, sy;
@@ -735,12 +737,161 @@ static void draw_alias_mesh(const uint16_t *indices, int num_indices,
 
 #if USE_MD5
 
+/*
+=============================================================================
+
+SKELETON POSES
+
+Entities sharing model, frames and lerp fraction share the same pose, which
+is computed once per render pass. Lerp fraction is quantized so that poses
+can be shared between entities with slightly different fractions. When
+skinning on the CPU, skinned vertices are cached along with the pose, and
+all visible poses are skinned in parallel before drawing entities.
+
+=============================================================================
+*/
+
+#define MAX_SKEL_POSES      64
+#define SKEL_LERP_STEPS     256
+
+// joint with axis stored in columns and scale in pos[3], for SIMD skinning
+typedef struct {
+    vec4_t  axis[3];
+    vec4_t  pos;
+} skelmat_t;
+
+typedef struct {
+    const md5_model_t   *model;
+    unsigned            oldframe, frame, lerp;
+    md5_joint_t         *joints;    // points into model if not lerped
+    skelmat_t           *mats;      // only used with SIMD
+    vec4_t              *verts;     // position, normal pairs for all meshes
+    bool                posed;
+    bool                skinned;
+    bool                queued;
+} skelpose_t;
+
+static struct {
+    skelpose_t  poses[MAX_SKEL_POSES];
+    int         numposes;
+    unsigned    drawframe;
+    byte        *data;
+    size_t      size, used, wanted;
+} skel;
+
+static md5_joint_t  temp_skeleton[MD5_MAX_JOINTS];
+static skelmat_t    temp_mats[MD5_MAX_JOINTS];
+static vec4_t       temp_verts[TESS_MAX_VERTICES * 2];
+
+static void reset_skel_poses(void)
+{
+    if (skel.drawframe == glr.drawframe)
+        return;
+
+    skel.drawframe = glr.drawframe;
+    skel.numposes = 0;
+
+    // grow pose data if it didn't fit last time
+    if (skel.wanted > skel.size) {
+        Z_Free(skel.data);
+        skel.size = Q_ALIGN(skel.wanted, 0x10000);
+        skel.data = R_Malloc(skel.size);
+    }
+
+    skel.used = skel.wanted = 0;
+}
+
+static void *alloc_skel_data(size_t size)
+{
+    void *ptr;
+
+    size = Q_ALIGN(size, 64);
+    skel.wanted += size;
+    if (skel.used + size > skel.size)
+        return NULL;
+
+    ptr = skel.data + skel.used;
+    skel.used += size;
+    return ptr;
+}
+
+static skelpose_t *find_skel_pose(const md5_model_t *model)
+{
+    unsigned frame = newframenum % model->num_frames;
+    unsigned oldframe = oldframenum % model->num_frames;
+    unsigned lerp = Q_rint(backlerp * SKEL_LERP_STEPS);
+    md5_joint_t *joints;
+    skelpose_t *pose;
+    int i;
+
+    if (lerp == SKEL_LERP_STEPS)
+        frame = oldframe;
+    if (lerp == SKEL_LERP_STEPS || frame == oldframe)
+        lerp = 0;
+    if (!lerp)
+        oldframe = frame;
+
+    for (i = 0, pose = skel.poses; i < skel.numposes; i++, pose++)
+        if (pose->model == model && pose->frame == frame &&
+            pose->oldframe == oldframe && pose->lerp == lerp)
+            return pose;
+
+    if (skel.numposes == MAX_SKEL_POSES)
+        return NULL;
+
+    if (lerp) {
+        joints = alloc_skel_data(sizeof(joints[0]) * model->num_joints);
+        if (!joints)
+            return NULL;
+    } else {
+        joints = &model->skeleton_frames[frame * model->num_joints];
+    }
+
+    pose = &skel.poses[skel.numposes++];
+    pose->model = model;
+    pose->frame = frame;
+    pose->oldframe = oldframe;
+    pose->lerp = lerp;
+    pose->joints = joints;
+    pose->mats = NULL;
+    pose->verts = NULL;
+    pose->posed = !lerp;
+    pose->skinned = false;
+    pose->queued = false;
+    return pose;
+}
+
+static int count_skel_verts(const md5_model_t *model)
+{
+    int i, count = 0;
+
+    for (i = 0; i < model->num_meshes; i++)
+        count += model->meshes[i].num_verts;
+
+    return count;
+}
+
+// allocates data needed for CPU skinning
+static bool alloc_skel_verts(skelpose_t *pose)
+{
+    const md5_model_t *model = pose->model;
+
+    if (Com_GetCpuFeatures() & CPU_SSE2) {
+        pose->mats = alloc_skel_data(sizeof(pose->mats[0]) * model->num_joints);
+        if (!pose->mats)
+            return false;
+    }
+
+    pose->verts = alloc_skel_data(sizeof(pose->verts[0]) * 2 * count_skel_verts(model));
+    return pose->verts;
+}
+
 #if (defined __OPTIMIZE__) && (defined __GNUC__) && !(defined __clang__)
 #pragma GCC optimize("O3")
 #endif
 
 // for the given vertex, set of weights & skeleton, calculate
-// the output vertex (and optionally normal).
+// the output vertex and normal.
 static q_forceinline void calc_skel_vert(const md5_vertex_t *vert,
                                          const md5_mesh_t *mesh,
                                          const md5_joint_t *skeleton,
@@ -748,9 +899,7 @@ static q_forceinline void calc_skel_vert(const md5_vertex_t *vert,
                                          float *restrict out_normal)
 {
     VectorClear(out_position);
-
-    if (out_normal)
-        VectorClear(out_normal);
+    VectorClear(out_normal);
 
     for (int i = 0; i < vert->count; i++) {
         const md5_weight_t *weight = &mesh->weights[vert->start + i];
@@ -762,54 +911,87 @@ static q_forceinline void calc_skel_vert(const md5_vertex_t *vert,
         VectorMA(joint->pos, joint->scale, wv, wv);
         VectorMA(out_position, weight->bias, wv, out_position);
 
-        if (out_normal) {
-            VectorRotate(vert->normal, joint->axis, wv);
-            VectorMA(out_normal, weight->bias, wv, out_normal);
-        }
+        VectorRotate(vert->normal, joint->axis, wv);
+        VectorMA(out_normal, weight->bias, wv, out_normal);
     }
 }
 
-static void tess_plain_skel(const md5_mesh_t *mesh, const md5_joint_t *skeleton)
+static void skin_mesh_c(vec4_t *out, const md5_mesh_t *mesh, const md5_joint_t *skeleton)
 {
-    for (int i = 0; i < mesh->num_verts; i++)
-        calc_skel_vert(&mesh->vertices[i], mesh, skeleton, &tess.vertices[i * 4], NULL);
+    for (int i = 0; i < mesh->num_verts; i++, out += 2)
+        calc_skel_vert(&mesh->vertices[i], mesh, skeleton, out[0], out[1]);
 }
 
-static void tess_shade_skel(const md5_mesh_t *mesh, const md5_joint_t *skeleton)
-{
-    vec_t *dst_vert = tess.vertices;
+#if USE_SSE2
 
-    for (int i = 0; i < mesh->num_verts; i++) {
-        vec3_t normal;
-        calc_skel_vert(&mesh->vertices[i], mesh, skeleton, dst_vert, normal);
+static void build_skel_mats(skelmat_t *mats, const md5_joint_t *joints, int count)
+{
+    for (int i = 0; i < count; i++, mats++, joints++) {
+        for (int j = 0; j < 3; j++) {
+            mats->axis[j][0] = joints->axis[0][j];
+            mats->axis[j][1] = joints->axis[1][j];
+            mats->axis[j][2] = joints->axis[2][j];
+            mats->axis[j][3] = 0;
+        }
+        VectorCopy(joints->pos, mats->pos);
+        mats->pos[3] = joints->scale;
+    }
+}
 
-        vec_t d = shadedot(normal);
-        dst_vert[4] = color[0] * d;
-        dst_vert[5] = color[1] * d;
-        dst_vert[6] = color[2] * d;
-        dst_vert[7] = color[3];
+// same math as calc_skel_vert, but with all 3 components at once
+static void skin_mesh_sse2(vec4_t *out, const md5_mesh_t *mesh, const skelmat_t *mats)
+{
+    for (int i = 0; i < mesh->num_verts; i++, out += 2) {
+        const md5_vertex_t *vert = &mesh->vertices[i];
+        const __m128 nx = _mm_set1_ps(vert->normal[0]);
+        const __m128 ny = _mm_set1_ps(vert->normal[1]);
+        const __m128 nz = _mm_set1_ps(vert->normal[2]);
+        __m128 pos = _mm_setzero_ps();
+        __m128 norm = _mm_setzero_ps();
+
+        for (int j = vert->start; j < vert->start + vert->count; j++) {
+            const md5_weight_t *weight = &mesh->weights[j];
+            const skelmat_t *m = &mats[mesh->jointnums[j]];
+            __m128 c0 = _mm_loadu_ps(m->axis[0]);
+            __m128 c1 = _mm_loadu_ps(m->axis[1]);
+            __m128 c2 = _mm_loadu_ps(m->axis[2]);
+            __m128 bias = _mm_set1_ps(weight->bias);
+            __m128 wv;
+
+            wv = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(weight->pos[0])),
+                                       _mm_mul_ps(c1, _mm_set1_ps(weight->pos[1]))),
+                                       _mm_mul_ps(c2, _mm_set1_ps(weight->pos[2])));
+            wv = _mm_add_ps(_mm_loadu_ps(m->pos), _mm_mul_ps(_mm_set1_ps(m->pos[3]), wv));
+            pos = _mm_add_ps(pos, _mm_mul_ps(bias, wv));
+
+            wv = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, nx), _mm_mul_ps(c1, ny)), _mm_mul_ps(c2, nz));
+            norm = _mm_add_ps(norm, _mm_mul_ps(bias, wv));
+        }
 
-        dst_vert += VERTEX_SIZE;
+        _mm_storeu_ps(out[0], pos);
+        _mm_storeu_ps(out[1], norm);
     }
 }
 
-static void tess_shell_skel(const md5_mesh_t *mesh, const md5_joint_t *skeleton)
-{
-    for (int i = 0; i < mesh->num_verts; i++) {
-        vec3_t position, normal;
-        calc_skel_vert(&mesh->vertices[i], mesh, skeleton, position, normal);
+#endif  // USE_SSE2
 
-        VectorMA(position, shellscale, normal, &tess.vertices[i * 4]);
+static void skin_mesh(vec4_t *out, const md5_mesh_t *mesh, const md5_joint_t *skeleton, const skelmat_t *mats)
+{
+#if USE_SSE2
+    if (mats) {
+        skin_mesh_sse2(out, mesh, mats);
+        return;
     }
+#endif
+    skin_mesh_c(out, mesh, skeleton);
 }
 
-static void lerp_alias_skeleton(const md5_model_t *model)
+static void lerp_skeleton(md5_joint_t *out, const md5_model_t *model,
+                          unsigned frame_a, unsigned frame_b, float backlerp)
 {
-    unsigned frame_a = oldframenum % model->num_frames;
-    unsigned frame_b = newframenum % model->num_frames;
     const md5_joint_t *skel_a = &model->skeleton_frames[frame_a * model->num_joints];
     const md5_joint_t *skel_b = &model->skeleton_frames[frame_b * model->num_joints];
-    md5_joint_t *out = temp_skeleton;
+    float frontlerp = 1.0f - backlerp;
 
     for (int i = 0; i < model->num_joints; i++, skel_a++, skel_b++, out++) {
         out->scale = skel_b->scale;
@@ -819,10 +1001,74 @@ static void lerp_alias_skeleton(const md5_model_t *model)
     }
 }
 
+static void pose_skeleton(skelpose_t *pose)
+{
+    if (!pose->posed) {
+        lerp_skeleton(pose->joints, pose->model, pose->oldframe, pose->frame,
+                      pose->lerp * (1.0f / SKEL_LERP_STEPS));
+        pose->posed = true;
+    }
+}
+
+static void skin_skeleton(skelpose_t *pose)
+{
+    const md5_model_t *model = pose->model;
+    vec4_t *out = pose->verts;
+
+#if USE_SSE2
+    if (pose->mats)
+        build_skel_mats(pose->mats, pose->joints, model->num_joints);
+#endif
+
+    for (int i = 0; i < model->num_meshes; i++) {
+        skin_mesh(out, &model->meshes[i], pose->joints, pose->mats);
+        out += model->meshes[i].num_verts * 2;
+    }
+
+    pose->skinned = true;
+}
+
+static void pose_job(void *arg, int index, int thread)
+{
+    skelpose_t *pose = ((skelpose_t **)arg)[index];
+
+    pose_skeleton(pose);
+    if (pose->verts)
+        skin_skeleton(pose);
+}
+
 #if (defined __OPTIMIZE__) && (defined __GNUC__) && !(defined __clang__)
 #pragma GCC reset_options
 #endif
 
+static void tess_plain_skel(const md5_mesh_t *mesh, const vec4_t *verts)
+{
+    for (int i = 0; i < mesh->num_verts; i++)
+        VectorCopy(verts[i * 2], &tess.vertices[i * 4]);
+}
+
+static void tess_shade_skel(const md5_mesh_t *mesh, const vec4_t *verts)
+{
+    vec_t *dst_vert = tess.vertices;
+
+    for (int i = 0; i < mesh->num_verts; i++) {
+        VectorCopy(verts[i * 2], dst_vert);
+
+        vec_t d = shadedot(verts[i * 2 + 1]);
+        dst_vert[4] = color[0] * d;
+        dst_vert[5] = color[1] * d;
+        dst_vert[6] = color[2] * d;
+        dst_vert[7] = color[3];
+
+        dst_vert += VERTEX_SIZE;
+    }
+}
+
+static void tess_shell_skel(const md5_mesh_t *mesh, const vec4_t *verts)
+{
+    for (int i = 0; i < mesh->num_verts; i++)
+        VectorMA(verts[i * 2], shellscale, verts[i * 2 + 1], &tess.vertices[i * 4]);
+}
 static void bind_skel_arrays(const md5_mesh_t *mesh)
 {
     if (gl_config.caps & QGL_CAP_SHADER_STORAGE) {
@@ -853,16 +1099,17 @@ static void bind_skel_arrays(const md5_mesh_t *mesh)
     GL_ArrayBits(GLA_MESH_LERP);
 }
 
-static void draw_skeleton_mesh(const md5_model_t *model, const md5_mesh_t *mesh, const md5_joint_t *skel)
+
+static void draw_skeleton_mesh(const md5_model_t *model, const md5_mesh_t *mesh, const vec4_t *verts)
 {
     if (buffer)
         bind_skel_arrays(mesh);
     else if (glr.ent->flags & RF_SHELL_MASK)
-        tess_shell_skel(mesh, skel);
+        tess_shell_skel(mesh, verts);
     else if (dotshading)
-        tess_shade_skel(mesh, skel);
+        tess_shade_skel(mesh, verts);
     else
-        tess_plain_skel(mesh, skel);
+        tess_plain_skel(mesh, verts);
 
     draw_alias_mesh(mesh->indices, mesh->num_indices,
                     mesh->tcoords, mesh->num_verts,
@@ -871,12 +1118,32 @@ static void draw_skeleton_mesh(const md5_model_t *model, const md5_mesh_t *mesh,
 
 static void draw_alias_skeleton(const md5_model_t *model)
 {
-    const md5_joint_t *skel = temp_skeleton;
+    const md5_joint_t *skel;
+    const vec4_t *verts = NULL;
+    const skelmat_t *mats = NULL;
+    skelpose_t *pose = NULL;
+
+    if (gl_md5_cache->integer) {
+        reset_skel_poses();
+        pose = find_skel_pose(model);
+    }
 
-    if (newframenum == oldframenum)
+    if (pose) {
+        // not seen by GL_SkinAliasModels, pose it now
+        if (!buffer && !pose->queued)
+            alloc_skel_verts(pose);
+        pose_skeleton(pose);
+        if (pose->verts && !pose->skinned)
+            skin_skeleton(pose);
+        skel = pose->joints;
+        verts = pose->verts;
+    } else if (newframenum == oldframenum) {
         skel = &model->skeleton_frames[newframenum % model->num_frames * model->num_joints];
-    else
-        lerp_alias_skeleton(model);
+    } else {
+        lerp_skeleton(temp_skeleton, model, oldframenum % model->num_frames,
+                      newframenum % model->num_frames, backlerp);
+        skel = temp_skeleton;
+    }
 
     if (buffer) {
         glJoint_t joints[MD5_MAX_JOINTS];
@@ -897,10 +1164,28 @@ static void draw_alias_skeleton(const md5_model_t *model)
 
         meshbits &= ~GLS_MESH_MD2;
         meshbits |=  GLS_MESH_MD5 | GLS_MESH_LERP;
+    } else if (!verts) {
+#if USE_SSE2
+        if (Com_GetCpuFeatures() & CPU_SSE2) {
+            build_skel_mats(temp_mats, skel, model->num_joints);
+            mats = temp_mats;
+        }
+#endif
     }
 
-    for (int i = 0; i < model->num_meshes; i++)
-        draw_skeleton_mesh(model, &model->meshes[i], skel);
+    for (int i = 0; i < model->num_meshes; i++) {
+        const md5_mesh_t *mesh = &model->meshes[i];
+
+        if (buffer) {
+            draw_skeleton_mesh(model, mesh, NULL);
+        } else if (verts) {
+            draw_skeleton_mesh(model, mesh, verts);
+            verts += mesh->num_verts * 2;
+        } else {
+            skin_mesh(temp_verts, mesh, skel, mats);
+            draw_skeleton_mesh(model, mesh, temp_verts);
+        }
+    }
 }
 
 #endif  // USE_MD5
@@ -937,11 +1222,9 @@ static void setup_weaponmodel(void)
     GL_Frustum(fov_x, fov_y, reflect_x);
 }
 
-void GL_DrawAliasModel(const model_t *model)
+static void setup_frames(const model_t *model, bool verbose)
 {
     const entity_t *ent = glr.ent;
-    glCullResult_t cull;
-    void (*tessfunc)(const maliasmesh_t *);
 
     if (glr.fd.extended) {
         newframenum = ent->frame % model->numframes;
@@ -949,13 +1232,15 @@ void GL_DrawAliasModel(const model_t *model)
     } else {
         newframenum = ent->frame;
         if (newframenum >= model->numframes) {
-            Com_DPrintf("%s: no such frame: %u\n", __func__, newframenum);
+            if (verbose)
+                Com_DPrintf("GL_DrawAliasModel: no such frame: %u\n", newframenum);
             newframenum = 0;
         }
 
         oldframenum = ent->oldframe;
         if (oldframenum >= model->numframes) {
-            Com_DPrintf("%s: no such oldframe: %u\n", __func__, oldframenum);
+            if (verbose)
+                Com_DPrintf("GL_DrawAliasModel: no such oldframe: %u\n", oldframenum);
             oldframenum = 0;
         }
     }
@@ -968,6 +1253,24 @@ void GL_DrawAliasModel(const model_t *model)
         oldframenum = newframenum;
 
     VectorCopy(ent->origin, origin);
+}
+
+#if USE_MD5
+static bool use_skeleton(const model_t *model)
+{
+    return model->skeleton && gl_md5_use->integer &&
+        (glr.ent->flags & RF_NO_LOD || gl_md5_distance->value <= 0 ||
+         Distance(origin, glr.fd.vieworg) <= gl_md5_distance->value);
+}
+#endif
+
+void GL_DrawAliasModel(const model_t *model)
+{
+    const entity_t *ent = glr.ent;
+    glCullResult_t cull;
+    void (*tessfunc)(const maliasmesh_t *);
+
+    setup_frames(model, true);
 
     // cull the shadow
     drawshadow = cull_shadow(model);
@@ -1051,9 +1354,7 @@ void GL_DrawAliasModel(const model_t *model)
 
     // draw all the meshes
 #if USE_MD5
-    if (model->skeleton && gl_md5_use->integer &&
-        (ent->flags & RF_NO_LOD || gl_md5_distance->value <= 0 ||
-         Distance(origin, glr.fd.vieworg) <= gl_md5_distance->value))
+    if (use_skeleton(model))
         draw_alias_skeleton(model->skeleton);
     else
 #endif
@@ -1073,3 +1374,79 @@ void GL_DrawAliasModel(const model_t *model)
         qglFrontFace(GL_CW);
     }
 }
+
+#if USE_MD5
+
+static void skin_alias_models(entity_t *ent, skelpose_t **pending, int *count)
+{
+    const model_t *model;
+    skelpose_t *pose;
+
+    for (; ent; ent = ent->next) {
+        model = MOD_ForHandle(ent->model);
+        if (!model || model->type != MOD_ALIAS || !model->skeleton)
+            continue;
+
+        glr.ent = ent;
+        setup_frames(model, false);
+        if (!use_skeleton(model))
+            continue;
+
+        // skip models that are surely culled out. if they cast shadows, they
+        // will still be posed on demand.
+        if (!(ent->flags & RF_WEAPONMODEL)) {
+            float radius = max(model->frames[newframenum].radius,
+                               model->frames[oldframenum].radius);
+            GL_SetEntityAxis();
+            if (GL_CullSphere(origin, radius) == CULL_OUT)
+                continue;
+        }
+
+        pose = find_skel_pose(model->skeleton);
+        if (!pose || pose->queued)
+            continue;
+
+        pose->queued = true;
+        if (!gl_static.use_gpu_lerp)
+            alloc_skel_verts(pose);
+        if (pose->posed && !pose->verts)
+            continue;
+
+        pending[(*count)++] = pose;
+    }
+}
+
+/*
+=================
+GL_SkinAliasModels
+
+Computes skeleton poses (and skinned vertices, if not skinning on the GPU)
+for all visible MD5 models in parallel, before entities are drawn.
+=================
+*/
+void GL_SkinAliasModels(void)
+{
+    skelpose_t *pending[MAX_SKEL_POSES];
+    int count = 0;
+
+    if (!gl_md5_use->integer || !gl_md5_cache->integer)
+        return;
+
+    reset_skel_poses();
+
+    skin_alias_models(glr.ents.opaque, pending, &count);
+    skin_alias_models(glr.ents.alpha_back, pending, &count);
+    skin_alias_models(glr.ents.alpha_front, pending, &count);
+
+    glr.ent = NULL;
+
+    Com_ParallelFor(pose_job, pending, count);
+}
+
+void GL_FreeSkeletonPoses(void)
+{
+    Z_Freep(&skel.data);
+    memset(&skel, 0, sizeof(skel));
+}
+
+#endif  // USE_MD5
@@ -364,6 +364,20 @@ static const glsection_t sections[] = {
         }
     },
 
+    // GL 4.1, ES 3.0
+    // ARB_get_program_binary
+    {
+        .extension = "GL_ARB_get_program_binary",
+        .ver_gl = QGL_VER(4, 1),
+        .ver_es = QGL_VER(3, 0),
+        .functions = (const glfunction_t []) {
+            QGL_FN(GetProgramBinary),
+            QGL_FN(ProgramBinary),
+            QGL_FN(ProgramParameteri),
+            { NULL }
+        }
+    },
+
     // GL 4.3
     // KHR_debug
     {
@@ -386,12 +400,36 @@ static const glsection_t sections[] = {
         .caps = QGL_CAP_SHADER_STORAGE,
     },
 
+    // GL 4.3
+    // ARB_multi_draw_indirect
+    {
+        .extension = "GL_ARB_multi_draw_indirect",
+        .ver_gl = QGL_VER(4, 3),
+        .functions = (const glfunction_t []) {
+            QGL_FN(MultiDrawElementsIndirect),
+            { NULL }
+        }
+    },
+
     // GL 4.4
     {
         .ver_gl = QGL_VER(4, 4),
         .caps = QGL_CAP_QUERY_RESULT_NO_WAIT,
     },
 
+    // GL 4.4
+    // ARB_buffer_storage
+    {
+        .ver_gl = QGL_VER(4, 4),
+        .extension = "GL_ARB_buffer_storage",
+        .functions = (const glfunction_t []) {
+            QGL_FN(BufferStorage),
+            QGL_FN(MapBufferRange),
+            QGL_FN(UnmapBuffer),
+            { NULL }
+        }
+    },
+
     // GL 4.4
     // ARB_multi_bind
     {
@@ -178,12 +178,21 @@ QGLAPI GLsync (APIENTRYP qglFenceSync)(GLenum condition, GLbitfield flags);
 QGLAPI void (APIENTRYP qglClearDepthf)(GLfloat d);
 QGLAPI void (APIENTRYP qglDepthRangef)(GLfloat n, GLfloat f);
 
+// GL 4.1, ES 3.0
+QGLAPI void (APIENTRYP qglGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+QGLAPI void (APIENTRYP qglProgramBinary)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+QGLAPI void (APIENTRYP qglProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
 // GL 4.3
 QGLAPI void (APIENTRYP qglDebugMessageCallback)(GLDEBUGPROC callback, const void *userParam);
 QGLAPI void (APIENTRYP qglDebugMessageControl)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled);
+QGLAPI void (APIENTRYP qglMultiDrawElementsIndirect)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
 
 // GL 4.4
 QGLAPI void (APIENTRYP qglBindTextures)(GLuint first, GLsizei count, const GLuint *textures);
+QGLAPI void (APIENTRYP qglBufferStorage)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+QGLAPI void *(APIENTRYP qglMapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+QGLAPI GLboolean (APIENTRYP qglUnmapBuffer)(GLenum target);
 
 // GL 4.5
 QGLAPI void (APIENTRYP qglBindTextureUnit)(GLuint unit, GLuint texture);
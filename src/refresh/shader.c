@@ -710,10 +710,228 @@ static void bind_texture_unit(GLuint program, const char *name, GLuint tmu)
     qglUniform1i(loc, tmu);
 }
 
+/*
+=============================================================================
+
+PROGRAM CACHE
+
+Linked program binaries are stored in `shadercache' directory, keyed by hash
+of the generated GLSL source and the driver strings. List of state bits of
+all programs used so far is stored per driver, and these programs are
+created ahead of time when a map is loaded.
+
+=============================================================================
+*/
+
+#define PRGCACHE_IDENT      MakeLittleLong('Q','P','R','G')
+#define PRGCACHE_VERSION    1
+
+#define MAX_KNOWN_PROGRAMS  1024
+
+typedef struct {
+    uint32_t    ident;
+    uint32_t    version;
+    uint64_t    key;
+    uint32_t    format;
+    uint32_t    size;
+} prgcache_header_t;
+
+static struct {
+    bool            enabled;
+    bool            dirty;          // list of known programs needs saving
+    uint64_t        driver;         // hash of driver strings
+    int             numknown;
+    glStateBits_t   known[MAX_KNOWN_PROGRAMS];
+    unsigned        hits;
+    unsigned        misses;
+} prgcache;
+
+static cvar_t *gl_shader_cache;
+
+static uint64_t hash_string(uint64_t hash, const char *s)
+{
+    return GL_HashBytes(hash, s, strlen(s) + 1);
+}
+
+static uint64_t program_cache_key(glStateBits_t bits, const sizebuf_t *vert, const sizebuf_t *frag)
+{
+    uint64_t hash = prgcache.driver;
+
+    hash = GL_HashBytes(hash, &bits, sizeof(bits));
+    hash = GL_HashBytes(hash, vert->data, vert->cursize);
+    hash = GL_HashBytes(hash, frag->data, frag->cursize);
+
+    return hash;
+}
+
+static bool load_program_binary(GLuint program, uint64_t key)
+{
+    char                path[MAX_QPATH];
+    const prgcache_header_t *hdr;
+    void                *buf;
+    GLint               status = 0;
+    int                 ret;
+
+    Q_snprintf(path, sizeof(path), "shadercache/%016"PRIx64".bin", key);
+    ret = FS_LoadFileEx(path, &buf, FS_TYPE_REAL, TAG_FILESYSTEM);
+    if (!buf)
+        return false;
+
+    hdr = buf;
+    if (ret < sizeof(*hdr) || hdr->ident != PRGCACHE_IDENT ||
+        hdr->version != PRGCACHE_VERSION || hdr->key != key ||
+        hdr->size != ret - sizeof(*hdr)) {
+        Com_DPrintf("Ignoring bad program cache entry %s\n", path);
+        FS_FreeFile(buf);
+        return false;
+    }
+
+    // driver may reject the binary, e.g. after update
+    qglProgramBinary(program, hdr->format, hdr + 1, hdr->size);
+    qglGetProgramiv(program, GL_LINK_STATUS, &status);
+    FS_FreeFile(buf);
+
+    if (!status) {
+        Com_DPrintf("Program binary %s rejected by driver\n", path);
+        return false;
+    }
+
+    prgcache.hits++;
+    return true;
+}
+
+static void store_program_binary(GLuint program, uint64_t key)
+{
+    char                path[MAX_QPATH];
+    prgcache_header_t   *hdr;
+    GLint               size = 0;
+    GLsizei             length = 0;
+    GLenum              format = 0;
+    int                 ret;
+
+    qglGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0)
+        return;
+
+    hdr = FS_AllocTempMem(sizeof(*hdr) + size);
+    qglGetProgramBinary(program, size, &length, &format, hdr + 1);
+
+    if (length > 0 && length <= size) {
+        hdr->ident = PRGCACHE_IDENT;
+        hdr->version = PRGCACHE_VERSION;
+        hdr->key = key;
+        hdr->format = format;
+        hdr->size = length;
+
+        Q_snprintf(path, sizeof(path), "shadercache/%016"PRIx64".bin", key);
+        ret = FS_WriteFile(path, hdr, sizeof(*hdr) + length);
+        if (ret < 0)
+            Com_DPrintf("Couldn't write %s: %s\n", path, Q_ErrorString(ret));
+    }
+
+    FS_FreeTempMem(hdr);
+}
+
+static void add_known_program(glStateBits_t bits)
+{
+    int i;
+
+    if (!prgcache.enabled)
+        return;
+
+    for (i = 0; i < prgcache.numknown; i++)
+        if (prgcache.known[i] == bits)
+            return;
+
+    if (prgcache.numknown < MAX_KNOWN_PROGRAMS) {
+        prgcache.known[prgcache.numknown++] = bits;
+        prgcache.dirty = true;
+    }
+}
+
+static void load_known_programs(void)
+{
+    char        path[MAX_QPATH];
+    uint32_t    *buf;
+    int         ret, count;
+
+    Q_snprintf(path, sizeof(path), "shadercache/%016"PRIx64".lst", prgcache.driver);
+    ret = FS_LoadFileEx(path, (void **)&buf, FS_TYPE_REAL, TAG_FILESYSTEM);
+    if (!buf)
+        return;
+
+    if (ret >= 8 && buf[0] == PRGCACHE_IDENT && buf[1] == PRGCACHE_VERSION) {
+        count = min((ret - 8) / sizeof(glStateBits_t), MAX_KNOWN_PROGRAMS);
+        memcpy(prgcache.known, buf + 2, count * sizeof(glStateBits_t));
+        prgcache.numknown = count;
+    } else {
+        Com_DPrintf("Ignoring bad program list %s\n", path);
+    }
+
+    FS_FreeFile(buf);
+}
+
+static void save_known_programs(void)
+{
+    char        path[MAX_QPATH];
+    uint32_t    *buf;
+    size_t      size;
+    int         ret;
+
+    if (!prgcache.dirty)
+        return;
+
+    size = 8 + prgcache.numknown * sizeof(glStateBits_t);
+    buf = FS_AllocTempMem(size);
+    buf[0] = PRGCACHE_IDENT;
+    buf[1] = PRGCACHE_VERSION;
+    memcpy(buf + 2, prgcache.known, prgcache.numknown * sizeof(glStateBits_t));
+
+    Q_snprintf(path, sizeof(path), "shadercache/%016"PRIx64".lst", prgcache.driver);
+    ret = FS_WriteFile(path, buf, size);
+    if (ret < 0)
+        Com_DPrintf("Couldn't write %s: %s\n", path, Q_ErrorString(ret));
+
+    FS_FreeTempMem(buf);
+    prgcache.dirty = false;
+}
+
+static void init_program_cache(void)
+{
+    GLint formats = 0;
+    uint64_t hash;
+
+    memset(&prgcache, 0, sizeof(prgcache));
+
+    if (!gl_shader_cache->integer || !qglProgramBinary)
+        return;
+
+    // some drivers expose the API, but don't support any formats
+    qglGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats < 1) {
+        Com_DPrintf("Program binaries not supported\n");
+        return;
+    }
+
+    hash = UINT64_C(0xcbf29ce484222325);
+    hash = hash_string(hash, com_version_string);
+    hash = hash_string(hash, (const char *)qglGetString(GL_VENDOR));
+    hash = hash_string(hash, (const char *)qglGetString(GL_RENDERER));
+    hash = hash_string(hash, (const char *)qglGetString(GL_VERSION));
+    hash = GL_HashBytes(hash, &gl_config.caps, sizeof(gl_config.caps));
+
+    prgcache.driver = hash;
+    prgcache.enabled = true;
+
+    load_known_programs();
+}
+
 static GLuint create_and_use_program(glStateBits_t bits)
 {
-    char buffer[MAX_SHADER_CHARS];
-    sizebuf_t sb;
+    char buffer_v[MAX_SHADER_CHARS];
+    char buffer_f[MAX_SHADER_CHARS];
+    sizebuf_t sb_v, sb_f;
+    uint64_t key = 0;
 
     GLuint program = qglCreateProgram();
     if (!program) {
@@ -721,15 +939,25 @@ static GLuint create_and_use_program(glStateBits_t bits)
         return 0;
     }
 
-    SZ_Init(&sb, buffer, sizeof(buffer), "GLSL");
-    write_vertex_shader(&sb, bits);
-    GLuint shader_v = create_shader(GL_VERTEX_SHADER, &sb);
+    SZ_Init(&sb_v, buffer_v, sizeof(buffer_v), "GLSL");
+    write_vertex_shader(&sb_v, bits);
+
+    SZ_Init(&sb_f, buffer_f, sizeof(buffer_f), "GLSL");
+    write_fragment_shader(&sb_f, bits);
+
+    if (prgcache.enabled) {
+        key = program_cache_key(bits, &sb_v, &sb_f);
+        if (load_program_binary(program, key))
+            goto linked;
+        prgcache.misses++;
+        qglProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    GLuint shader_v = create_shader(GL_VERTEX_SHADER, &sb_v);
     if (!shader_v)
         goto fail;
 
-    SZ_Clear(&sb);
-    write_fragment_shader(&sb, bits);
-    GLuint shader_f = create_shader(GL_FRAGMENT_SHADER, &sb);
+    GLuint shader_f = create_shader(GL_FRAGMENT_SHADER, &sb_f);
     if (!shader_f) {
         qglDeleteShader(shader_v);
         goto fail;
@@ -785,6 +1013,10 @@ static GLuint create_and_use_program(glStateBits_t bits)
         goto fail;
     }
 
+    if (key)
+        store_program_binary(program, key);
+
+linked:
     if (!bind_uniform_block(program, "Uniforms", sizeof(gls.u_block), UBO_UNIFORMS))
         goto fail;
 
@@ -834,7 +1066,44 @@ static void shader_use_program(glStateBits_t key)
     } else {
         GLuint val = create_and_use_program(key);
         HashMap_Insert(gl_static.programs, &key, &val);
+        if (val)
+            add_known_program(key);
+    }
+}
+
+// creates programs for all state bits seen before with this driver, so that
+// they don't have to be compiled when first used mid-game
+static void shader_precache(void)
+{
+#if USE_DEBUG
+    uint64_t start = Sys_Microseconds();
+#endif
+    int i, count = 0;
+
+    if (!prgcache.enabled || !prgcache.numknown)
+        return;
+
+    for (i = 0; i < prgcache.numknown; i++) {
+        glStateBits_t key = prgcache.known[i];
+
+        // these depend on current bloom sigma and get rebuilt anyway
+        if (key & GLS_BLUR_GAUSS)
+            continue;
+        if (HashMap_Lookup(GLuint, gl_static.programs, &key))
+            continue;
+
+        GLuint val = create_and_use_program(key);
+        HashMap_Insert(gl_static.programs, &key, &val);
+        count++;
     }
+
+    if (count)
+        shader_use_program(gls.state_bits & GLS_SHADER_MASK);
+
+#if USE_DEBUG
+    Com_DPrintf("Precached %d programs in %"PRIu64" ms (%u cache hits, %u misses)\n",
+                count, (Sys_Microseconds() - start) / 1000, prgcache.hits, prgcache.misses);
+#endif
 }
 
 static void shader_state_bits(glStateBits_t bits)
@@ -1038,8 +1307,12 @@ static void shader_init(void)
     gl_bloom_sigma = Cvar_Get("gl_bloom_sigma", "4", 0);
     gl_bloom_sigma->changed = gl_bloom_sigma_changed;
 
+    gl_shader_cache = Cvar_Get("gl_shader_cache", "1", 0);
+
     gl_static.programs = HashMap_TagCreate(glStateBits_t, GLuint, HashInt64, NULL, TAG_RENDERER);
 
+    init_program_cache();
+
     qglGenBuffers(1, &gl_static.uniform_buffer);
     GL_BindBufferBase(GL_UNIFORM_BUFFER, UBO_UNIFORMS, gl_static.uniform_buffer);
     qglBufferData(GL_UNIFORM_BUFFER, sizeof(gls.u_block), NULL, GL_DYNAMIC_DRAW);
@@ -1066,6 +1339,9 @@ static void shader_shutdown(void)
     gl_static.bloom_sigma = 0;
     gl_bloom_sigma->changed = NULL;
 
+    if (prgcache.enabled)
+        save_known_programs();
+
     if (gl_static.programs) {
         uint32_t map_size = HashMap_Size(gl_static.programs);
         for (int i = 0; i < map_size; i++) {
@@ -1108,6 +1384,7 @@ const glbackend_t backend_shader = {
     .load_matrix = shader_load_matrix,
     .load_uniforms = shader_load_uniforms,
     .update_blur = shader_update_blur,
+    .precache = shader_precache,
 
     .state_bits = shader_state_bits,
     .array_bits = shader_array_bits,
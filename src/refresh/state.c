@@ -385,6 +385,8 @@ void GL_ClearState(void)
     if (qglBindBuffer) {
         qglBindBuffer(GL_ARRAY_BUFFER, 0);
         qglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        if (qglMultiDrawElementsIndirect)
+            qglBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
     }
 
     gl_backend->clear_state();
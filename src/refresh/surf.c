@@ -21,8 +21,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
  *
  */
 #include "gl.h"
+#include "common/cpu.h"
+#include "common/intreadwrite.h"
+#include "common/jobs.h"
 #include "common/mdfour.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
 lightmap_builder_t lm;
 static byte lm_buffer[0x4000000];
 
@@ -98,13 +105,72 @@ DYNAMIC BLOCKLIGHTS
 
 #define LM_PIXELS(map, s, t)    ((map)->buffer + ((t) << lm.block_shift) + ((s) << 2))
 
-static float blocklights[MAX_BLOCKLIGHTS * 3];
+// don't bother with job threads for fewer surfaces
+#define LM_MIN_PARALLEL         8
+
+// one extra float for SIMD loads of the last texel
+static float blocklights[MAX_BLOCKLIGHTS * 3 + 1];
+
+// dynamic surfaces are collected while traversing the world and updated
+// in parallel before upload. each job thread uses its own blocklights.
+static struct {
+    mface_t     **surfaces;
+    int         numsurfaces, maxsurfaces;
+    int         maxtexels;
+    float       *blocklights[MAX_JOB_THREADS];
+    int         blocksize[MAX_JOB_THREADS];
+} lm_dirty;
+
+#if USE_SSE2
+static void put_blocklights_sse2(const float *bl, byte *out, int smax, int tmax,
+                                 int stride, float add, float modulate, float scale)
+{
+    const __m128 vadd = _mm_set1_ps(add);
+    const __m128 vmod = _mm_set1_ps(modulate);
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 v255 = _mm_set1_ps(255);
+    const __m128 lum = _mm_setr_ps(0.2126f, 0.7152f, 0.0722f, 0);
+    const __m128 zero = _mm_setzero_ps();
+    int i, j;
+
+    // same operations in the same order as adjust_color_f()
+    for (i = 0; i < tmax; i++, out += stride) {
+        byte *dst = out;
+        for (j = 0; j < smax; j++, bl += 3, dst += 4) {
+            __m128 v, m, y, mask;
+            __m128i p;
+
+            v = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(bl), vadd), vmod);
+            v = _mm_max_ps(v, zero);
+
+            m = _mm_max_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)),
+                           _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+            m = _mm_max_ps(m, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+            mask = _mm_cmpgt_ps(m, v255);
+            y = _mm_mul_ps(v, _mm_div_ps(v255, m));
+            v = _mm_or_ps(_mm_and_ps(mask, y), _mm_andnot_ps(mask, v));
+
+            if (scale != 1) {
+                y = _mm_mul_ps(v, lum);
+                y = _mm_add_ss(_mm_add_ss(y, _mm_shuffle_ps(y, y, _MM_SHUFFLE(1, 1, 1, 1))),
+                               _mm_shuffle_ps(y, y, _MM_SHUFFLE(2, 2, 2, 2)));
+                y = _mm_shuffle_ps(y, y, _MM_SHUFFLE(0, 0, 0, 0));
+                v = _mm_add_ps(y, _mm_mul_ps(_mm_sub_ps(v, y), vscale));
+            }
+
+            p = _mm_cvttps_epi32(v);
+            p = _mm_packs_epi32(p, p);
+            p = _mm_packus_epi16(p, p);
+            WN32(dst, _mm_cvtsi128_si32(p) | MakeLittleLong(0, 0, 0, 255));
+        }
+    }
+}
+#endif
 
-static void put_blocklights(const mface_t *surf)
+static void put_blocklights(const mface_t *surf, const float *bl)
 {
     float add, modulate, scale = lm.scale;
     int i, j, smax, tmax, stride = 1 << lm.block_shift;
-    const float *bl;
     byte *out;
 
     if (gl_static.use_shaders) {
@@ -120,7 +186,14 @@ static void put_blocklights(const mface_t *surf)
 
     out = LM_PIXELS(surf->light_m, surf->light_s, surf->light_t);
 
-    for (i = 0, bl = blocklights; i < tmax; i++, out += stride) {
+#if USE_SSE2
+    if (Com_GetCpuFeatures() & CPU_SSE2) {
+        put_blocklights_sse2(bl, out, smax, tmax, stride, add, modulate, scale);
+        return;
+    }
+#endif
+
+    for (i = 0; i < tmax; i++, out += stride) {
         byte *dst;
         for (j = 0, dst = out; j < smax; j++, bl += 3, dst += 4) {
             vec3_t tmp;
@@ -133,7 +206,7 @@ static void put_blocklights(const mface_t *surf)
     }
 }
 
-static void add_dynamic_lights(const mface_t *surf)
+static void add_dynamic_lights(const mface_t *surf, float *blocklights)
 {
     const dlight_t  *light;
     vec3_t          point;
@@ -190,61 +263,73 @@ static void add_dynamic_lights(const mface_t *surf)
     }
 }
 
-static void add_light_styles(mface_t *surf)
+static void add_light_styles(mface_t *surf, float *blocklights)
 {
     const lightstyle_t *style;
     const byte *src;
-    float *bl;
-    int i, j, size = surf->lm_width * surf->lm_height;
+    float white;
+    int i, j, size = surf->lm_width * surf->lm_height * 3;
 
     if (!surf->numstyles) {
         // should this ever happen?
-        memset(blocklights, 0, sizeof(blocklights[0]) * size * 3);
+        memset(blocklights, 0, sizeof(blocklights[0]) * size);
         return;
     }
 
     // init primary lightmap
     style = LIGHT_STYLE(surf->styles[0]);
+    white = style->white;
 
+    // flat loops over color components vectorize well
     src = surf->lightmap;
-    bl = blocklights;
-    if (style->white == 1) {
-        for (j = 0; j < size; j++, bl += 3, src += 3)
-            VectorCopy(src, bl);
+    if (white == 1) {
+        for (j = 0; j < size; j++)
+            blocklights[j] = src[j];
     } else {
-        for (j = 0; j < size; j++, bl += 3, src += 3)
-            VectorScale(src, style->white, bl);
+        for (j = 0; j < size; j++)
+            blocklights[j] = src[j] * white;
     }
 
-    surf->stylecache[0] = style->white;
+    surf->stylecache[0] = white;
 
     // add remaining lightmaps
     for (i = 1; i < surf->numstyles; i++) {
         style = LIGHT_STYLE(surf->styles[i]);
+        white = style->white;
 
-        bl = blocklights;
-        for (j = 0; j < size; j++, bl += 3, src += 3)
-            VectorMA(bl, style->white, src, bl);
+        src += size;
+        for (j = 0; j < size; j++)
+            blocklights[j] += src[j] * white;
 
-        surf->stylecache[i] = style->white;
+        surf->stylecache[i] = white;
     }
 }
 
-static void update_dynamic_lightmap(mface_t *surf)
+static void update_dynamic_lightmap(mface_t *surf, float *blocklights)
 {
-    int s0, t0, s1, t1;
-
     // add all the lightmaps
-    add_light_styles(surf);
+    add_light_styles(surf, blocklights);
 
     // add all the dynamic lights
     if (surf->dlightframe == glr.dlightframe)
-        add_dynamic_lights(surf);
+        add_dynamic_lights(surf, blocklights);
     else
         surf->dlightframe = 0;
 
     // put into texture format
-    put_blocklights(surf);
+    put_blocklights(surf, blocklights);
+}
+
+static void queue_dynamic_lightmap(mface_t *surf)
+{
+    int s0, t0, s1, t1;
+
+    if (lm_dirty.numsurfaces == lm_dirty.maxsurfaces) {
+        lm_dirty.maxsurfaces = max(lm_dirty.maxsurfaces * 2, 256);
+        lm_dirty.surfaces = Z_Realloc(lm_dirty.surfaces, lm_dirty.maxsurfaces * sizeof(lm_dirty.surfaces[0]));
+    }
+    lm_dirty.surfaces[lm_dirty.numsurfaces++] = surf;
+    lm_dirty.maxtexels = max(lm_dirty.maxtexels, surf->lm_width * surf->lm_height);
 
     // add to dirty region
     s0 = surf->light_s;
@@ -262,7 +347,7 @@ static void update_dynamic_lightmap(mface_t *surf)
     m->maxs[1] = max(m->maxs[1], t1);
 }
 
-// updates lightmaps in RAM
+// marks lightmaps for update in RAM
 void GL_PushLights(mface_t *surf)
 {
     const lightstyle_t *style;
@@ -273,7 +358,7 @@ void GL_PushLights(mface_t *surf)
 
     // dynamic this frame or dynamic previously
     if (surf->dlightframe) {
-        update_dynamic_lightmap(surf);
+        queue_dynamic_lightmap(surf);
         return;
     }
 
@@ -281,12 +366,57 @@ void GL_PushLights(mface_t *surf)
     for (i = 0; i < surf->numstyles; i++) {
         style = LIGHT_STYLE(surf->styles[i]);
         if (style->white != surf->stylecache[i]) {
-            update_dynamic_lightmap(surf);
+            queue_dynamic_lightmap(surf);
             return;
         }
     }
 }
 
+static void update_lightmap_job(void *arg, int index, int thread)
+{
+    update_dynamic_lightmap(lm_dirty.surfaces[index], lm_dirty.blocklights[thread]);
+}
+
+// updates queued lightmaps in RAM, possibly in parallel
+static void update_dirty_lightmaps(void)
+{
+    int i, threads, size;
+
+    if (!lm_dirty.numsurfaces)
+        return;
+
+    threads = 1;
+    if (lm_dirty.numsurfaces >= LM_MIN_PARALLEL)
+        threads = Com_JobThreads();
+
+    if (threads > 1) {
+        size = lm_dirty.maxtexels * 3 + 1;
+        lm_dirty.blocklights[0] = blocklights;
+        for (i = 1; i < threads; i++) {
+            if (lm_dirty.blocksize[i] >= size)
+                continue;
+            Z_Free(lm_dirty.blocklights[i]);
+            lm_dirty.blocklights[i] = R_Malloc(size * sizeof(float));
+            lm_dirty.blocksize[i] = size;
+        }
+        Com_ParallelFor(update_lightmap_job, NULL, lm_dirty.numsurfaces);
+    } else {
+        for (i = 0; i < lm_dirty.numsurfaces; i++)
+            update_dynamic_lightmap(lm_dirty.surfaces[i], blocklights);
+    }
+
+    lm_dirty.numsurfaces = 0;
+    lm_dirty.maxtexels = 0;
+}
+
+static void free_dirty_lightmaps(void)
+{
+    for (int i = 1; i < MAX_JOB_THREADS; i++)
+        Z_Free(lm_dirty.blocklights[i]);
+    Z_Free(lm_dirty.surfaces);
+    memset(&lm_dirty, 0, sizeof(lm_dirty));
+}
+
 static void clear_dirty_region(lightmap_t *m)
 {
     m->mins[0] = lm.block_size;
@@ -302,6 +432,8 @@ void GL_UploadLightmaps(void)
     bool set = false;
     int i;
 
+    update_dirty_lightmaps();
+
     for (i = 0, m = lm.lightmaps; i < lm.nummaps; i++, m++) {
         int x, y, w, h;
 
@@ -455,12 +587,12 @@ static void LM_EndBuilding(void)
 static void build_primary_lightmap(mface_t *surf)
 {
     // add all the lightmaps
-    add_light_styles(surf);
+    add_light_styles(surf, blocklights);
 
     surf->dlightframe = 0;
 
     // put into texture format
-    put_blocklights(surf);
+    put_blocklights(surf, blocklights);
 }
 
 static void LM_BuildSurface(mface_t *surf)
@@ -935,6 +1067,9 @@ static void upload_world_surfaces(void)
     gl_fullbright->modified = false;
     gl_vertexlight->modified = false;
     gl_lightmap_bits->modified = false;
+
+    // lightmaps may have been reassigned
+    GL_InvalidateWorldCache();
 }
 
 static void set_world_size(const mnode_t *node)
@@ -985,7 +1120,11 @@ void GL_FreeWorld(void)
 
     BSP_Free(gl_static.world.cache);
     Z_Free(gl_static.world.vertices);
+    free_dirty_lightmaps();
+    GL_FreeWorldCache();
     GL_DeleteBuffers(1, &gl_static.world.buffer);
+    GL_DeleteBuffers(1, &gl_static.world.index_buffer);
+    GL_DeleteBuffers(1, &gl_static.world.indirect_buffer);
 
     if (gls.currentva == VA_3D)
         gls.currentva = VA_NONE;
@@ -1108,6 +1247,17 @@ void GL_LoadWorld(const char *name)
     // calculate world size for far clip plane and sky box
     set_world_size(bsp->nodes);
 
+    // decode wall textures in parallel
+    for (i = 0, info = bsp->texinfo; i < bsp->numtexinfo; i++, info++) {
+        if (info->c.flags & SURF_SKY)
+            continue;
+        if (info->c.flags & SURF_NODRAW && bsp->has_bspx)
+            continue;
+        Q_concat(buffer, sizeof(buffer), "textures/", info->name, ".wal");
+        IMG_Prefetch(buffer, IT_WALL, (info->c.flags & SURF_WARP) ? IF_TURBULENT : IF_NONE);
+    }
+    R_FinishPrefetch();
+
     // register all texinfo
     for (i = 0, info = bsp->texinfo; i < bsp->numtexinfo; i++, info++) {
         if (info->c.flags & SURF_SKY) {
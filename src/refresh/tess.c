@@ -532,6 +532,115 @@ static const glVaDesc_t arraydescs[VA_TOTAL][VERT_ATTR_COUNT] = {
     },
 };
 
+/*
+=============================================================================
+
+STREAMING RING
+
+Persistently mapped buffer for dynamic vertices and indices. Tesselator data
+is copied straight into GPU visible memory instead of being re-specified
+with glBufferData for each batch, which makes the driver orphan and copy the
+buffer. Ring is split into segments, each protected by a fence that is
+inserted when the segment is left and waited on before it is reused.
+
+=============================================================================
+*/
+
+#define STREAM_SEGMENTS     4
+#define STREAM_SEGMENT_SIZE 0x100000
+
+static struct {
+    GLuint      buffer;
+    byte        *ptr;
+    size_t      cursor;
+    int         segment;
+    GLsync      fences[STREAM_SEGMENTS];
+    unsigned    waits;
+} stream;
+
+static bool GL_InitStream(void)
+{
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = STREAM_SEGMENTS * STREAM_SEGMENT_SIZE;
+
+    if (!gl_stream_ring->integer)
+        return false;
+
+    if (!qglBufferStorage || !qglMapBufferRange || !qglFenceSync)
+        return false;
+
+    GL_ClearErrors();
+
+    qglGenBuffers(1, &stream.buffer);
+    GL_BindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    qglBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+    stream.ptr = qglMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+
+    if (GL_ShowErrors("Failed to create streaming buffer") || !stream.ptr) {
+        GL_BindBuffer(GL_ARRAY_BUFFER, 0);
+        GL_DeleteBuffers(1, &stream.buffer);
+        memset(&stream, 0, sizeof(stream));
+        return false;
+    }
+
+    Com_DPrintf("Using %d KiB persistently mapped streaming buffer\n", (int)(size / 1024));
+    return true;
+}
+
+static void GL_ShutdownStream(void)
+{
+    if (!stream.buffer)
+        return;
+
+    Com_DPrintf("Streaming buffer waited on GPU %u times\n", stream.waits);
+
+    for (int i = 0; i < STREAM_SEGMENTS; i++)
+        if (stream.fences[i])
+            qglDeleteSync(stream.fences[i]);
+
+    GL_BindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    qglUnmapBuffer(GL_ARRAY_BUFFER);
+    GL_DeleteBuffers(1, &stream.buffer);
+
+    memset(&stream, 0, sizeof(stream));
+}
+
+// copies data into the ring and returns offset of the copy in buffer
+static uintptr_t GL_StreamData(const void *data, size_t size)
+{
+    size_t offset;
+
+    Q_assert(size <= STREAM_SEGMENT_SIZE);
+
+    stream.cursor = Q_ALIGN(stream.cursor, 16);
+    if (stream.cursor + size > STREAM_SEGMENT_SIZE) {
+        // fence commands using current segment, then advance to the next one
+        stream.fences[stream.segment] = qglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        stream.segment = (stream.segment + 1) % STREAM_SEGMENTS;
+        stream.cursor = 0;
+
+        // wait until GPU is done reading from it
+        GLsync sync = stream.fences[stream.segment];
+        if (sync) {
+            GLenum ret = qglClientWaitSync(sync, 0, 0);
+            if (ret == GL_TIMEOUT_EXPIRED) {
+                stream.waits++;
+                do {
+                    ret = qglClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+                } while (ret == GL_TIMEOUT_EXPIRED);
+            }
+            qglDeleteSync(sync);
+            stream.fences[stream.segment] = NULL;
+        }
+    }
+
+    offset = stream.segment * STREAM_SEGMENT_SIZE + stream.cursor;
+    memcpy(stream.ptr + offset, data, size);
+    stream.cursor += size;
+
+    return offset;
+}
+
 void GL_BindArrays(glVertexArray_t va)
 {
     if (gls.currentva == va)
@@ -544,6 +653,9 @@ void GL_BindArrays(glVertexArray_t va)
         if (va == VA_3D && !gl_static.world.vertices) {
             buffer = gl_static.world.buffer;
             ptr = NULL;
+        } else if (stream.buffer) {
+            buffer = stream.buffer;
+            ptr = NULL;
         } else if (!(gl_config.caps & QGL_CAP_CLIENT_VA)) {
             buffer = gl_static.vertex_buffer;
             ptr = NULL;
@@ -563,7 +675,12 @@ void GL_LockArrays(GLsizei count)
         return;
     if (gls.currentva == VA_3D && !gl_static.world.vertices)
         return;
-    if (gl_config.caps & QGL_CAP_CLIENT_VA) {
+    if (stream.buffer) {
+        const glVaDesc_t *desc = arraydescs[gls.currentva];
+        uintptr_t offset = GL_StreamData(tess.vertices, count * desc[VERT_ATTR_POS].stride);
+        GL_BindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+        gl_backend->array_pointers(desc, (const GLfloat *)offset);
+    } else if (gl_config.caps & QGL_CAP_CLIENT_VA) {
         if (qglLockArraysEXT)
             qglLockArraysEXT(0, count);
     } else {
@@ -595,7 +712,10 @@ void GL_DrawIndexed(showtris_t showtris)
 
     GL_LockArrays(tess.numverts);
 
-    if (gl_config.caps & QGL_CAP_CLIENT_VA) {
+    if (stream.buffer) {
+        GL_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream.buffer);
+        indices = (const glIndex_t *)GL_StreamData(indices, tess.numindices * sizeof(indices[0]));
+    } else if (gl_config.caps & QGL_CAP_CLIENT_VA) {
         GL_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     } else {
         GL_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl_static.index_buffer);
@@ -622,6 +742,8 @@ void GL_InitArrays(void)
 
     qglGenBuffers(1, &gl_static.index_buffer);
     qglGenBuffers(1, &gl_static.vertex_buffer);
+
+    GL_InitStream();
 }
 
 void GL_ShutdownArrays(void)
@@ -629,19 +751,18 @@ void GL_ShutdownArrays(void)
     if (gl_config.caps & QGL_CAP_CLIENT_VA)
         return;
 
+    GL_ShutdownStream();
+
     qglDeleteVertexArrays(1, &gl_static.array_object);
     qglDeleteBuffers(1, &gl_static.index_buffer);
     qglDeleteBuffers(1, &gl_static.vertex_buffer);
 }
 
-void GL_Flush3D(void)
+static void GL_SetupFaceState(void)
 {
     glStateBits_t state = tess.flags;
     glArrayBits_t array = GLA_VERTEX | GLA_TC;
 
-    if (!tess.numindices)
-        return;
-
     if (q_unlikely(state & GLS_SKY_MASK)) {
         array = GLA_VERTEX;
     } else if (q_likely(tess.texnum[TMU_LIGHTMAP])) {
@@ -689,6 +810,14 @@ void GL_Flush3D(void)
         for (int i = 0; i < MAX_TMUS && tess.texnum[i]; i++)
             GL_BindTexture(i, tess.texnum[i]);
     }
+}
+
+void GL_Flush3D(void)
+{
+    if (!tess.numindices)
+        return;
+
+    GL_SetupFaceState();
 
     GL_DrawIndexed(SHOWTRIS_WORLD);
 
@@ -700,6 +829,67 @@ void GL_Flush3D(void)
     tess.flags = 0;
 }
 
+static void GL_SetupStaticFace(const mface_t *surf)
+{
+    Q_assert(!tess.numindices);
+
+    tess.flags = GL_FaceTexnums(surf, tess.texnum);
+
+    GL_SetupFaceState();
+
+    GL_LoadUniforms();
+
+    GL_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl_static.world.index_buffer);
+
+    memset(tess.texnum, 0, sizeof(tess.texnum));
+    tess.flags = 0;
+}
+
+// draws ranges of static world index buffer using texnums and state of the
+// given face. tesselator must be empty.
+void GL_DrawFaceRanges(const mface_t *surf, const glIndexRange_t *ranges, int numranges)
+{
+    const glIndex_t *indices;
+
+    if (!numranges)
+        return;
+
+    GL_SetupStaticFace(surf);
+
+    for (int i = 0; i < numranges; i++) {
+        indices = (const glIndex_t *)NULL + ranges[i].first;
+
+        qglDrawElements(GL_TRIANGLES, ranges[i].count, QGL_INDEX_TYPE, indices);
+        c.trisDrawn += ranges[i].count / 3;
+        c.batchesDrawn++;
+    }
+
+    // outlines change state and texture, so draw them after all ranges
+    if (gl_showtris->integer & SHOWTRIS_WORLD) {
+        for (int i = 0; i < numranges; i++) {
+            indices = (const glIndex_t *)NULL + ranges[i].first;
+            GL_DrawOutlines(ranges[i].count, QGL_INDEX_TYPE, indices);
+        }
+    }
+}
+
+// same as above, but ranges come from commands in world indirect buffer
+void GL_DrawFaceIndirect(const mface_t *surf, int firstcmd, int numcmds)
+{
+    if (!numcmds)
+        return;
+
+    GL_SetupStaticFace(surf);
+
+    GL_BindBuffer(GL_DRAW_INDIRECT_BUFFER, gl_static.world.indirect_buffer);
+
+    qglMultiDrawElementsIndirect(GL_TRIANGLES, QGL_INDEX_TYPE,
+                                 (const glDrawCommand_t *)NULL + firstcmd,
+                                 numcmds, 0);
+
+    c.batchesDrawn++;
+}
+
 static int GL_CopyVerts(const mface_t *surf)
 {
     int firstvert;
@@ -727,16 +917,13 @@ static const image_t *GL_TextureAnimation(const mtexinfo_t *tex)
     return tex->image;
 }
 
-static void GL_DrawFace(const mface_t *surf)
+// returns state bits and fills in texnums for drawing the given face
+glStateBits_t GL_FaceTexnums(const mface_t *surf, GLuint texnum[MAX_TMUS])
 {
     const image_t *image = GL_TextureAnimation(surf->texinfo);
-    const int numtris = surf->numsurfedges - 2;
-    const int numindices = numtris * 3;
     glStateBits_t state = surf->statebits;
-    GLuint texnum[MAX_TMUS] = { 0 };
-    glIndex_t *dst_indices;
-    int i, j;
 
+    memset(texnum, 0, sizeof(texnum[0]) * MAX_TMUS);
     texnum[TMU_TEXTURE] = image->texnum;
     if (q_likely(surf->light_m)) {
         texnum[TMU_LIGHTMAP] = lm.texnums[surf->light_m - lm.lightmaps];
@@ -755,6 +942,18 @@ static void GL_DrawFace(const mface_t *surf)
         }
     }
 
+    return state;
+}
+
+static void GL_DrawFace(const mface_t *surf)
+{
+    const int numtris = surf->numsurfedges - 2;
+    const int numindices = numtris * 3;
+    GLuint texnum[MAX_TMUS];
+    glStateBits_t state = GL_FaceTexnums(surf, texnum);
+    glIndex_t *dst_indices;
+    int i, j;
+
     if (memcmp(tess.texnum, texnum, sizeof(texnum)) ||
         tess.flags != state ||
         tess.numindices + numindices > TESS_MAX_INDICES)
@@ -18,8 +18,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "gl.h"
+#include "common/cpu.h"
+#include "common/jobs.h"
 #include "common/prompt.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
 static int gl_filter_min;
 static int gl_filter_max;
 static float gl_filter_anisotropy;
@@ -48,6 +54,7 @@ static cvar_t *gl_gamma;
 static cvar_t *gl_invert;
 static cvar_t *gl_partshape;
 static cvar_t *gl_cubemaps;
+static cvar_t *gl_texture_cache;
 
 cvar_t *gl_intensity;
 
@@ -196,63 +203,222 @@ IMAGE PROCESSING
 =========================================================
 */
 
-static void IMG_ResampleTexture(const byte *in, int inwidth, int inheight,
+static void IMG_Resample_C(byte *out, const byte *inrow1, const byte *inrow2,
+                           const unsigned *p1, const unsigned *p2, int outwidth)
+{
+    const byte  *pix1, *pix2, *pix3, *pix4;
+    int         j;
+
+    for (j = 0; j < outwidth; j++) {
+        pix1 = inrow1 + p1[j];
+        pix2 = inrow1 + p2[j];
+        pix3 = inrow2 + p1[j];
+        pix4 = inrow2 + p2[j];
+        out[0] = (pix1[0] + pix2[0] + pix3[0] + pix4[0]) >> 2;
+        out[1] = (pix1[1] + pix2[1] + pix3[1] + pix4[1]) >> 2;
+        out[2] = (pix1[2] + pix2[2] + pix3[2] + pix4[2]) >> 2;
+        out[3] = (pix1[3] + pix2[3] + pix3[3] + pix4[3]) >> 2;
+        out += 4;
+    }
+}
+
+static void IMG_MipMap_C(byte *out, const byte *in, int width, int height)
+{
+    int     i, j;
+
+    width <<= 2;
+    height >>= 1;
+    for (i = 0; i < height; i++, in += width) {
+        for (j = 0; j < width; j += 8, out += 4, in += 8) {
+            out[0] = (in[0] + in[4] + in[width + 0] + in[width + 4]) >> 2;
+            out[1] = (in[1] + in[5] + in[width + 1] + in[width + 5]) >> 2;
+            out[2] = (in[2] + in[6] + in[width + 2] + in[width + 6]) >> 2;
+            out[3] = (in[3] + in[7] + in[width + 3] + in[width + 7]) >> 2;
+        }
+    }
+}
+
+static const imgfuncs_t img_c = {
+    .name = "c",
+    .mipmap = IMG_MipMap_C,
+    .resample = IMG_Resample_C,
+    .hq_pattern = HQ_Pattern_C,
+};
+
+#if USE_SSE2
+
+static inline __m128i load_pixel_sse2(const byte *p)
+{
+    return _mm_cvtsi32_si128(RN32(p));
+}
+
+// averages 2 output pixels per iteration, rounding down like C version
+static void IMG_Resample_SSE2(byte *out, const byte *inrow1, const byte *inrow2,
+                              const unsigned *p1, const unsigned *p2, int outwidth)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int j;
+
+    for (j = 0; j < outwidth - 1; j += 2, out += 8) {
+        __m128i a = _mm_unpacklo_epi32(load_pixel_sse2(inrow1 + p1[j]), load_pixel_sse2(inrow1 + p1[j + 1]));
+        __m128i b = _mm_unpacklo_epi32(load_pixel_sse2(inrow1 + p2[j]), load_pixel_sse2(inrow1 + p2[j + 1]));
+        __m128i c = _mm_unpacklo_epi32(load_pixel_sse2(inrow2 + p1[j]), load_pixel_sse2(inrow2 + p1[j + 1]));
+        __m128i d = _mm_unpacklo_epi32(load_pixel_sse2(inrow2 + p2[j]), load_pixel_sse2(inrow2 + p2[j + 1]));
+        __m128i s;
+
+        s = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        s = _mm_add_epi16(s, _mm_unpacklo_epi8(c, zero));
+        s = _mm_add_epi16(s, _mm_unpacklo_epi8(d, zero));
+        s = _mm_srli_epi16(s, 2);
+        _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(s, s));
+    }
+
+    if (j < outwidth)
+        IMG_Resample_C(out, inrow1, inrow2, p1 + j, p2 + j, 1);
+}
+
+// processes 4 input pixels of 2 rows per iteration. works in place, since
+// output never overtakes input that wasn't read yet.
+static void IMG_MipMap_SSE2(byte *out, const byte *in, int width, int height)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i, j, stride;
+
+    // odd widths are rare and messy
+    if (width & 1) {
+        IMG_MipMap_C(out, in, width, height);
+        return;
+    }
+
+    stride = width << 2;
+    width >>= 1;
+    height >>= 1;
+    for (i = 0; i < height; i++, in += stride) {
+        for (j = 0; j < width - 1; j += 2, out += 8, in += 16) {
+            __m128i r0 = _mm_loadu_si128((const __m128i *)in);
+            __m128i r1 = _mm_loadu_si128((const __m128i *)(in + stride));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+            __m128i s = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+
+            s = _mm_srli_epi16(s, 2);
+            _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(s, s));
+        }
+        if (j < width) {
+            out[0] = (in[0] + in[4] + in[stride + 0] + in[stride + 4]) >> 2;
+            out[1] = (in[1] + in[5] + in[stride + 1] + in[stride + 5]) >> 2;
+            out[2] = (in[2] + in[6] + in[stride + 2] + in[stride + 6]) >> 2;
+            out[3] = (in[3] + in[7] + in[stride + 3] + in[stride + 7]) >> 2;
+            out += 4;
+            in += 8;
+        }
+    }
+}
+
+static const imgfuncs_t img_sse2 = {
+    .name = "sse2",
+    .features = CPU_SSE2,
+    .mipmap = IMG_MipMap_SSE2,
+    .resample = IMG_Resample_SSE2,
+    .hq_pattern = HQ_Pattern_SSE2,
+};
+
+#endif  // USE_SSE2
+
+#if USE_SSE2 && USE_AVX2
+
+// only pattern matching benefits from wider vectors,
+// other kernels are limited by memory bandwidth
+static const imgfuncs_t img_avx2 = {
+    .name = "avx2",
+    .features = CPU_SSE2 | CPU_AVX2,
+    .mipmap = IMG_MipMap_SSE2,
+    .resample = IMG_Resample_SSE2,
+    .hq_pattern = HQ_Pattern_AVX2,
+};
+
+#endif  // USE_SSE2 && USE_AVX2
+
+const imgfuncs_t *const img_funcs[] = {
+#if USE_SSE2 && USE_AVX2
+    &img_avx2,
+#endif
+#if USE_SSE2
+    &img_sse2,
+#endif
+    &img_c,
+    NULL
+};
+
+static const imgfuncs_t *imgfuncs = &img_c;
+
+static const imgfuncs_t *GL_GetImageFuncs(void)
+{
+    unsigned features = Com_GetCpuFeatures();
+
+    for (int i = 0; img_funcs[i]; i++)
+        if ((img_funcs[i]->features & features) == img_funcs[i]->features)
+            return img_funcs[i];
+
+    return &img_c;
+}
+
+typedef struct {
+    const imgfuncs_t    *funcs;
+    const byte          *in;
+    byte                *out;
+    int                 inwidth, outwidth;
+    float               heightScale;
+    unsigned            p1[MAX_TEXTURE_SIZE], p2[MAX_TEXTURE_SIZE];
+} resample_t;
+
+static void resample_row(void *arg, int i, int thread)
+{
+    const resample_t *r = arg;
+    const byte *inrow1 = r->in + r->inwidth * (int)((i + 0.25f) * r->heightScale);
+    const byte *inrow2 = r->in + r->inwidth * (int)((i + 0.75f) * r->heightScale);
+
+    r->funcs->resample(r->out + i * r->outwidth * 4, inrow1, inrow2, r->p1, r->p2, r->outwidth);
+}
+
+static void IMG_ResampleTexture(const imgfuncs_t *funcs, const byte *in, int inwidth, int inheight,
                                 byte *out, int outwidth, int outheight)
 {
-    int         i, j;
-    const byte  *inrow1, *inrow2;
+    int         i;
     unsigned    frac, fracstep;
-    unsigned    p1[MAX_TEXTURE_SIZE], p2[MAX_TEXTURE_SIZE];
-    const byte  *pix1, *pix2, *pix3, *pix4;
-    float       heightScale;
+    resample_t  *r;
 
     Q_assert(outwidth <= MAX_TEXTURE_SIZE);
     fracstep = inwidth * 0x10000 / outwidth;
 
+    r = FS_AllocTempMem(sizeof(*r));
     frac = fracstep >> 2;
     for (i = 0; i < outwidth; i++) {
-        p1[i] = 4 * (frac >> 16);
+        r->p1[i] = 4 * (frac >> 16);
         frac += fracstep;
     }
     frac = 3 * (fracstep >> 2);
     for (i = 0; i < outwidth; i++) {
-        p2[i] = 4 * (frac >> 16);
+        r->p2[i] = 4 * (frac >> 16);
         frac += fracstep;
     }
 
-    heightScale = (float)inheight / outheight;
-    inwidth <<= 2;
-    for (i = 0; i < outheight; i++) {
-        inrow1 = in + inwidth * (int)((i + 0.25f) * heightScale);
-        inrow2 = in + inwidth * (int)((i + 0.75f) * heightScale);
-        for (j = 0; j < outwidth; j++) {
-            pix1 = inrow1 + p1[j];
-            pix2 = inrow1 + p2[j];
-            pix3 = inrow2 + p1[j];
-            pix4 = inrow2 + p2[j];
-            out[0] = (pix1[0] + pix2[0] + pix3[0] + pix4[0]) >> 2;
-            out[1] = (pix1[1] + pix2[1] + pix3[1] + pix4[1]) >> 2;
-            out[2] = (pix1[2] + pix2[2] + pix3[2] + pix4[2]) >> 2;
-            out[3] = (pix1[3] + pix2[3] + pix3[3] + pix4[3]) >> 2;
-            out += 4;
-        }
-    }
+    r->funcs = funcs;
+    r->in = in;
+    r->out = out;
+    r->inwidth = inwidth << 2;
+    r->outwidth = outwidth;
+    r->heightScale = (float)inheight / outheight;
+
+    // output rows are independent, process them in parallel
+    Com_ParallelFor(resample_row, r, outheight);
+
+    FS_FreeTempMem(r);
 }
 
 static void IMG_MipMap(byte *out, const byte *in, int width, int height)
 {
-    int     i, j;
-
-    width <<= 2;
-    height >>= 1;
-    for (i = 0; i < height; i++, in += width) {
-        for (j = 0; j < width; j += 8, out += 4, in += 8) {
-            out[0] = (in[0] + in[4] + in[width + 0] + in[width + 4]) >> 2;
-            out[1] = (in[1] + in[5] + in[width + 1] + in[width + 5]) >> 2;
-            out[2] = (in[2] + in[6] + in[width + 2] + in[width + 6]) >> 2;
-            out[3] = (in[3] + in[7] + in[width + 3] + in[width + 7]) >> 2;
-        }
-    }
+    imgfuncs->mipmap(out, in, width, height);
 }
 
 /*
@@ -457,6 +623,276 @@ static void GL_ClampTextureSize(int *width, int *height)
         *height = 1;
 }
 
+/*
+=========================================================
+
+TEXTURE CACHE
+
+Fully processed mip chains of world textures and skins are
+stored in `texcache' directory, keyed by hash of the source
+file contents and all parameters that affect processing.
+
+=========================================================
+*/
+
+#define TEXCACHE_IDENT      MakeLittleLong('Q','T','E','X')
+#define TEXCACHE_VERSION    2
+
+typedef struct {
+    uint32_t    ident;
+    uint32_t    version;
+    uint64_t    key;
+    uint16_t    width, height;
+    uint16_t    upload_width, upload_height;
+    uint32_t    flags;
+    uint32_t    format;
+    uint32_t    size;
+} texcache_header_t;
+
+static struct {
+    uint64_t    key;            // for the texture being uploaded
+    int         width, height;  // source image dimensions
+    unsigned    hits;
+    unsigned    misses;
+    unsigned    stores;
+    size_t      bytes;
+} texcache;
+
+uint64_t GL_HashBytes(uint64_t hash, const void *data, size_t len)
+{
+    const byte *p = data;
+
+    // 64-bit FNV-1a
+    while (len--) {
+        hash ^= *p++;
+        hash *= UINT64_C(0x100000001b3);
+    }
+
+    return hash;
+}
+
+static uint64_t GL_TextureCacheKey(const image_t *image, const void *data, size_t len)
+{
+    int params[] = {
+        TEXCACHE_VERSION,
+        image->type,
+        image->flags & (IF_TRANSPARENT | IF_OPAQUE),
+        Cvar_ClampInteger(gl_picmip, 0, 31),
+        gl_round_down->integer,
+        gl_downsample_skins->integer,
+        gl_invert->integer,
+        gl_config.max_texture_size,
+        gl_config.caps & (QGL_CAP_TEXTURE_NON_POWER_OF_TWO | QGL_CAP_TEXTURE_BITS),
+        gl_tex_alpha_format,
+        gl_tex_solid_format,
+        r_config.flags & QVF_GAMMARAMP,
+        lightscale,
+    };
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+
+    hash = GL_HashBytes(hash, params, sizeof(params));
+    hash = GL_HashBytes(hash, &colorscale, sizeof(colorscale));
+    hash = GL_HashBytes(hash, gammaintensitytable, sizeof(gammaintensitytable));
+    // WAL textures are expanded through palette of the current game
+    hash = GL_HashBytes(hash, d_8to24table, sizeof(d_8to24table));
+    hash = GL_HashBytes(hash, data, len);
+
+    return hash;
+}
+
+static size_t GL_MipChainSize(int width, int height)
+{
+    size_t size = 0;
+
+    while (1) {
+        size += width * height * 4;
+        if (width == 1 && height == 1)
+            break;
+        width = max(width >> 1, 1);
+        height = max(height >> 1, 1);
+    }
+
+    return size;
+}
+
+static bool GL_UploadCached(image_t *image, const byte *data, size_t len, uint64_t key)
+{
+    const texcache_header_t *hdr = (const texcache_header_t *)data;
+    int width, height, level;
+
+    if (len < sizeof(*hdr))
+        return false;
+    if (hdr->ident != TEXCACHE_IDENT || hdr->version != TEXCACHE_VERSION || hdr->key != key)
+        return false;
+
+    width = hdr->upload_width;
+    height = hdr->upload_height;
+    if (width < 1 || width > gl_config.max_texture_size)
+        return false;
+    if (height < 1 || height > gl_config.max_texture_size)
+        return false;
+    if (hdr->size != len - sizeof(*hdr) || hdr->size != GL_MipChainSize(width, height))
+        return false;
+
+    qglGenTextures(1, &image->texnum);
+    GL_ForceTexture(TMU_TEXTURE, image->texnum);
+
+    data += sizeof(*hdr);
+    for (level = 0; ; level++) {
+        qglTexImage2D(GL_TEXTURE_2D, level, hdr->format, width, height,
+                      0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        if (width == 1 && height == 1)
+            break;
+        data += width * height * 4;
+        width = max(width >> 1, 1);
+        height = max(height >> 1, 1);
+    }
+
+    c.texUploads++;
+
+    image->flags |= hdr->flags & (IF_PALETTED | IF_TRANSPARENT);
+    GL_SetFilterAndRepeat(image->type, image->flags);
+
+    image->width = hdr->width;
+    image->height = hdr->height;
+    image->upload_width = hdr->upload_width;
+    image->upload_height = hdr->upload_height;
+    image->sl = 0;
+    image->sh = 1;
+    image->tl = 0;
+    image->th = 1;
+    return true;
+}
+
+bool IMG_UseCache(const image_t *image)
+{
+    if (!gl_texture_cache->integer)
+        return false;
+    if (image->type != IT_WALL && image->type != IT_SKIN)
+        return false;
+    // turbulent flag is also set for glow maps
+    if (image->flags & (IF_TURBULENT | IF_CUBEMAP))
+        return false;
+    return true;
+}
+
+/*
+================
+IMG_LoadCached
+
+Called with raw image file contents before decoding. Computes cache key
+for the image and uploads the texture if it was found in cache.
+================
+*/
+bool IMG_LoadCached(image_t *image, const void *data, size_t len)
+{
+    char        path[MAX_QPATH];
+    void        *buf;
+    uint64_t    key;
+    int         ret;
+
+    image->cache_key = 0;
+
+    if (!IMG_UseCache(image))
+        return false;
+
+    key = GL_TextureCacheKey(image, data, len);
+    Q_snprintf(path, sizeof(path), "texcache/%016"PRIx64".bin", key);
+
+    ret = FS_LoadFileEx(path, &buf, FS_TYPE_REAL, TAG_FILESYSTEM);
+    if (buf) {
+        if (GL_UploadCached(image, buf, ret, key)) {
+            texcache.hits++;
+            texcache.bytes += ret;
+            FS_FreeFile(buf);
+            return true;
+        }
+        Com_DPrintf("Ignoring bad texture cache entry %s for %s\n", path, image->name);
+        FS_FreeFile(buf);
+    }
+
+    // will be written after upload
+    image->cache_key = key;
+    texcache.misses++;
+    return false;
+}
+
+// like IMG_MipMap, but also handles levels 1 pixel wide or tall
+static void GL_MipMapLevel(byte *out, const byte *in, int width, int height)
+{
+    int     i, c;
+
+    if (width > 1 && height > 1) {
+        IMG_MipMap(out, in, width, height);
+        return;
+    }
+
+    c = max(width, height) >> 1;
+    for (i = 0; i < c; i++, out += 4, in += 8) {
+        out[0] = (in[0] + in[4]) >> 1;
+        out[1] = (in[1] + in[5]) >> 1;
+        out[2] = (in[2] + in[6]) >> 1;
+        out[3] = (in[3] + in[7]) >> 1;
+    }
+}
+
+// builds and uploads the rest of mip chain on CPU, then writes it to cache
+static void GL_StoreCached(const byte *data, int width, int height, int comp, imageflags_t flags)
+{
+    char                path[MAX_QPATH];
+    texcache_header_t   *hdr;
+    byte                *buffer, *src, *dst;
+    size_t              size;
+    int                 level, ret;
+
+    size = GL_MipChainSize(width, height);
+    buffer = FS_AllocTempMem(sizeof(*hdr) + size);
+
+    hdr = (texcache_header_t *)buffer;
+    hdr->ident = TEXCACHE_IDENT;
+    hdr->version = TEXCACHE_VERSION;
+    hdr->key = texcache.key;
+    hdr->width = texcache.width;
+    hdr->height = texcache.height;
+    hdr->upload_width = width;
+    hdr->upload_height = height;
+    hdr->flags = (flags & IF_PALETTED) | (upload_alpha ? IF_TRANSPARENT : 0);
+    hdr->format = comp;
+    hdr->size = size;
+
+    // base level was already uploaded by caller
+    dst = buffer + sizeof(*hdr);
+    memcpy(dst, data, width * height * 4);
+
+    for (level = 1; width > 1 || height > 1; level++) {
+        src = dst;
+        dst += width * height * 4;
+        GL_MipMapLevel(dst, src, width, height);
+        width = max(width >> 1, 1);
+        height = max(height >> 1, 1);
+        qglTexImage2D(GL_TEXTURE_2D, level, comp, width, height,
+                      0, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+    }
+
+    Q_snprintf(path, sizeof(path), "texcache/%016"PRIx64".bin", texcache.key);
+    ret = FS_WriteFile(path, buffer, sizeof(*hdr) + size);
+    if (ret < 0)
+        Com_DPrintf("Couldn't write %s: %s\n", path, Q_ErrorString(ret));
+    else
+        texcache.stores++;
+
+    FS_FreeTempMem(buffer);
+}
+
+void IMG_PrintCacheStats(void)
+{
+    if (!texcache.hits && !texcache.misses)
+        return;
+
+    Com_Printf("Texture cache: %u hits, %u misses, %u stored, %zu KiB read\n",
+               texcache.hits, texcache.misses, texcache.stores, texcache.bytes / 1024);
+}
+
 /*
 ===============
 GL_Upload32
@@ -510,7 +946,7 @@ static void GL_Upload32(byte *data, int width, int height, int baselevel, imaget
         }
     } else {
         scaled = FS_AllocTempMem(scaled_width * scaled_height * 4);
-        IMG_ResampleTexture(data, width, height, scaled,
+        IMG_ResampleTexture(imgfuncs, data, width, height, scaled,
                             scaled_width, scaled_height);
     }
 
@@ -536,7 +972,10 @@ static void GL_Upload32(byte *data, int width, int height, int baselevel, imaget
     c.texUploads++;
 
     if (type == IT_WALL || type == IT_SKIN) {
-        if (qglGenerateMipmap) {
+        if (texcache.key && !(scaled_width & (scaled_width - 1)) &&
+            !(scaled_height & (scaled_height - 1))) {
+            GL_StoreCached(scaled, scaled_width, scaled_height, comp, flags);
+        } else if (qglGenerateMipmap) {
             qglGenerateMipmap(GL_TEXTURE_2D);
         } else {
             int miplevel = 0;
@@ -595,12 +1034,12 @@ static void GL_Upscale32(byte *data, int width, int height, int maxlevel, imaget
     buffer = FS_AllocTempMem((width * height) << ((maxlevel + 1) * 2));
 
     if (maxlevel >= 2) {
-        HQ4x_Render((uint32_t *)buffer, (uint32_t *)data, width, height);
+        HQ4x_Render(imgfuncs, (uint32_t *)buffer, (uint32_t *)data, width, height);
         GL_Upload32(buffer, width * 4, height * 4, maxlevel - 2, type, flags);
     }
 
     if (maxlevel >= 1) {
-        HQ2x_Render((uint32_t *)buffer, (uint32_t *)data, width, height);
+        HQ2x_Render(imgfuncs, (uint32_t *)buffer, (uint32_t *)data, width, height);
         GL_Upload32(buffer, width * 2, height * 2, maxlevel - 1, type, flags);
     }
 
@@ -873,7 +1312,11 @@ void IMG_Load(image_t *image, byte *pic)
             GL_Upscale32(pic, width, height, maxlevel, image->type, image->flags);
             image->flags |= IF_UPSCALED;
         } else {
+            texcache.key = image->cache_key;
+            texcache.width = image->width;
+            texcache.height = image->height;
             GL_Upload32(pic, width, height, maxlevel, image->type, image->flags);
+            texcache.key = 0;
         }
 
         GL_SetFilterAndRepeat(image->type, image->flags);
@@ -1247,6 +1690,110 @@ static void gl_partshape_changed(cvar_t *self)
     GL_InitParticleTexture();
 }
 
+#if USE_TESTS
+
+typedef void (*imgbench_t)(const imgfuncs_t *funcs, byte *out, const byte *in, int size);
+
+static void bench_mipmap(const imgfuncs_t *funcs, byte *out, const byte *in, int size)
+{
+    funcs->mipmap(out, in, size, size);
+}
+
+static void bench_resample(const imgfuncs_t *funcs, byte *out, const byte *in, int size)
+{
+    IMG_ResampleTexture(funcs, in, size, size, out, size * 3 / 4, size * 3 / 4);
+}
+
+static void bench_hq2x(const imgfuncs_t *funcs, byte *out, const byte *in, int size)
+{
+    HQ2x_Render(funcs, (uint32_t *)out, (const uint32_t *)in, size, size);
+}
+
+static void bench_hq4x(const imgfuncs_t *funcs, byte *out, const byte *in, int size)
+{
+    HQ4x_Render(funcs, (uint32_t *)out, (const uint32_t *)in, size, size);
+}
+
+static const struct {
+    const char  *name;
+    imgbench_t  func;
+} img_benches[] = {
+    { "mipmap", bench_mipmap },
+    { "resample", bench_resample },
+    { "hq2x", bench_hq2x },
+    { "hq4x", bench_hq4x },
+};
+
+static void GL_ImageBench_f(void)
+{
+    unsigned features = Com_GetCpuFeatures();
+    int i, j, k, size, count, outsize;
+    uint32_t palette[16];
+    byte *src, *ref, *out;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <size> [count]\n", Cmd_Argv(0));
+        return;
+    }
+
+    size = Q_clip(Q_atoi(Cmd_Argv(1)), 2, MAX_TEXTURE_SIZE / 4);
+    count = Q_clip(Cmd_Argc() > 2 ? Q_atoi(Cmd_Argv(2)) : 10, 1, 1000);
+
+    // pick pixels from small palette with some transparent colors,
+    // so that hq2x patterns have a mix of similar and different neighbours
+    for (i = 0; i < 16; i++)
+        palette[i] = Q_rand() & (i < 2 ? 0xffffff : 0xffffffff);
+
+    // extra row for odd width mipmap, which reads past end of row
+    src = Z_Malloc(size * (size + 1) * 4);
+    for (i = 0; i < size * (size + 1); i++)
+        WN32(src + i * 4, palette[Q_rand() & 15]);
+
+    outsize = size * size * 4 * 16;
+    ref = Z_Malloc(outsize);
+    out = Z_Malloc(outsize);
+
+    // make sure hq2x tables are initialized
+    HQ2x_Init();
+
+    for (i = 0; i < q_countof(img_benches); i++) {
+        Com_Printf("%s:\n", img_benches[i].name);
+
+        memset(ref, 0, outsize);
+        img_benches[i].func(&img_c, ref, src, size);
+
+        for (j = 0; img_funcs[j]; j++) {
+            const imgfuncs_t *m = img_funcs[j];
+            uint64_t start, elapsed;
+            bool exact;
+
+            if ((m->features & features) != m->features) {
+                Com_Printf("%-5s: not supported\n", m->name);
+                continue;
+            }
+
+            memset(out, 0, outsize);
+            start = Sys_Microseconds();
+            for (k = 0; k < count; k++)
+                img_benches[i].func(m, out, src, size);
+            elapsed = max(Sys_Microseconds() - start, 1);
+
+            // check results are bit-exact to C version
+            exact = !memcmp(ref, out, outsize);
+
+            Com_Printf("%-5s: %.2f MPix/s%s\n", m->name,
+                       (double)size * size * count / elapsed,
+                       exact ? "" : " (MISMATCH)");
+        }
+    }
+
+    Z_Free(src);
+    Z_Free(ref);
+    Z_Free(out);
+}
+
+#endif
+
 /*
 ===============
 GL_InitImages
@@ -1279,6 +1826,14 @@ void GL_InitImages(void)
     gl_partshape = Cvar_Get("gl_partshape", "0", 0);
     gl_partshape->changed = gl_partshape_changed;
     gl_cubemaps = Cvar_Get("gl_cubemaps", "0", CVAR_FILES);
+    gl_texture_cache = Cvar_Get("gl_texture_cache", "0", 0);
+
+    imgfuncs = GL_GetImageFuncs();
+    Com_DPrintf("Image kernels: %s\n", imgfuncs->name);
+
+#if USE_TESTS
+    Cmd_AddCommand("gl_imagebench", GL_ImageBench_f);
+#endif
 
     if (r_config.flags & QVF_GAMMARAMP) {
         gl_gamma->changed = gl_gamma_changed;
@@ -1354,6 +1909,10 @@ void GL_ShutdownImages(void)
     gl_gamma->changed = NULL;
     gl_partshape->changed = NULL;
 
+#if USE_TESTS
+    Cmd_RemoveCommand("gl_imagebench");
+#endif
+
     // delete auto textures
     qglDeleteTextures(NUM_AUTO_TEXTURES, gl_static.texnums);
     qglDeleteTextures(LM_MAX_LIGHTMAPS, lm.texnums);
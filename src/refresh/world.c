@@ -384,6 +384,392 @@ static void GL_MarkLeaves(void)
     }
 }
 
+/*
+=============================================================================
+
+WORLD INDEX CACHE
+
+Index buffer for opaque world faces is built once per PVS change, grouped
+by texture, lightmap and state bits. Within each batch, faces are further
+grouped by the node they lie on, so that per-frame work is reduced to
+marking nodes that pass frustum culling and drawing contiguous ranges of
+visible nodes.
+
+Faces that need per-frame processing (sky, translucent and animated
+textures) still go through the regular path.
+
+=============================================================================
+*/
+
+typedef struct {
+    const mface_t   *face;      // first face for texnums and state
+    int             firstchunk;
+    int             numchunks;
+    int             firstrange; // valid for current frame
+    int             numranges;
+} wbatch_t;
+
+typedef struct {
+    int             node;
+    int             firstindex;
+    int             numindices;
+    int             firstface;
+    int             numfaces;
+} wchunk_t;
+
+typedef struct {
+    mface_t         *face;
+    int             node;
+} wsort_t;
+
+static struct {
+    const bsp_t     *bsp;
+    bool            valid;
+    bool            active;
+    unsigned        visframe;
+    unsigned        markframe;
+    byte            areabits[MAX_MAP_AREAS / 8];
+    bool            have_areabits;
+
+    // per BSP data
+    unsigned        *nodeframe;
+    unsigned        *facemark;
+    byte            *nodeflags;     // has uncached faces
+    byte            *leafflags;
+    wsort_t         *sort;
+    mface_t         **faces;
+    wchunk_t        *chunks;
+    wbatch_t        *batches;
+    glIndex_t       *indices;
+    glIndexRange_t  *ranges;
+    glDrawCommand_t *cmds;
+
+    int             numfaces;
+    int             numchunks;
+    int             numbatches;
+    int             numindices;
+} wcache;
+
+static inline bool GL_FaceCacheable(const mface_t *face)
+{
+    return !(face->drawflags & (SURF_SKY | SURF_TRANS_MASK | SURF_NODRAW)) && !face->texinfo->next;
+}
+
+void GL_InvalidateWorldCache(void)
+{
+    wcache.valid = false;
+}
+
+void GL_FreeWorldCache(void)
+{
+    Z_Free(wcache.nodeframe);
+    Z_Free(wcache.facemark);
+    Z_Free(wcache.nodeflags);
+    Z_Free(wcache.leafflags);
+    Z_Free(wcache.sort);
+    Z_Free(wcache.faces);
+    Z_Free(wcache.chunks);
+    Z_Free(wcache.batches);
+    Z_Free(wcache.indices);
+    Z_Free(wcache.ranges);
+    Z_Free(wcache.cmds);
+    memset(&wcache, 0, sizeof(wcache));
+}
+
+static void GL_AllocWorldCache(const bsp_t *bsp)
+{
+    const mface_t *face;
+    const mnode_t *node;
+    const mleaf_t *leaf;
+    int i, j, numindices;
+
+    GL_FreeWorldCache();
+
+    for (i = numindices = 0, face = bsp->faces; i < bsp->numfaces; i++, face++)
+        if (GL_FaceCacheable(face))
+            numindices += (face->numsurfedges - 2) * 3;
+
+    wcache.nodeframe = R_Mallocz(sizeof(wcache.nodeframe[0]) * bsp->numnodes);
+    wcache.facemark = R_Mallocz(sizeof(wcache.facemark[0]) * bsp->numfaces);
+    wcache.nodeflags = R_Mallocz(sizeof(wcache.nodeflags[0]) * bsp->numnodes);
+    wcache.leafflags = R_Mallocz(sizeof(wcache.leafflags[0]) * bsp->numleafs);
+    wcache.sort = R_Malloc(sizeof(wcache.sort[0]) * bsp->numfaces);
+    wcache.faces = R_Malloc(sizeof(wcache.faces[0]) * bsp->numfaces);
+    wcache.chunks = R_Malloc(sizeof(wcache.chunks[0]) * bsp->numfaces);
+    wcache.batches = R_Malloc(sizeof(wcache.batches[0]) * bsp->numfaces);
+    wcache.indices = R_Malloc(sizeof(wcache.indices[0]) * max(numindices, 1));
+    wcache.ranges = R_Malloc(sizeof(wcache.ranges[0]) * bsp->numfaces);
+    wcache.cmds = R_Malloc(sizeof(wcache.cmds[0]) * bsp->numfaces);
+
+    // find nodes and leafs that still need per-face processing
+    for (i = 0, node = bsp->nodes; i < bsp->numnodes; i++, node++)
+        for (j = 0, face = node->firstface; j < node->numfaces; j++, face++)
+            if (!GL_FaceCacheable(face))
+                wcache.nodeflags[i] = 1;
+
+    for (i = 0, leaf = bsp->leafs; i < bsp->numleafs; i++, leaf++)
+        for (j = 0; j < leaf->numleaffaces; j++)
+            if (!GL_FaceCacheable(leaf->firstleafface[j]))
+                wcache.leafflags[i] = 1;
+
+    wcache.bsp = bsp;
+}
+
+static int wsortcmp(const void *p1, const void *p2)
+{
+    const wsort_t *a = p1, *b = p2;
+    const mface_t *f1 = a->face, *f2 = b->face;
+
+    if (f1->texinfo->image != f2->texinfo->image)
+        return f1->texinfo->image < f2->texinfo->image ? -1 : 1;
+    if (f1->light_m != f2->light_m)
+        return f1->light_m < f2->light_m ? -1 : 1;
+    if (f1->statebits != f2->statebits)
+        return f1->statebits < f2->statebits ? -1 : 1;
+    if (a->node != b->node)
+        return a->node - b->node;
+    return f1 - f2;
+}
+
+static bool GL_SameBatch(const mface_t *f1, const mface_t *f2)
+{
+    return f1->texinfo->image == f2->texinfo->image &&
+        f1->light_m == f2->light_m && f1->statebits == f2->statebits;
+}
+
+static void GL_BuildWorldCache(void)
+{
+    const bsp_t *bsp = gl_static.world.cache;
+    const mleaf_t *leaf;
+    const mnode_t *node;
+    mface_t *face;
+    wbatch_t *batch = NULL;
+    wchunk_t *chunk = NULL;
+    glIndex_t *dst;
+    int i, j, count;
+
+    if (wcache.bsp != bsp)
+        GL_AllocWorldCache(bsp);
+
+    // mark faces in potentially visible leafs
+    wcache.markframe++;
+    for (i = 0, leaf = bsp->leafs; i < bsp->numleafs; i++, leaf++) {
+        if (leaf->visframe != glr.visframe)
+            continue;
+        if (leaf->contents[0] == CONTENTS_SOLID)
+            continue;
+        if (glr.fd.areabits && !Q_IsBitSet(glr.fd.areabits, leaf->area))
+            continue;
+        for (j = 0; j < leaf->numleaffaces; j++)
+            wcache.facemark[leaf->firstleafface[j] - bsp->faces] = wcache.markframe;
+    }
+
+    // collect cacheable faces on visible nodes
+    for (i = count = 0, node = bsp->nodes; i < bsp->numnodes; i++, node++) {
+        if (node->visframe != glr.visframe)
+            continue;
+        for (j = 0, face = node->firstface; j < node->numfaces; j++, face++) {
+            if (wcache.facemark[face - bsp->faces] != wcache.markframe)
+                continue;
+            if (!GL_FaceCacheable(face))
+                continue;
+            wcache.sort[count].face = face;
+            wcache.sort[count].node = i;
+            count++;
+        }
+    }
+
+    qsort(wcache.sort, count, sizeof(wcache.sort[0]), wsortcmp);
+
+    // emit batches, chunks and indices
+    wcache.numbatches = wcache.numchunks = 0;
+    dst = wcache.indices;
+    for (i = 0; i < count; i++) {
+        const wsort_t *s = &wcache.sort[i];
+
+        face = s->face;
+        if (!batch || !GL_SameBatch(batch->face, face)) {
+            batch = &wcache.batches[wcache.numbatches++];
+            batch->face = face;
+            batch->firstchunk = wcache.numchunks;
+            batch->numchunks = 0;
+            chunk = NULL;
+        }
+
+        if (!chunk || chunk->node != s->node) {
+            chunk = &wcache.chunks[wcache.numchunks++];
+            chunk->node = s->node;
+            chunk->firstindex = dst - wcache.indices;
+            chunk->numindices = 0;
+            chunk->firstface = i;
+            chunk->numfaces = 0;
+            batch->numchunks++;
+        }
+
+        for (j = 0; j < face->numsurfedges - 2; j++) {
+            dst[0] = face->firstvert;
+            dst[1] = face->firstvert + (j + 1);
+            dst[2] = face->firstvert + (j + 2);
+            dst += 3;
+        }
+
+        wcache.faces[i] = face;
+        chunk->numindices = (dst - wcache.indices) - chunk->firstindex;
+        chunk->numfaces++;
+    }
+
+    wcache.numfaces = count;
+    wcache.numindices = dst - wcache.indices;
+
+    if (!gl_static.world.index_buffer)
+        qglGenBuffers(1, &gl_static.world.index_buffer);
+
+    GL_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl_static.world.index_buffer);
+    qglBufferData(GL_ELEMENT_ARRAY_BUFFER, wcache.numindices * sizeof(wcache.indices[0]),
+                  wcache.indices, GL_DYNAMIC_DRAW);
+
+    wcache.visframe = glr.visframe;
+    wcache.valid = true;
+
+    Com_DDPrintf("%s: %d faces, %d chunks, %d batches\n", __func__,
+                 wcache.numfaces, wcache.numchunks, wcache.numbatches);
+}
+
+static void GL_UpdateWorldCache(void)
+{
+    wcache.active = false;
+
+    if (!gl_world_cache->integer)
+        return;
+
+    // need world VBO to index into
+    if (gl_static.world.vertices || !qglGenBuffers)
+        return;
+
+    // door states are not part of PVS
+    if (glr.fd.areabits) {
+        if (!wcache.have_areabits || memcmp(wcache.areabits, glr.fd.areabits, sizeof(wcache.areabits))) {
+            memcpy(wcache.areabits, glr.fd.areabits, sizeof(wcache.areabits));
+            wcache.have_areabits = true;
+            wcache.valid = false;
+        }
+    } else if (wcache.have_areabits) {
+        wcache.have_areabits = false;
+        wcache.valid = false;
+    }
+
+    if (!wcache.valid || wcache.visframe != glr.visframe || wcache.bsp != gl_static.world.cache)
+        GL_BuildWorldCache();
+
+    wcache.active = true;
+}
+
+static void GL_PushCachedLights(void)
+{
+    for (int i = 0; i < wcache.numchunks; i++) {
+        const wchunk_t *chunk = &wcache.chunks[i];
+
+        if (wcache.nodeframe[chunk->node] != glr.drawframe)
+            continue;
+
+        for (int j = 0; j < chunk->numfaces; j++)
+            GL_PushLights(wcache.faces[chunk->firstface + j]);
+    }
+}
+
+// collects visible ranges of each batch, merging adjacent chunks
+static int GL_CollectCachedRanges(void)
+{
+    glIndexRange_t *range;
+    int i, j, numranges = 0;
+
+    for (i = 0; i < wcache.numbatches; i++) {
+        wbatch_t *batch = &wcache.batches[i];
+        const wchunk_t *chunk = &wcache.chunks[batch->firstchunk];
+
+        batch->firstrange = numranges;
+        range = NULL;
+
+        for (j = 0; j < batch->numchunks; j++, chunk++) {
+            if (wcache.nodeframe[chunk->node] != glr.drawframe)
+                continue;
+
+            if (range && range->first + range->count == chunk->firstindex) {
+                range->count += chunk->numindices;
+            } else {
+                range = &wcache.ranges[numranges++];
+                range->first = chunk->firstindex;
+                range->count = chunk->numindices;
+            }
+
+            c.facesDrawn += chunk->numfaces;
+            c.facesTris += chunk->numindices / 3;
+        }
+
+        batch->numranges = numranges - batch->firstrange;
+    }
+
+    return numranges;
+}
+
+static bool GL_UseMultiDraw(void)
+{
+    return gl_world_cache->integer > 1 && qglMultiDrawElementsIndirect &&
+        !(gl_showtris->integer & SHOWTRIS_WORLD);
+}
+
+// uploads all ranges as indirect commands, then submits one multi-draw
+// call per batch
+static void GL_DrawCachedFacesIndirect(int numranges)
+{
+    int i;
+
+    for (i = 0; i < numranges; i++) {
+        glDrawCommand_t *cmd = &wcache.cmds[i];
+
+        cmd->count = wcache.ranges[i].count;
+        cmd->instanceCount = 1;
+        cmd->firstIndex = wcache.ranges[i].first;
+        cmd->baseVertex = 0;
+        cmd->baseInstance = 0;
+
+        c.trisDrawn += cmd->count / 3;
+    }
+
+    if (!gl_static.world.indirect_buffer)
+        qglGenBuffers(1, &gl_static.world.indirect_buffer);
+
+    GL_BindBuffer(GL_DRAW_INDIRECT_BUFFER, gl_static.world.indirect_buffer);
+    qglBufferData(GL_DRAW_INDIRECT_BUFFER, numranges * sizeof(wcache.cmds[0]),
+                  wcache.cmds, GL_STREAM_DRAW);
+
+    for (i = 0; i < wcache.numbatches; i++) {
+        const wbatch_t *batch = &wcache.batches[i];
+        GL_DrawFaceIndirect(batch->face, batch->firstrange, batch->numranges);
+    }
+}
+
+static void GL_DrawCachedFaces(void)
+{
+    int numranges;
+
+    GL_Flush3D();
+
+    numranges = GL_CollectCachedRanges();
+    if (!numranges)
+        return;
+
+    if (GL_UseMultiDraw()) {
+        GL_DrawCachedFacesIndirect(numranges);
+        return;
+    }
+
+    for (int i = 0; i < wcache.numbatches; i++) {
+        const wbatch_t *batch = &wcache.batches[i];
+        GL_DrawFaceRanges(batch->face, wcache.ranges + batch->firstrange, batch->numranges);
+    }
+}
+
 #define BACKFACE_EPSILON    0.01f
 
 void GL_DrawBspModel(mmodel_t *model)
@@ -511,10 +897,14 @@ static inline void GL_DrawLeaf(const mleaf_t *leaf)
     if (glr.fd.areabits && !Q_IsBitSet(glr.fd.areabits, leaf->area))
         return; // door blocks sight
 
+    c.leavesDrawn++;
+
+    // cached faces don't need marking
+    if (wcache.active && !wcache.leafflags[leaf - gl_static.world.cache->leafs])
+        return;
+
     for (int i = 0; i < leaf->numleaffaces; i++)
         leaf->firstleafface[i]->drawframe = glr.drawframe;
-
-    c.leavesDrawn++;
 }
 
 static inline void GL_DrawNode(const mnode_t *node)
@@ -522,10 +912,23 @@ static inline void GL_DrawNode(const mnode_t *node)
     mface_t *face;
     int i;
 
+    c.nodesDrawn++;
+
+    if (wcache.active) {
+        int n = node - gl_static.world.cache->nodes;
+
+        wcache.nodeframe[n] = glr.drawframe;
+        if (!wcache.nodeflags[n])
+            return;
+    }
+
     for (i = 0, face = node->firstface; i < node->numfaces; i++, face++) {
         if (face->drawframe != glr.drawframe)
             continue;
 
+        if (wcache.active && GL_FaceCacheable(face))
+            continue;
+
         if (face->drawflags & SURF_SKY && !(face->statebits & GLS_SKY_MASK)) {
             R_AddSkySurface(face);
             continue;
@@ -542,8 +945,6 @@ static inline void GL_DrawNode(const mnode_t *node)
         else
             GL_AddSolidFace(face);
     }
-
-    c.nodesDrawn++;
 }
 
 static void GL_WorldNode_r(const mnode_t *node, int clipflags)
@@ -582,6 +983,8 @@ void GL_DrawWorld(void)
 
     GL_MarkLeaves();
 
+    GL_UpdateWorldCache();
+
     GL_MarkLights();
 
     R_ClearSkyBox();
@@ -595,11 +998,17 @@ void GL_DrawWorld(void)
     GL_WorldNode_r(gl_static.world.cache->nodes,
                    gl_cull_nodes->integer ? NODE_CLIPPED : NODE_UNCLIPPED);
 
+    if (wcache.active && gl_dynamic->integer)
+        GL_PushCachedLights();
+
     if (gl_dynamic->integer)
         GL_UploadLightmaps();
 
     GL_DrawSolidFaces();
 
+    if (wcache.active)
+        GL_DrawCachedFaces();
+
     GL_Flush3D();
 
     R_DrawSkyBox();
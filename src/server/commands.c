@@ -645,6 +645,24 @@ static void dump_lag(void)
     }
 }
 
+static void dump_pacing(void)
+{
+    client_t    *cl;
+
+    Com_Printf(
+        "num name            packets  frames   ovfl  avgus maxus\n"
+        "--- --------------- -------- -------- ---- ------ -----\n");
+
+    FOR_EACH_CLIENT(cl) {
+        const client_pace_t *pace = &cl->pace;
+        Com_Printf("%3i %-15.15s %8u %8u %4u %6u %5u\n",
+                   cl->number, cl->name, pace->packets, pace->flushes,
+                   pace->overflows, pace->flushes ?
+                   (unsigned)(pace->total_delay / pace->flushes) : 0,
+                   pace->max_delay);
+    }
+}
+
 static void dump_protocols(void)
 {
     client_t    *cl;
@@ -711,11 +729,12 @@ static void SV_Status_f(void)
             case 'd': dump_downloads(); break;
             case 'l': dump_lag();       break;
             case 'p': dump_protocols(); break;
+            case 'q': dump_pacing();    break;
             case 's': dump_settings();  break;
             case 't': dump_time();      break;
             case 'v': dump_versions();  break;
             default:
-                Com_Printf("Usage: %s [d|l|p|s|t|v]\n", Cmd_Argv(0));
+                Com_Printf("Usage: %s [d|l|p|q|s|t|v]\n", Cmd_Argv(0));
                 dump_clients();
                 break;
             }
@@ -1796,6 +1815,8 @@ static const cmdreg_t c_server[] = {
     { "adduserinfoban", SV_AddInfoBan_f },
     { "deluserinfoban", SV_DelInfoBan_f },
     { "listuserinfobans", SV_ListInfoBans_f },
+    { "framejitter", SV_FrameJitter_f },
+    { "lookupstats", SV_LookupStats_f },
 #if USE_MVD_CLIENT || USE_MVD_SERVER
     { "mvdrecord", SV_Record_f, SV_Record_c },
     { "mvdstop", SV_Stop_f },
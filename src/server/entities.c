@@ -18,17 +18,330 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "server.h"
 
+// some protocol optimizations are disabled when recording a demo
+#define Q2PRO_OPTIMIZE(c) \
+    ((c)->protocol == PROTOCOL_VERSION_Q2PRO && !(c)->settings[CLS_RECORDING])
+
 /*
 =============================================================================
 
-Encode a client frame onto the network channel
+Entity state arena
+
+Packed entity states are allocated from a ring buffer shared by all clients.
+State packed from an edict is referenced by every client that sees it
+unmodified, and is reused for as long as the edict doesn't change. Client
+frames store only handles, and frames referencing states that may have been
+overwritten are not used as delta source.
 
 =============================================================================
 */
 
-// some protocol optimizations are disabled when recording a demo
-#define Q2PRO_OPTIMIZE(c) \
-    ((c)->protocol == PROTOCOL_VERSION_Q2PRO && !(c)->settings[CLS_RECORDING])
+// don't hand out states that could be overwritten while building a frame
+#define ARENA_MARGIN    (MAX_PACKET_ENTITIES * 4)
+
+typedef struct {
+    const void  *ge, *csr;
+    int         framenum;   // when base was last checked against edict
+    int         varframe;   // when variant was allocated
+    unsigned    base;       // state packed straight from edict
+    unsigned    variant;    // last state modified for some client
+} entity_cache_t;
+
+static entity_cache_t   entity_cache[MAX_EDICTS];
+
+static bool arena_valid(unsigned handle)
+{
+    return svs.arena.next - handle <= svs.arena.size - ARENA_MARGIN;
+}
+
+static unsigned arena_alloc(const entity_packed_t *state)
+{
+    unsigned handle = svs.arena.next++;
+
+    memcpy(ARENA_STATE(handle), state, sizeof(*state));
+    return handle;
+}
+
+// returns the older of two handles
+static unsigned arena_oldest(unsigned a, unsigned b)
+{
+    return svs.arena.next - a > svs.arena.next - b ? a : b;
+}
+
+void SV_InitEntityArena(void)
+{
+    // enough to keep backup frames of all clients when most entities
+    // are static, older frames simply won't be delta compressed
+    svs.arena.size = Q_npot32(max(svs.maxclients * UPDATE_BACKUP * 32, 0x10000));
+    svs.arena.states = SV_Malloc(sizeof(svs.arena.states[0]) * svs.arena.size);
+    svs.arena.next = 0;
+
+    memset(entity_cache, 0, sizeof(entity_cache));
+}
+
+void SV_FreeEntityArena(void)
+{
+    Z_Freep(&svs.arena.states);
+    memset(&svs.arena, 0, sizeof(svs.arena));
+}
+
+// returns handle of state packed from edict for this server frame
+static unsigned get_base_state(const client_t *client, const edict_t *ent, int e)
+{
+    entity_cache_t *c = &entity_cache[e];
+    entity_packed_t state;
+    bool cached = c->ge == client->ge && c->csr == client->csr && arena_valid(c->base);
+
+    if (cached && c->framenum == sv.framenum)
+        return c->base;
+
+    memset(&state, 0, sizeof(state));
+    MSG_PackEntity(&state, &ent->s, ENT_EXTENSION(client->csr, ent));
+
+    c->ge = client->ge;
+    c->csr = client->csr;
+    c->framenum = sv.framenum;
+
+    // most entities don't change from frame to frame
+    if (cached && !memcmp(&state, ARENA_STATE(c->base), sizeof(state)))
+        return c->base;
+
+    c->base = arena_alloc(&state);
+    c->varframe = -1;
+    return c->base;
+}
+
+// returns handle of state modified for some client, reusing existing
+// state if it didn't really change or other client got the same one
+static unsigned get_variant_state(int e, const entity_packed_t *state, unsigned base)
+{
+    entity_cache_t *c = &entity_cache[e];
+
+    if (!memcmp(state, ARENA_STATE(base), sizeof(*state)))
+        return base;
+
+    if (c->varframe == sv.framenum && arena_valid(c->variant) &&
+        !memcmp(state, ARENA_STATE(c->variant), sizeof(*state)))
+        return c->variant;
+
+    c->variant = arena_alloc(state);
+    c->varframe = sv.framenum;
+    return c->variant;
+}
+
+/*
+=============================================================================
+
+Shared frames
+
+MVD spectators chasing the same player have identical views. Their entity
+lists are built once per server frame and copied, and delta encoded once
+for each distinct pair of old and new lists. Client frames with equal
+nonzero keys have equal entity lists.
+
+=============================================================================
+*/
+
+#define SHARE_HASH_SIZE     256
+#define SHARE_MAX_PROBES    8
+#define SHARE_MAX_ENTITIES  0x4000
+#define SHARE_MAX_BYTES     0x100000
+
+typedef struct {
+    const void      *ge, *cm, *csr;
+    vec3_t          org;
+    int             clientNum;
+    int             maxclients;
+    int             framediv;
+    unsigned        flags;
+    msgEsFlags_t    esFlags;
+} share_key_t;
+
+typedef struct {
+    share_key_t     key;
+    unsigned        framekey;
+    unsigned        first, count;   // in share.entities
+    unsigned        arena_base;
+} share_build_t;
+
+typedef struct {
+    unsigned        from, to;
+    uint64_t        baselines;
+    msgEsFlags_t    esFlags;
+    int             clientEntityNum;
+    int             maxclients;
+    unsigned        offset, length; // in share.bytes
+} share_encode_t;
+
+static struct {
+    int             framenum;
+    unsigned        keyseq;
+    share_build_t   builds[SHARE_HASH_SIZE];
+    share_encode_t  encodes[SHARE_HASH_SIZE];
+    unsigned        numentities;
+    unsigned        numbytes;
+    unsigned        entities[SHARE_MAX_ENTITIES];   // handles in svs.arena
+    byte            bytes[SHARE_MAX_BYTES];
+} share;
+
+static uint32_t share_hash(const void *data, size_t len)
+{
+    const byte *p = data;
+    uint32_t hash = 0x811c9dc5;
+
+    while (len--) {
+        hash ^= *p++;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static bool share_enabled(void)
+{
+    if (!sv_share_frames->integer || sv.state != ss_broadcast)
+        return false;
+
+    // cached lists are only valid for one server frame
+    if (share.framenum != sv.framenum) {
+        memset(share.builds, 0, sizeof(share.builds));
+        memset(share.encodes, 0, sizeof(share.encodes));
+        share.numentities = 0;
+        share.numbytes = 0;
+        share.framenum = sv.framenum;
+    }
+
+    return true;
+}
+
+// returns existing group with the same view, or empty slot for a new one
+static share_build_t *find_shared_build(const client_t *client, const vec3_t org,
+                                        int clientNum, bool clientnum_fix)
+{
+    share_build_t *build;
+    share_key_t key;
+    uint32_t hash;
+    int i;
+
+    if (!share_enabled())
+        return NULL;
+
+    memset(&key, 0, sizeof(key));
+    key.ge = client->ge;
+    key.cm = client->cm;
+    key.csr = client->csr;
+    VectorCopy(org, key.org);
+    key.clientNum = clientNum;
+    key.maxclients = client->maxclients;
+#if USE_FPS
+    key.framediv = client->framediv;
+#endif
+    key.flags = (client->settings[CLS_NOGIBS] ? BIT(0) : 0) |
+                (client->settings[CLS_NOFLARES] ? BIT(1) : 0) |
+                (client->settings[CLS_NOFOOTSTEPS] ? BIT(2) : 0) |
+                (Q2PRO_OPTIMIZE(client) ? BIT(3) : 0) |
+                (clientnum_fix ? BIT(4) : 0);
+    key.esFlags = client->esFlags;
+
+    hash = share_hash(&key, sizeof(key));
+    for (i = 0; i < SHARE_MAX_PROBES; i++) {
+        build = &share.builds[(hash + i) & (SHARE_HASH_SIZE - 1)];
+        if (!build->framekey) {
+            build->key = key;
+            return build;
+        }
+        if (!memcmp(&build->key, &key, sizeof(key)))
+            return build;
+    }
+
+    return NULL;
+}
+
+static void copy_shared_build(client_t *client, client_frame_t *frame, const share_build_t *build)
+{
+    for (unsigned i = 0; i < build->count; i++) {
+        client->entities[client->next_entity & (client->num_entities - 1)] = share.entities[build->first + i];
+        client->next_entity++;
+    }
+
+    frame->num_entities = build->count;
+    frame->key = build->framekey;
+    frame->arena_base = build->arena_base;
+}
+
+static void save_shared_build(const client_t *client, client_frame_t *frame, share_build_t *build)
+{
+    if (share.numentities + frame->num_entities > SHARE_MAX_ENTITIES)
+        return;
+
+    build->first = share.numentities;
+    build->count = frame->num_entities;
+    build->arena_base = frame->arena_base;
+    for (int i = 0; i < frame->num_entities; i++)
+        share.entities[share.numentities++] =
+            client->entities[(frame->first_entity + i) & (client->num_entities - 1)];
+
+    if (!++share.keyseq)
+        share.keyseq++;
+    build->framekey = frame->key = share.keyseq;
+}
+
+// returns cached or empty encoding slot for the given frame pair
+static share_encode_t *find_shared_encode(const client_t *client, const client_frame_t *from,
+                                          const client_frame_t *to, int clientEntityNum)
+{
+    share_encode_t *enc, key;
+    uint32_t hash;
+    int i;
+
+    if (!to->key || (from && !from->key))
+        return NULL;
+
+    if (!share_enabled())
+        return NULL;
+
+    memset(&key, 0, sizeof(key));
+    key.from = from ? from->key : 0;
+    key.to = to->key;
+    key.baselines = client->baselines_hash;
+    key.esFlags = client->esFlags;
+    key.clientEntityNum = clientEntityNum;
+    key.maxclients = client->maxclients;
+
+    hash = share_hash(&key, offsetof(share_encode_t, offset));
+    for (i = 0; i < SHARE_MAX_PROBES; i++) {
+        enc = &share.encodes[(hash + i) & (SHARE_HASH_SIZE - 1)];
+        if (!enc->to) {
+            *enc = key;
+            return enc;
+        }
+        if (!memcmp(enc, &key, offsetof(share_encode_t, offset)))
+            return enc;
+    }
+
+    return NULL;
+}
+
+static void save_shared_encode(share_encode_t *enc, unsigned start)
+{
+    unsigned len = msg_write.cursize - start;
+
+    if (share.numbytes + len > SHARE_MAX_BYTES)
+        return;
+
+    memcpy(share.bytes + share.numbytes, msg_write.data + start, len);
+    enc->offset = share.numbytes;
+    enc->length = len;
+    share.numbytes += len;
+}
+
+/*
+=============================================================================
+
+Encode a client frame onto the network channel
+
+=============================================================================
+*/
 
 /*
 =============
@@ -41,9 +354,8 @@ delta compression happy.
 static bool SV_TruncPacketEntities(client_t *client, const client_frame_t *from,
                                    client_frame_t *to, int oldindex, int newindex)
 {
-    entity_packed_t *newent;
-    const entity_packed_t *oldent;
-    int i, oldnum, newnum, entities_mask, from_num_entities, to_num_entities;
+    unsigned *entities = client->entities;
+    int i, oldnum, newnum, newent, oldent, entities_mask, from_num_entities, to_num_entities;
     bool ret = true;
 
     if (!sv_trunc_packet_entities->integer || client->netchan.type == NETCHAN_NEW)
@@ -59,27 +371,25 @@ static bool SV_TruncPacketEntities(client_t *client, const client_frame_t *from,
     to_num_entities = to->num_entities;
 
     entities_mask = client->num_entities - 1;
-    oldent = newent = NULL;
+    oldent = newent = 0;
     while (newindex < to->num_entities || oldindex < from_num_entities) {
         if (newindex >= to->num_entities) {
             newnum = MAX_EDICTS;
         } else {
-            i = (to->first_entity + newindex) & entities_mask;
-            newent = &client->entities[i];
-            newnum = newent->number;
+            newent = (to->first_entity + newindex) & entities_mask;
+            newnum = ARENA_STATE(entities[newent])->number;
         }
 
         if (oldindex >= from_num_entities) {
             oldnum = MAX_EDICTS;
         } else {
-            i = (from->first_entity + oldindex) & entities_mask;
-            oldent = &client->entities[i];
-            oldnum = oldent->number;
+            oldent = (from->first_entity + oldindex) & entities_mask;
+            oldnum = ARENA_STATE(entities[oldent])->number;
         }
 
         if (newnum == oldnum) {
             // skip delta update
-            *newent = *oldent;
+            entities[newent] = entities[oldent];
             oldindex++;
             newindex++;
             continue;
@@ -89,8 +399,8 @@ static bool SV_TruncPacketEntities(client_t *client, const client_frame_t *from,
             // remove new entity from frame
             to->num_entities--;
             for (i = newindex; i < to->num_entities; i++) {
-                client->entities[(to->first_entity + i    ) & entities_mask] =
-                client->entities[(to->first_entity + i + 1) & entities_mask];
+                entities[(to->first_entity + i    ) & entities_mask] =
+                entities[(to->first_entity + i + 1) & entities_mask];
             }
             continue;
         }
@@ -105,11 +415,11 @@ static bool SV_TruncPacketEntities(client_t *client, const client_frame_t *from,
 
             // insert old entity into frame
             for (i = to->num_entities - 1; i >= newindex; i--) {
-                client->entities[(to->first_entity + i + 1) & entities_mask] =
-                client->entities[(to->first_entity + i    ) & entities_mask];
+                entities[(to->first_entity + i + 1) & entities_mask] =
+                entities[(to->first_entity + i    ) & entities_mask];
             }
 
-            client->entities[(to->first_entity + newindex) & entities_mask] = *oldent;
+            entities[(to->first_entity + newindex) & entities_mask] = entities[oldent];
             to->num_entities++;
 
             // should never go backwards
@@ -121,10 +431,32 @@ static bool SV_TruncPacketEntities(client_t *client, const client_frame_t *from,
         }
     }
 
+    // frame now references states of the old one
+    if (from)
+        to->arena_base = arena_oldest(to->arena_base, from->arena_base);
+
     client->next_entity = to->first_entity + to_num_entities;
     return ret;
 }
 
+// first person entity is sent with origin and angles of the old state.
+// states may be shared with other clients, so patch a private copy.
+static const entity_packed_t *patch_first_person(client_t *client, const client_frame_t *frame,
+                                                 int index, const entity_packed_t *oldent)
+{
+    unsigned *handle = &client->entities[(frame->first_entity + index) & (client->num_entities - 1)];
+    entity_packed_t state;
+
+    memcpy(&state, ARENA_STATE(*handle), sizeof(state));
+    if (VectorCompare(state.origin, oldent->origin) && VectorCompare(state.angles, oldent->angles))
+        return ARENA_STATE(*handle);
+
+    VectorCopy(oldent->origin, state.origin);
+    VectorCopy(oldent->angles, state.angles);
+    *handle = arena_alloc(&state);
+    return ARENA_STATE(*handle);
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -135,15 +467,26 @@ Writes a delta update of an entity_packed_t list to the message.
 static bool SV_EmitPacketEntities(client_t *client, const client_frame_t *from,
                                   client_frame_t *to, int clientEntityNum, unsigned maxsize)
 {
-    entity_packed_t *newent;
-    const entity_packed_t *oldent;
+    const entity_packed_t *newent, *oldent;
     int i, oldnum, newnum, oldindex, newindex, from_num_entities;
     msgEsFlags_t flags;
-    bool ret = true;
+    share_encode_t *enc;
+    unsigned start = msg_write.cursize;
+    bool ret = true, patched = false;
 
     if (msg_write.cursize + 2 > maxsize)
         return false;
 
+    // reuse encoding done for another client if it surely fits
+    enc = find_shared_encode(client, from, to, clientEntityNum);
+    if (enc && enc->length) {
+        if (msg_write.cursize + enc->length + MAX_PACKETENTITY_BYTES <= maxsize) {
+            SZ_Write(&msg_write, share.bytes + enc->offset, enc->length);
+            return true;
+        }
+        enc = NULL;
+    }
+
     if (!from)
         from_num_entities = 0;
     else
@@ -155,6 +498,7 @@ static bool SV_EmitPacketEntities(client_t *client, const client_frame_t *from,
     while (newindex < to->num_entities || oldindex < from_num_entities) {
         if (msg_write.cursize + MAX_PACKETENTITY_BYTES > maxsize) {
             ret = SV_TruncPacketEntities(client, from, to, oldindex, newindex);
+            patched = true;
             break;
         }
 
@@ -162,7 +506,7 @@ static bool SV_EmitPacketEntities(client_t *client, const client_frame_t *from,
             newnum = MAX_EDICTS;
         } else {
             i = (to->first_entity + newindex) & (client->num_entities - 1);
-            newent = &client->entities[i];
+            newent = ARENA_STATE(client->entities[i]);
             newnum = newent->number;
         }
 
@@ -170,7 +514,7 @@ static bool SV_EmitPacketEntities(client_t *client, const client_frame_t *from,
             oldnum = MAX_EDICTS;
         } else {
             i = (from->first_entity + oldindex) & (client->num_entities - 1);
-            oldent = &client->entities[i];
+            oldent = ARENA_STATE(client->entities[i]);
             oldnum = oldent->number;
         }
 
@@ -186,8 +530,8 @@ static bool SV_EmitPacketEntities(client_t *client, const client_frame_t *from,
             }
             if (newnum == clientEntityNum) {
                 flags |= MSG_ES_FIRSTPERSON;
-                VectorCopy(oldent->origin, newent->origin);
-                VectorCopy(oldent->angles, newent->angles);
+                newent = patch_first_person(client, to, newindex, oldent);
+                patched = true;
             }
             MSG_WriteDeltaEntity(oldent, newent, flags);
             oldindex++;
@@ -206,8 +550,8 @@ static bool SV_EmitPacketEntities(client_t *client, const client_frame_t *from,
             }
             if (newnum == clientEntityNum) {
                 flags |= MSG_ES_FIRSTPERSON;
-                VectorCopy(oldent->origin, newent->origin);
-                VectorCopy(oldent->angles, newent->angles);
+                newent = patch_first_person(client, to, newindex, oldent);
+                patched = true;
             }
             MSG_WriteDeltaEntity(oldent, newent, flags);
             newindex++;
@@ -223,6 +567,13 @@ static bool SV_EmitPacketEntities(client_t *client, const client_frame_t *from,
     }
 
     MSG_WriteShort(0);      // end of packetentities
+
+    // frame no longer matches the shared list
+    if (patched)
+        to->key = 0;
+    else if (enc)
+        save_shared_encode(enc, start);
+
     return ret;
 }
 
@@ -258,6 +609,12 @@ static client_frame_t *get_last_frame(client_t *client)
         return NULL;
     }
 
+    if (!arena_valid(frame->arena_base)) {
+        // but entity states got overwritten
+        Com_DPrintf("%s: delta request from overwritten entities.\n", client->name);
+        return NULL;
+    }
+
     return frame;
 }
 
@@ -496,35 +853,93 @@ static bool SV_EntityAttenuatedAway(const vec3_t org, const edict_t *ent)
 #define IS_LO_PRIO(ent) \
     (IS_GIB(ent) || (!ent->s.modelindex && !ent->s.effects))
 
-static vec3_t clientorg;
+static uint32_t sort_keys[2][MAX_EDICTS];
+static uint16_t sort_vals[2][MAX_EDICTS];
 
-static int entpriocmp(const void *p1, const void *p2)
+// LSD radix sort of sort_vals[0] by sort_keys[0], returns result buffer index
+static int radix_sort(int count)
 {
-    const edict_t *a = *(const edict_t **)p1;
-    const edict_t *b = *(const edict_t **)p2;
-
-    bool hi_a = IS_HI_PRIO(a);
-    bool hi_b = IS_HI_PRIO(b);
-    if (hi_a != hi_b)
-        return hi_b - hi_a;
-
-    bool lo_a = IS_LO_PRIO(a);
-    bool lo_b = IS_LO_PRIO(b);
-    if (lo_a != lo_b)
-        return lo_a - lo_b;
-
-    float dist_a = DistanceSquared(a->s.origin, clientorg);
-    float dist_b = DistanceSquared(b->s.origin, clientorg);
-    if (dist_a > dist_b)
-        return 1;
-    return -1;
+    int i, b = 0;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        const uint32_t *ki = sort_keys[b];
+        const uint16_t *vi = sort_vals[b];
+        uint32_t *ko = sort_keys[b ^ 1];
+        uint16_t *vo = sort_vals[b ^ 1];
+        unsigned offsets[256] = { 0 }, sum = 0, n;
+
+        for (i = 0; i < count; i++)
+            offsets[(ki[i] >> shift) & 255]++;
+
+        // skip pass if all keys fall into the same bucket
+        if (offsets[(ki[0] >> shift) & 255] == count)
+            continue;
+
+        for (i = 0; i < 256; i++) {
+            n = offsets[i];
+            offsets[i] = sum;
+            sum += n;
+        }
+
+        for (i = 0; i < count; i++) {
+            n = offsets[(ki[i] >> shift) & 255]++;
+            ko[n] = ki[i];
+            vo[n] = vi[i];
+        }
+
+        b ^= 1;
+    }
+
+    return b;
 }
 
-static int entnumcmp(const void *p1, const void *p2)
+/*
+=============
+prioritize_entities
+
+Selects `max' most important entities: high priority ones first, then
+normal, then low priority ones, nearest first within each class. Selected
+entities keep their original order, i.e. remain sorted by number.
+=============
+*/
+static int prioritize_entities(edict_t **edicts, int num_edicts, int max, const vec3_t org)
 {
-    const edict_t *a = *(const edict_t **)p1;
-    const edict_t *b = *(const edict_t **)p2;
-    return a->s.number - b->s.number;
+    static byte prio[MAX_EDICTS];
+    int i, b, n, cls, remain, count[3] = { 0 };
+    union { float f; uint32_t u; } dist;
+
+    for (i = 0; i < num_edicts; i++) {
+        const edict_t *ent = edicts[i];
+        cls = IS_HI_PRIO(ent) ? 0 : IS_LO_PRIO(ent) ? 2 : 1;
+        prio[i] = cls;
+        count[cls]++;
+    }
+
+    // classes before `cls' fit entirely
+    remain = max;
+    for (cls = 0; count[cls] <= remain; cls++)
+        remain -= count[cls];
+
+    // pick nearest entities from the class that doesn't fit. squared
+    // distances are non-negative, so their bits sort like integers
+    for (i = n = 0; i < num_edicts; i++) {
+        if (prio[i] == cls) {
+            dist.f = DistanceSquared(edicts[i]->s.origin, org);
+            sort_keys[0][n] = dist.u;
+            sort_vals[0][n] = i;
+            n++;
+        }
+    }
+
+    b = radix_sort(n);
+    for (i = 0; i < remain; i++)
+        prio[sort_vals[b][i]] = 3;
+
+    for (i = n = 0; i < num_edicts; i++)
+        if (prio[i] < cls || prio[i] == 3)
+            edicts[n++] = edicts[i];
+
+    return n;
 }
 
 /*
@@ -542,7 +957,8 @@ void SV_BuildClientFrame(client_t *client)
     edict_t     *ent;
     edict_t     *clent;
     client_frame_t  *frame;
-    entity_packed_t *state;
+    entity_packed_t packed, *state = &packed;
+    unsigned        base, handle, arena_base;
     const mleaf_t   *leaf;
     int         clientarea, clientcluster;
     visrow_t    clientphs;
@@ -551,6 +967,7 @@ void SV_BuildClientFrame(client_t *client)
     int         max_packet_entities;
     edict_t     *edicts[MAX_EDICTS];
     int         num_edicts;
+    share_build_t   *build = NULL;
     qboolean (*visible)(edict_t *, edict_t *) = NULL;
     qboolean (*customize)(edict_t *, edict_t *, customize_entity_t *) = NULL;
     customize_entity_t temp;
@@ -566,6 +983,7 @@ void SV_BuildClientFrame(client_t *client)
     frame->number = client->framenum;
     frame->sentTime = com_eventTime; // save it for ping calc later
     frame->latency = -1; // not yet acked
+    frame->key = 0;
 
     client->frames_sent++;
 
@@ -616,13 +1034,21 @@ void SV_BuildClientFrame(client_t *client)
         customize = gex->CustomizeEntityToClient;
     }
 
-    CM_FatPVS(client->cm, &clientpvs, org);
-    BSP_ClusterVis(client->cm->cache, &clientphs, clientcluster, DVIS_PHS);
-
     // build up the list of visible entities
     frame->num_entities = 0;
     frame->first_entity = client->next_entity;
 
+    // copy the list if already built for the same view
+    if (!visible && !customize)
+        build = find_shared_build(client, org, frame->clientNum, need_clientnum_fix);
+    if (build && build->framekey && arena_valid(build->arena_base)) {
+        copy_shared_build(client, frame, build);
+        goto finish;
+    }
+
+    CM_FatPVS(client->cm, &clientpvs, org);
+    BSP_ClusterVis(client->cm->cache, &clientphs, clientcluster, DVIS_PHS);
+
     num_edicts = 0;
     for (e = 1; e < client->ge->num_edicts; e++) {
         ent = EDICT_NUM2(client->ge, e);
@@ -699,29 +1125,28 @@ void SV_BuildClientFrame(client_t *client)
 
     // prioritize entities on overflow
     if (num_edicts > max_packet_entities) {
-        VectorCopy(org, clientorg);
         sv_client = client;
         sv_player = client->edict;
-        qsort(edicts, num_edicts, sizeof(edicts[0]), entpriocmp);
+        num_edicts = prioritize_entities(edicts, num_edicts, max_packet_entities, org);
         sv_client = NULL;
         sv_player = NULL;
-        num_edicts = max_packet_entities;
-        qsort(edicts, num_edicts, sizeof(edicts[0]), entnumcmp);
     }
 
+    arena_base = svs.arena.next;
     for (i = 0; i < num_edicts; i++) {
         ent = edicts[i];
         e = ent->s.number;
 
-        // add it to the circular client_entities array
-        state = &client->entities[client->next_entity & (client->num_entities - 1)];
+        // start with the state shared by all clients
+        base = get_base_state(client, ent, e);
 
         // optionally customize it
         if (customize && customize(clent, ent, &temp)) {
             Q_assert(temp.s.number == e);
+            memset(state, 0, sizeof(*state));
             MSG_PackEntity(state, &temp.s, ENT_EXTENSION(client->csr, &temp));
         } else {
-            MSG_PackEntity(state, &ent->s, ENT_EXTENSION(client->csr, ent));
+            memcpy(state, ARENA_STATE(base), sizeof(*state));
         }
 
 #if USE_FPS
@@ -758,10 +1183,21 @@ void SV_BuildClientFrame(client_t *client)
             state->solid = sv.entities[e].solid32;
         }
 
+        // add it to the circular client_entities array
+        handle = get_variant_state(e, state, base);
+        client->entities[client->next_entity & (client->num_entities - 1)] = handle;
+        arena_base = arena_oldest(arena_base, handle);
+
         frame->num_entities++;
         client->next_entity++;
     }
 
+    frame->arena_base = arena_base;
+
+    if (build)
+        save_shared_build(client, frame, build);
+
+finish:
     if (need_clientnum_fix)
         frame->clientNum = client->infonum;
 }
@@ -26,31 +26,168 @@ static void PF_configstring(int index, const char *val);
 
 /*
 ================
-PF_FindIndex
+Configstring index
 
+Non-empty configstrings of each index range are hashed to avoid linear scans
+in PF_FindIndex. Hash is built on first lookup and kept in sync by
+PF_configstring. The first empty slot is tracked too, so that lookups and
+allocations return exactly what linear scan would.
 ================
 */
-static int PF_FindIndex(const char *name, int start, int max, int skip, const char *func)
+
+static void index_link(cs_index_t *index, int i)
+{
+    unsigned hash = Com_HashString(sv.configstrings[index->start + i], CS_INDEX_HASH_SIZE);
+
+    sv.csnext[index->start + i] = index->heads[hash];
+    index->heads[hash] = i;
+}
+
+static void index_unlink(cs_index_t *index, int i)
+{
+    unsigned hash = Com_HashString(sv.configstrings[index->start + i], CS_INDEX_HASH_SIZE);
+    uint16_t *p;
+
+    for (p = &index->heads[hash]; *p; p = &sv.csnext[index->start + *p]) {
+        if (*p == i) {
+            *p = sv.csnext[index->start + i];
+            break;
+        }
+    }
+}
+
+static void index_build(cs_index_t *index, int start, int max, int skip)
 {
-    char *string;
     int i;
 
-    if (!name || !name[0])
-        return 0;
+    memset(index->heads, 0, sizeof(index->heads));
+    index->start = start;
+    index->max = max;
+    index->skip = skip;
+    index->first_free = max;
 
     for (i = 1; i < max; i++) {
-        if (i == skip) {
+        if (i == skip)
             continue;
+        if (sv.configstrings[start + i][0])
+            index_link(index, i);
+        else if (index->first_free == max)
+            index->first_free = i;
+    }
+
+    index->built = true;
+}
+
+// returns built index containing configstring, or NULL
+static cs_index_t *index_for_configstring(int cs)
+{
+    for (int j = 0; j < q_countof(sv.csindex); j++) {
+        cs_index_t *index = &sv.csindex[j];
+        int i = cs - index->start;
+        if (index->built && i > 0 && i < index->max && i != index->skip)
+            return index;
+    }
+
+    return NULL;
+}
+
+// called before configstring is changed
+static void index_remove(cs_index_t *index, int i)
+{
+    if (sv.configstrings[index->start + i][0])
+        index_unlink(index, i);
+}
+
+// called after configstring is changed
+static void index_insert(cs_index_t *index, int i)
+{
+    if (!sv.configstrings[index->start + i][0]) {
+        index->first_free = min(index->first_free, i);
+        return;
+    }
+
+    index_link(index, i);
+
+    if (i == index->first_free) {
+        for (i++; i < index->max; i++) {
+            if (i != index->skip && !sv.configstrings[index->start + i][0])
+                break;
         }
-        string = sv.configstrings[start + i];
-        if (!string[0]) {
-            break;
-        }
-        if (!strcmp(string, name)) {
-            return i;
+        index->first_free = i;
+    }
+}
+
+/*
+================
+SV_ResetConfigstringIndex
+
+Must be called after modifying configstrings without PF_configstring.
+================
+*/
+void SV_ResetConfigstringIndex(void)
+{
+    for (int j = 0; j < q_countof(sv.csindex); j++)
+        sv.csindex[j].built = false;
+}
+
+/*
+================
+SV_LookupStats_f
+================
+*/
+void SV_LookupStats_f(void)
+{
+    const lookup_stats_t *st = &svs.lookups;
+
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "reset")) {
+        memset(&svs.lookups, 0, sizeof(svs.lookups));
+        return;
+    }
+
+    Com_Printf("%"PRIu64" index lookups, %"PRIu64" of %"PRIu64" string compares saved\n",
+               st->index_lookups, st->index_scanned - min(st->index_compared, st->index_scanned),
+               st->index_scanned);
+    Com_Printf("%"PRIu64" userinfo lookups, %"PRIu64" parses saved\n",
+               st->info_lookups, st->info_lookups - min(st->info_parses, st->info_lookups));
+}
+
+/*
+================
+PF_FindIndex
+
+================
+*/
+static int PF_FindIndex(cs_index_t *index, const char *name, int start, int max, int skip, const char *func)
+{
+    int i, found;
+
+    if (!name || !name[0])
+        return 0;
+
+    if (!index->built)
+        index_build(index, start, max, skip);
+
+    svs.lookups.index_lookups++;
+
+    // find the lowest matching index before the first empty slot
+    found = max;
+    i = index->heads[Com_HashString(name, CS_INDEX_HASH_SIZE)];
+    for (; i; i = sv.csnext[start + i]) {
+        if (i < index->first_free && i < found) {
+            svs.lookups.index_compared++;
+            if (!strcmp(sv.configstrings[start + i], name))
+                found = i;
         }
     }
 
+    if (found < max) {
+        svs.lookups.index_scanned += found - (skip && skip < found);
+        return found;
+    }
+
+    i = index->first_free;
+    svs.lookups.index_scanned += i - 1 - (skip && skip < i);
+
     if (i == max) {
         if (g_features->integer & GMF_ALLOW_INDEX_OVERFLOW) {
             Com_DPrintf("%s(%s): overflow\n", func, name);
@@ -66,17 +203,17 @@ static int PF_FindIndex(const char *name, int start, int max, int skip, const ch
 
 static int PF_ModelIndex(const char *name)
 {
-    return PF_FindIndex(name, svs.csr.models, svs.csr.max_models, MODELINDEX_PLAYER, __func__);
+    return PF_FindIndex(&sv.csindex[0], name, svs.csr.models, svs.csr.max_models, MODELINDEX_PLAYER, __func__);
 }
 
 static int PF_SoundIndex(const char *name)
 {
-    return PF_FindIndex(name, svs.csr.sounds, svs.csr.max_sounds, 0, __func__);
+    return PF_FindIndex(&sv.csindex[1], name, svs.csr.sounds, svs.csr.max_sounds, 0, __func__);
 }
 
 static int PF_ImageIndex(const char *name)
 {
-    return PF_FindIndex(name, svs.csr.images, svs.csr.max_images, 0, __func__);
+    return PF_FindIndex(&sv.csindex[2], name, svs.csr.images, svs.csr.max_images, 0, __func__);
 }
 
 /*
@@ -369,6 +506,7 @@ static void PF_configstring(int index, const char *val)
 {
     size_t len, maxlen;
     client_t *client;
+    cs_index_t *csindex;
     char *dst;
 
     if (index < 0 || index >= svs.csr.end)
@@ -405,10 +543,17 @@ static void PF_configstring(int index, const char *val)
         return;
     }
 
-    // change the string in sv
+    // change the string in sv, keeping index in sync
+    csindex = index_for_configstring(index);
+    if (csindex)
+        index_remove(csindex, index - csindex->start);
+
     memcpy(dst, val, len);
     dst[len] = 0;
 
+    if (csindex)
+        index_insert(csindex, index - csindex->start);
+
     if (sv.state == ss_loading) {
         return;
     }
@@ -442,6 +442,8 @@ void SV_InitGame(unsigned mvd_spawn)
     // initialize MVD server
     if (!mvd_spawn) {
         SV_MvdPreInit();
+    } else {
+        SV_MvdRelayInit();
     }
 
     Cvar_ClampInteger(sv_reserved_slots, 0, sv_maxclients->integer - 1);
@@ -450,6 +452,8 @@ void SV_InitGame(unsigned mvd_spawn)
     svs.maxclients = sv_maxclients->integer;
     svs.client_pool = SV_Mallocz(sizeof(svs.client_pool[0]) * svs.maxclients);
 
+    SV_InitEntityArena();
+
 #if USE_ZLIB
     svs.z.zalloc = SV_zalloc;
     svs.z.zfree = SV_zfree;
@@ -42,6 +42,8 @@ cvar_t  *sv_allow_nodelta;
 #if USE_FPS
 cvar_t  *sv_fps;
 #endif
+cvar_t  *sv_hires_timer;
+cvar_t  *sv_pace_window;
 
 cvar_t  *sv_timeout;            // seconds without any message
 cvar_t  *sv_zombietime;         // seconds to sink messages after disconnect
@@ -80,6 +82,7 @@ cvar_t  *sv_max_download_size;
 cvar_t  *sv_max_packet_entities;
 cvar_t  *sv_trunc_packet_entities;
 cvar_t  *sv_prioritize_entities;
+cvar_t  *sv_share_frames;
 
 cvar_t  *sv_strafejump_hack;
 cvar_t  *sv_waterjump_hack;
@@ -1159,6 +1162,7 @@ static void SVC_DirectConnect(void)
 
     // parse some info from the info strings
     Q_strlcpy(newcl->userinfo, userinfo, sizeof(newcl->userinfo));
+    newcl->infocache.valid = false;
     SV_UserinfoChanged(newcl);
 
     // send the connect packet to the client
@@ -1904,6 +1908,143 @@ static void SV_MasterShutdown(void)
     }
 }
 
+/*
+==============================================================================
+
+FRAME SCHEDULING
+
+==============================================================================
+*/
+
+#define JITTER_BUCKETS  8
+
+static const unsigned jitter_limits[JITTER_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2000, 5000
+};
+
+static struct {
+    uint64_t    last;       // start time of last frame, microseconds
+    uint64_t    total;      // sum of all deviations
+    unsigned    max;        // largest deviation
+    unsigned    frames;
+    unsigned    buckets[JITTER_BUCKETS];
+} sv_jitter;
+
+// records deviation of actual interval between frame starts from nominal
+static void record_jitter(uint64_t now)
+{
+    uint64_t expected = SV_FRAMETIME * 1000;
+    uint64_t delta, dev;
+    int i;
+
+    if (sv_jitter.last && now > sv_jitter.last) {
+        delta = now - sv_jitter.last;
+        dev = delta > expected ? delta - expected : expected - delta;
+
+        for (i = 0; i < JITTER_BUCKETS - 1; i++)
+            if (dev < jitter_limits[i])
+                break;
+
+        sv_jitter.buckets[i]++;
+        sv_jitter.frames++;
+        sv_jitter.total += dev;
+        sv_jitter.max = max(sv_jitter.max, dev);
+    }
+
+    sv_jitter.last = now;
+}
+
+static bool hires_timer_enabled(void)
+{
+    return COM_DEDICATED && sv_hires_timer->integer;
+}
+
+/*
+==================
+SV_FrameJitter_f
+==================
+*/
+void SV_FrameJitter_f(void)
+{
+    unsigned lo, count;
+    int i;
+
+    if (Cmd_Argc() > 1) {
+        if (strcmp(Cmd_Argv(1), "reset")) {
+            Com_Printf("Usage: %s [reset]\n", Cmd_Argv(0));
+            return;
+        }
+        memset(&sv_jitter, 0, sizeof(sv_jitter));
+        Com_Printf("Frame jitter statistics reset.\n");
+        return;
+    }
+
+    if (!sv_jitter.frames) {
+        Com_Printf("No frames recorded.\n");
+        return;
+    }
+
+    Com_Printf("%u frames, %u usec period, %s timer\n"
+               "deviation      frames    pct\n"
+               "------------- --------- ------\n",
+               sv_jitter.frames, SV_FRAMETIME * 1000,
+               hires_timer_enabled() ? "hires" : "msec");
+
+    for (i = 0, lo = 0; i < JITTER_BUCKETS; i++) {
+        count = sv_jitter.buckets[i];
+        if (i < JITTER_BUCKETS - 1) {
+            Com_Printf("%5u-%-5u us %9u %5.1f%%\n", lo, jitter_limits[i] - 1,
+                       count, count * 100.0f / sv_jitter.frames);
+            lo = jitter_limits[i];
+        } else {
+            Com_Printf("%5u+      us %9u %5.1f%%\n", lo,
+                       count, count * 100.0f / sv_jitter.frames);
+        }
+    }
+
+    Com_Printf("mean %u us, max %u us\n",
+               (unsigned)(sv_jitter.total / sv_jitter.frames), sv_jitter.max);
+}
+
+/*
+==================
+SV_FrameDeadline
+
+Returns absolute time in microseconds next server frame is scheduled at,
+or 0 if high resolution scheduling is disabled.
+==================
+*/
+uint64_t SV_FrameDeadline(void)
+{
+    uint64_t pace;
+
+    if (!hires_timer_enabled())
+        return 0;
+
+    // wake up for releasing paced packets, too
+    pace = SV_PaceDeadline();
+    if (pace && pace < sv.framedeadline)
+        return pace;
+
+    return sv.framedeadline;
+}
+
+// don't oversleep release time of paced packets
+static unsigned pace_sleep(unsigned msec)
+{
+    uint64_t pace = SV_PaceDeadline();
+    uint64_t now;
+
+    if (pace) {
+        now = Sys_Microseconds();
+        if (pace <= now)
+            return 0;
+        msec = min(msec, (pace - now + 999) / 1000);
+    }
+
+    return msec;
+}
+
 /*
 ==================
 SV_Frame
@@ -1916,6 +2057,9 @@ Returns amount of extra frametime available for sleeping on IO.
 */
 unsigned SV_Frame(unsigned msec)
 {
+    bool hires = hires_timer_enabled();
+    uint64_t now;
+
 #if USE_CLIENT
     time_before_game = time_after_game = 0;
 #endif
@@ -1945,14 +2089,30 @@ unsigned SV_Frame(unsigned msec)
 
         // deliver fragments and reliable messages for connecting clients
         SV_SendAsyncPackets();
+
+        // release datagrams queued for paced transmission
+        SV_SendPacedPackets();
     }
 
     // move autonomous things around if enough time has passed
-    sv.frameresidual += msec;
-    if (sv.frameresidual < SV_FRAMETIME) {
-        return SV_FRAMETIME - sv.frameresidual;
+    now = Sys_Microseconds();
+    if (hires) {
+        if (!sv.framedeadline) {
+            sv.framedeadline = now;
+        }
+        if (now < sv.framedeadline) {
+            return (sv.framedeadline - now + 999) / 1000;
+        }
+    } else {
+        sv.framedeadline = 0;
+        sv.frameresidual += msec;
+        if (sv.frameresidual < SV_FRAMETIME) {
+            return pace_sleep(SV_FRAMETIME - sv.frameresidual);
+        }
     }
 
+    record_jitter(now);
+
     if (svs.initialized && !check_paused()) {
         // check timeouts
         SV_CheckTimeouts();
@@ -1985,9 +2145,26 @@ unsigned SV_Frame(unsigned msec)
     }
 
     // decide how long to sleep next frame
+    if (hires) {
+        // deadline is absolute, so oversleeping one frame is compensated
+        // by sleeping less on the next one and frame rate doesn't drift
+        sv.framedeadline += SV_FRAMETIME * 1000;
+        now = Sys_Microseconds();
+        if (now < sv.framedeadline) {
+            return (sv.framedeadline - now + 999) / 1000;
+        }
+
+        // don't try to catch up after a long stall
+        if (now - sv.framedeadline > 250000) {
+            Com_DDDPrintf("Reset deadline\n");
+            sv.framedeadline = now;
+        }
+        return 0;
+    }
+
     sv.frameresidual -= SV_FRAMETIME;
     if (sv.frameresidual < SV_FRAMETIME) {
-        return SV_FRAMETIME - sv.frameresidual;
+        return pace_sleep(SV_FRAMETIME - sv.frameresidual);
     }
 
     // don't accumulate bogus residual
@@ -2001,6 +2178,89 @@ unsigned SV_Frame(unsigned msec)
 
 //============================================================================
 
+static void cache_userinfo(client_t *cl)
+{
+    info_cache_t *cache = &cl->infocache;
+    char *s, *key, *value;
+    unsigned hash;
+
+    svs.lookups.info_parses++;
+
+    cache->valid = true;
+    cache->overflowed = false;
+    cache->numpairs = 0;
+    memset(cache->hash, 0, sizeof(cache->hash));
+
+    Q_strlcpy(cache->buffer, cl->userinfo, sizeof(cache->buffer));
+    s = cache->buffer;
+    if (*s == '\\')
+        s++;
+
+    while (*s) {
+        key = s;
+        s = strchr(s, '\\');
+        if (!s)
+            break;  // key without value
+        *s++ = 0;
+
+        value = s;
+        s += strcspn(s, "\\");
+        if (*s)
+            *s++ = 0;
+
+        if (cache->numpairs == INFO_CACHE_PAIRS) {
+            cache->overflowed = true;
+            break;
+        }
+
+        // first occurrence of the key wins, like with Info_ValueForKey()
+        hash = Com_HashString(key, INFO_CACHE_HASH);
+        while (cache->hash[hash]) {
+            if (!strcmp(cache->buffer + cache->keys[cache->hash[hash] - 1], key))
+                break;
+            hash = (hash + 1) & (INFO_CACHE_HASH - 1);
+        }
+        if (cache->hash[hash])
+            continue;
+
+        cache->keys[cache->numpairs] = key - cache->buffer;
+        cache->values[cache->numpairs] = value - cache->buffer;
+        cache->hash[hash] = ++cache->numpairs;
+    }
+}
+
+/*
+=================
+SV_UserinfoValue
+
+Returns value for the key in client userinfo, or empty string. Userinfo is
+parsed once after each change, instead of on every lookup.
+=================
+*/
+const char *SV_UserinfoValue(client_t *cl, const char *key)
+{
+    info_cache_t *cache = &cl->infocache;
+    unsigned hash;
+    int i;
+
+    svs.lookups.info_lookups++;
+
+    if (!cache->valid)
+        cache_userinfo(cl);
+
+    if (cache->overflowed)
+        return Info_ValueForKey(cl->userinfo, key);
+
+    hash = Com_HashString(key, INFO_CACHE_HASH);
+    while ((i = cache->hash[hash])) {
+        if (!strcmp(cache->buffer + cache->keys[i - 1], key))
+            return cache->buffer + cache->values[i - 1];
+        hash = (hash + 1) & (INFO_CACHE_HASH - 1);
+    }
+
+    return "";
+}
+
 /*
 =================
 SV_UserinfoChanged
@@ -2012,15 +2272,18 @@ into a more C friendly form.
 void SV_UserinfoChanged(client_t *cl)
 {
     char    name[MAX_CLIENT_NAME];
-    char    *val;
+    const char  *val;
     size_t  len;
     int     i;
 
     // call prog code to allow overrides
     ge->ClientUserinfoChanged(cl->edict, cl->userinfo);
 
+    // game may have rewritten userinfo, cached values are stale
+    cl->infocache.valid = false;
+
     // name for C code
-    val = Info_ValueForKey(cl->userinfo, "name");
+    val = SV_UserinfoValue(cl, "name");
     len = Q_strlcpy(name, val, sizeof(name));
     if (len >= sizeof(name)) {
         len = sizeof(name) - 1;
@@ -2047,7 +2310,7 @@ void SV_UserinfoChanged(client_t *cl)
     memcpy(cl->name, name, len + 1);
 
     // rate command
-    val = Info_ValueForKey(cl->userinfo, "rate");
+    val = SV_UserinfoValue(cl, "rate");
     if (*val) {
         cl->rate = Q_clip(Q_atoi(val), sv_min_rate->integer, sv_max_rate->integer);
     } else {
@@ -2066,7 +2329,7 @@ void SV_UserinfoChanged(client_t *cl)
     }
 
     // msg command
-    val = Info_ValueForKey(cl->userinfo, "msg");
+    val = SV_UserinfoValue(cl, "msg");
     if (*val) {
         cl->messagelevel = Q_clip(Q_atoi(val), PRINT_LOW, 256);
     }
@@ -2214,6 +2477,8 @@ void SV_Init(void)
 #if USE_FPS
     sv_fps = Cvar_Get("sv_fps", "10", CVAR_LATCH);
 #endif
+    sv_hires_timer = Cvar_Get("sv_hires_timer", "0", 0);
+    sv_pace_window = Cvar_Get("sv_pace_window", "0", 0);
     sv_force_reconnect = Cvar_Get("sv_force_reconnect", "", CVAR_LATCH);
     sv_show_name_changes = Cvar_Get("sv_show_name_changes", "0", 0);
 
@@ -2242,6 +2507,7 @@ void SV_Init(void)
     sv_max_packet_entities = Cvar_Get("sv_max_packet_entities", "0", 0);
     sv_trunc_packet_entities = Cvar_Get("sv_trunc_packet_entities", "1", 0);
     sv_prioritize_entities = Cvar_Get("sv_prioritize_entities", "0", 0);
+    sv_share_frames = Cvar_Get("sv_share_frames", "1", 0);
 
     sv_strafejump_hack = Cvar_Get("sv_strafejump_hack", "1", CVAR_LATCH);
     sv_waterjump_hack = Cvar_Get("sv_waterjump_hack", "1", CVAR_LATCH);
@@ -2397,6 +2663,7 @@ void SV_Shutdown(const char *finalmsg, error_type_t type)
 
     // free server static data
     Z_Free(svs.client_pool);
+    SV_FreeEntityArena();
 #if USE_ZLIB
     deflateEnd(&svs.z);
     Z_Free(svs.z_buffer);
@@ -43,6 +43,7 @@ typedef struct {
     unsigned    flags;
     unsigned    maxbuf;
     unsigned    bufcount;
+    int         relay_id;   // channel this client has gamestate for
 
     byte        buffer[MAX_GTC_MSGLEN + 4]; // recv buffer
     byte        *data; // send buffer
@@ -54,6 +55,7 @@ typedef struct {
 typedef struct {
     bool            enabled;
     bool            active;
+    bool            relay;      // forwarding MVD client channel
     client_t        *dummy;
     unsigned        layout_time;
     unsigned        clients_active;
@@ -80,6 +82,7 @@ typedef struct {
     // TCP client pool
     int             maxclients;
     gtv_client_t    *clients; // [sv_mvd_maxclients]
+    unsigned        timeout_time;
 } mvd_server_t;
 
 static mvd_server_t     mvd;
@@ -109,12 +112,16 @@ static cvar_t   *sv_mvd_disconnect_time;
 static cvar_t   *sv_mvd_suspend_time;
 static cvar_t   *sv_mvd_allow_stufftext;
 static cvar_t   *sv_mvd_spawn_dummy;
+#if USE_MVD_CLIENT
+static cvar_t   *sv_mvd_relay;
+#endif
 
 static bool     mvd_enable(void);
 static void     mvd_disable(void);
 static void     mvd_error(const char *reason);
 
 static void     write_stream(gtv_client_t *client, void *data, size_t len);
+static void     write_streamv(gtv_client_t *client, const fifo_vec_t *vec, int count);
 static void     write_message(gtv_client_t *client, gtv_serverop_t op);
 #if USE_ZLIB
 static void     flush_stream(gtv_client_t *client, int flush);
@@ -412,6 +419,7 @@ static int dummy_create(void)
 
     // parse some info from the info strings
     Q_strlcpy(newcl->userinfo, userinfo, sizeof(newcl->userinfo));
+    newcl->infocache.valid = false;
     SV_UserinfoChanged(newcl);
 
     return 1;
@@ -1013,6 +1021,7 @@ void SV_MvdEndFrame(void)
     gtv_client_t *client;
     size_t total;
     byte header[3];
+    fifo_vec_t vec[4];
 
     if (!SV_FRAMESYNC)
         return;
@@ -1061,12 +1070,18 @@ void SV_MvdEndFrame(void)
     WL16(header, total + 1);
     header[2] = GTS_STREAM_DATA;
 
+    vec[0].data = header;
+    vec[0].len = sizeof(header);
+    vec[1].data = mvd.message.data;
+    vec[1].len = mvd.message.cursize;
+    vec[2].data = msg_write.data;
+    vec[2].len = msg_write.cursize;
+    vec[3].data = mvd.datagram.data;
+    vec[3].len = mvd.datagram.cursize;
+
     // send frame to clients
     FOR_EACH_ACTIVE_GTV(client) {
-        write_stream(client, header, sizeof(header));
-        write_stream(client, mvd.message.data, mvd.message.cursize);
-        write_stream(client, msg_write.data, msg_write.cursize);
-        write_stream(client, mvd.datagram.data, mvd.datagram.cursize);
+        write_streamv(client, vec, q_countof(vec));
 #if USE_ZLIB
         if (++client->bufcount > client->maxbuf) {
             flush_stream(client, Z_SYNC_FLUSH);
@@ -1432,15 +1447,41 @@ static void write_stream(gtv_client_t *client, void *data, size_t len)
     }
 }
 
+// Writes multiple buffers at once. Uncompressed data is gathered directly
+// into send FIFO, so that message is either queued entirely or not at all.
+static void write_streamv(gtv_client_t *client, const fifo_vec_t *vec, int count)
+{
+    if (client->state <= cs_zombie) {
+        return;
+    }
+
+#if USE_ZLIB
+    if (client->z.state) {
+        for (int i = 0; i < count; i++) {
+            write_stream(client, vec[i].data, vec[i].len);
+        }
+        return;
+    }
+#endif
+
+    if (!FIFO_Writev(&client->stream.send, vec, count)) {
+        drop_client(client, "overflowed");
+    }
+}
+
 static void write_message(gtv_client_t *client, gtv_serverop_t op)
 {
     byte header[3];
+    fifo_vec_t vec[2];
 
     WL16(header, msg_write.cursize + 1);
     header[2] = op;
-    write_stream(client, header, sizeof(header));
 
-    write_stream(client, msg_write.data, msg_write.cursize);
+    vec[0].data = header;
+    vec[0].len = sizeof(header);
+    vec[1].data = msg_write.data;
+    vec[1].len = msg_write.cursize;
+    write_streamv(client, vec, q_countof(vec));
 }
 
 static bool auth_client(const gtv_client_t *client, const char *password)
@@ -1559,7 +1600,10 @@ static void parse_stream_start(gtv_client_t *client)
         return;
     }
 
-    if (!mvd_enable()) {
+    if (mvd.relay) {
+        // gamestate will be sent along with the next relayed message
+        client->relay_id = -1;
+    } else if (!mvd_enable()) {
         write_message(client, GTS_ERROR);
         drop_client(client, "couldn't create MVD dummy");
         return;
@@ -1777,6 +1821,7 @@ static void accept_client(netstream_t *stream)
     s->socket = stream->socket;
     s->address = stream->address;
     s->state = stream->state;
+    NET_SetPollFdData(s->socket, client);
 
     client->lastmessage = svs.realtime;
     client->state = cs_assigned;
@@ -1787,12 +1832,70 @@ static void accept_client(netstream_t *stream)
                 NET_AdrToString(&stream->address));
 }
 
+// returns true if client was removed
+static bool check_timeout(gtv_client_t *client)
+{
+    unsigned delta = svs.realtime - client->lastmessage;
+
+    switch (client->state) {
+    case cs_zombie:
+        if (delta > sv_zombietime->integer || !FIFO_Usage(&client->stream.send)) {
+            remove_client(client);
+            return true;
+        }
+        break;
+    case cs_assigned:
+    case cs_connected:
+        if (delta > sv_ghostime->integer || delta > sv_timeout->integer) {
+            drop_client(client, "request timed out");
+            remove_client(client);
+            return true;
+        }
+        break;
+    default:
+        if (delta > sv_timeout->integer) {
+            drop_client(client, "connection timed out");
+            remove_client(client);
+            return true;
+        }
+        break;
+    }
+
+    return false;
+}
+
+static void run_client(gtv_client_t *client)
+{
+    neterr_t ret = NET_RunStream(&client->stream);
+
+    switch (ret) {
+    case NET_AGAIN:
+        break;
+    case NET_OK:
+        // parse the message
+        while (parse_message(client))
+            ;
+        NET_UpdateStream(&client->stream);
+        break;
+    case NET_CLOSED:
+        drop_client(client, "EOF from client");
+        remove_client(client);
+        break;
+    case NET_ERROR:
+        drop_client(client, "connection reset by peer");
+        remove_client(client);
+        break;
+    }
+}
+
 void SV_MvdRunClients(void)
 {
     gtv_client_t *client;
+    struct pollfd *e;
     neterr_t    ret;
     netstream_t stream;
-    unsigned    delta;
+    bool        timeouts;
+    int         iter;
 
     if (!mvd.clients) {
         return; // do nothing if disabled
@@ -1807,54 +1910,36 @@ void SV_MvdRunClients(void)
         accept_client(&stream);
     }
 
-    // run existing connections
-    FOR_EACH_GTV(client) {
-        // check timeouts
-        delta = svs.realtime - client->lastmessage;
-        switch (client->state) {
-        case cs_zombie:
-            if (delta > sv_zombietime->integer || !FIFO_Usage(&client->stream.send)) {
-                remove_client(client);
-                continue;
-            }
-            break;
-        case cs_assigned:
-        case cs_connected:
-            if (delta > sv_ghostime->integer || delta > sv_timeout->integer) {
-                drop_client(client, "request timed out");
-                remove_client(client);
-                continue;
+    // check timeouts at most every 100 ms
+    timeouts = svs.realtime - mvd.timeout_time >= 100;
+    if (timeouts) {
+        mvd.timeout_time = svs.realtime;
+    }
+
+    if (NET_TracksReady()) {
+        if (timeouts) {
+            FOR_EACH_GTV(client) {
+                check_timeout(client);
             }
-            break;
-        default:
-            if (delta > sv_timeout->integer) {
-                drop_client(client, "connection timed out");
-                remove_client(client);
-                continue;
+        }
+
+        // run only connections with pending events
+        iter = 0;
+        while ((e = NET_NextReadyPollFd(&iter))) {
+            client = NET_GetPollFdData(e);
+            if (client && client->state > cs_free) {
+                run_client(client);
             }
-            break;
         }
+        return;
+    }
 
-        // run network stream
-        ret = NET_RunStream(&client->stream);
-        switch (ret) {
-        case NET_AGAIN:
-            break;
-        case NET_OK:
-            // parse the message
-            while (parse_message(client))
-                ;
-            NET_UpdateStream(&client->stream);
-            break;
-        case NET_CLOSED:
-            drop_client(client, "EOF from client");
-            remove_client(client);
-            break;
-        case NET_ERROR:
-            drop_client(client, "connection reset by peer");
-            remove_client(client);
-            break;
+    // run existing connections
+    FOR_EACH_GTV(client) {
+        if (timeouts && check_timeout(client)) {
+            continue;
         }
+        run_client(client);
     }
 }
 
@@ -2151,6 +2236,127 @@ void SV_MvdPostInit(void)
     }
 }
 
+#if USE_MVD_CLIENT
+
+/*
+==================
+SV_MvdRelayInit
+
+Server is initializing in MVD client mode. Accept GTV connections and relay
+the MVD client channel to them, if enabled.
+==================
+*/
+void SV_MvdRelayInit(void)
+{
+    neterr_t ret;
+
+    if (!sv_mvd_relay->integer) {
+        return; // do nothing if disabled
+    }
+
+    Cvar_ClampInteger(sv_mvd_maxclients, 1, MAX_CLIENTS);
+
+    // open server TCP socket
+    ret = NET_Listen(true);
+    if (ret != NET_OK) {
+        if (ret == NET_ERROR)
+            Com_EPrintf("Error opening server TCP port.\n");
+        else
+            Com_EPrintf("Server TCP port already in use.\n");
+        return;
+    }
+
+    mvd.maxclients = sv_mvd_maxclients->integer;
+    mvd.clients = SV_Mallocz(sizeof(mvd.clients[0]) * mvd.maxclients);
+    mvd.relay = true;
+}
+
+/*
+==================
+SV_MvdRelayData
+
+MVD client channel has just parsed a message. Forward it to GTV clients
+verbatim. Clients that don't have the gamestate of this channel yet get
+the one rebuilt from parsed channel state instead, which already includes
+effects of this message.
+==================
+*/
+void SV_MvdRelayData(int id, const void *data, size_t len)
+{
+    gtv_client_t *client, *next;
+    byte header[3];
+    fifo_vec_t vec[2];
+    bool gamestate = false;
+
+    if (!mvd.relay) {
+        return;
+    }
+
+    WL16(header, len + 1);
+    header[2] = GTS_STREAM_DATA;
+
+    vec[0].data = header;
+    vec[0].len = sizeof(header);
+    vec[1].data = (void *)data;
+    vec[1].len = len;
+
+    LIST_FOR_EACH_SAFE(gtv_client_t, client, next, &gtv_active_list, active) {
+        if (client->relay_id == id) {
+            write_streamv(client, vec, q_countof(vec));
+#if USE_ZLIB
+            if (++client->bufcount > client->maxbuf) {
+                flush_stream(client, Z_SYNC_FLUSH);
+            }
+#endif
+            NET_UpdateStream(&client->stream);
+            continue;
+        }
+
+        // build gamestate once for all clients that need it
+        if (!gamestate) {
+            MVD_RelayGamestate(id);
+            gamestate = true;
+        }
+
+        if (!msg_write.cursize || msg_write.overflowed) {
+            drop_client(client, "couldn't build relay gamestate");
+            continue;
+        }
+
+        write_message(client, GTS_STREAM_DATA);
+#if USE_ZLIB
+        flush_stream(client, Z_SYNC_FLUSH);
+#endif
+        NET_UpdateStream(&client->stream);
+        client->relay_id = id;
+    }
+
+    if (gamestate) {
+        SZ_Clear(&msg_write);
+    }
+}
+
+/*
+==================
+SV_MvdRelayReset
+
+MVD client channel state has changed without parsing a message (e.g. demo
+seek). Send gamestate again to GTV clients following this channel.
+==================
+*/
+void SV_MvdRelayReset(int id)
+{
+    gtv_client_t *client;
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        if (client->relay_id == id) {
+            client->relay_id = -1;
+        }
+    }
+}
+
+#endif // USE_MVD_CLIENT
+
 /*
 ==================
 SV_MvdShutdown
@@ -2456,6 +2662,9 @@ void SV_MvdRegister(void)
     sv_mvd_suspend_time->changed(sv_mvd_suspend_time);
     sv_mvd_allow_stufftext = Cvar_Get("sv_mvd_allow_stufftext", "0", CVAR_LATCH);
     sv_mvd_spawn_dummy = Cvar_Get("sv_mvd_spawn_dummy", "1", 0);
+#if USE_MVD_CLIENT
+    sv_mvd_relay = Cvar_Get("sv_mvd_relay", "0", CVAR_LATCH);
+#endif
 
     Cmd_Register(c_svmvd);
 }
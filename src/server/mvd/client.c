@@ -106,7 +106,7 @@ int         mvd_chanid;
 bool        mvd_active;
 unsigned    mvd_last_activity;
 
-jmp_buf     mvd_jmpbuf;
+q_thread_local jmp_buf  mvd_jmpbuf;
 
 #if USE_DEBUG
 cvar_t      *mvd_shownet;
@@ -120,6 +120,7 @@ static cvar_t  *mvd_buffer_size;
 static cvar_t  *mvd_username;
 static cvar_t  *mvd_password;
 static cvar_t  *mvd_snaps;
+static cvar_t  *mvd_relay_channel;
 
 // ====================================================================
 
@@ -159,6 +160,7 @@ static void MVD_Free(mvd_t *mvd)
     CM_FreeMap(&mvd->cm);
 
     Z_Free(mvd->delay.data);
+    Z_Free(mvd->msgbuf);
 
     List_Remove(&mvd->entry);
     Z_Free(mvd);
@@ -188,15 +190,8 @@ static void MVD_Destroy(mvd_t *mvd)
     MVD_Free(mvd);
 }
 
-void MVD_Destroyf(mvd_t *mvd, const char *fmt, ...)
+void MVD_Abort(mvd_t *mvd, const char *text)
 {
-    va_list     argptr;
-    char        text[MAXERRORMSG];
-
-    va_start(argptr, fmt);
-    Q_vsnprintf(text, sizeof(text), fmt, argptr);
-    va_end(argptr);
-
     Com_Printf("[%s] =X= %s\n", mvd->name, text);
 
     // notify spectators
@@ -206,6 +201,23 @@ void MVD_Destroyf(mvd_t *mvd, const char *fmt, ...)
     }
 
     MVD_Destroy(mvd);
+}
+
+void MVD_Destroyf(mvd_t *mvd, const char *fmt, ...)
+{
+    va_list     argptr;
+    char        text[MAXERRORMSG];
+
+    va_start(argptr, fmt);
+    Q_vsnprintf(text, sizeof(text), fmt, argptr);
+    va_end(argptr);
+
+    // parser threads can't destroy channels, main thread will do it
+    if (mvd_threaded) {
+        Q_strlcpy(mvd->error, text, sizeof(mvd->error));
+    } else {
+        MVD_Abort(mvd, text);
+    }
 
     longjmp(mvd_jmpbuf, -1);
 }
@@ -699,6 +711,9 @@ static bool demo_read_frame(mvd_t *mvd)
     int count;
     int ret;
 
+    // message returned last time has been parsed by now
+    demo_emit_snapshot(mvd);
+
     if (mvd->state == MVD_WAITING) {
         return false; // paused by user
     }
@@ -731,9 +746,6 @@ static bool demo_read_frame(mvd_t *mvd)
     }
 
     demo_update(gtv);
-
-    MVD_ParseMessage(mvd);
-    demo_emit_snapshot(mvd);
     return true;
 
 next:
@@ -862,12 +874,21 @@ static void write_stream(gtv_t *gtv, void *data, size_t len)
 static void write_message(gtv_t *gtv, gtv_clientop_t op)
 {
     byte header[3];
+    fifo_vec_t vec[2];
 
     WL16(header, msg_write.cursize + 1);
     header[2] = op;
-    write_stream(gtv, header, sizeof(header));
 
-    write_stream(gtv, msg_write.data, msg_write.cursize);
+    vec[0].data = header;
+    vec[0].len = sizeof(header);
+    vec[1].data = msg_write.data;
+    vec[1].len = msg_write.cursize;
+    if (!FIFO_Writev(&gtv->stream.send, vec, q_countof(vec))) {
+        gtv_destroyf(gtv, "Send buffer overflowed");
+    }
+
+    // don't timeout
+    gtv->last_sent = svs.realtime;
 }
 
 static void q_noreturn gtv_oob_kill(mvd_t *mvd)
@@ -999,9 +1020,6 @@ static bool gtv_read_frame(mvd_t *mvd)
 
     // decrement buffered packets counter
     mvd->num_packets--;
-
-    // parse it
-    MVD_ParseMessage(mvd);
     return true;
 }
 
@@ -1228,13 +1246,16 @@ static void parse_stream_data(gtv_t *gtv)
     if (!mvd->state) {
         // parse it in place until we get a gamestate
         MVD_ParseMessage(mvd);
+        MVD_RelayMessage(mvd, msg_read.data + 1, msg_read.cursize - 1);
     } else {
-        byte *data = msg_read.data + 1;
-        size_t len = msg_read.cursize - 1;
-        uint16_t msglen;
-
-        // see if this packet fits
-        if (FIFO_Write(&mvd->delay, NULL, len + 2) != len + 2) {
+        uint16_t msglen = LittleShort(msg_read.cursize - 1);
+        fifo_vec_t vec[2] = {
+            { &msglen, 2 },
+            { msg_read.data + 1, msg_read.cursize - 1 }
+        };
+
+        // write it into delay buffer, if this packet fits
+        if (!FIFO_Writev(&mvd->delay, vec, q_countof(vec))) {
             if (mvd->state == MVD_WAITING) {
                 // if delay buffer overflowed in waiting state,
                 // something is seriously wrong, disconnect for safety
@@ -1264,11 +1285,6 @@ static void parse_stream_data(gtv_t *gtv)
             return;
         }
 
-        // write it into delay buffer
-        msglen = LittleShort(len);
-        FIFO_Write(&mvd->delay, &msglen, 2);
-        FIFO_Write(&mvd->delay, data, len);
-
         // increment buffered packets counter
         mvd->num_packets++;
 
@@ -1891,12 +1907,12 @@ static void emit_gamestate(mvd_t *mvd)
     if (mvd->version >= PROTOCOL_VERSION_MVD_EXTENDED_LIMITS_2) {
         MSG_WriteByte(mvd_serverdata);
         MSG_WriteLong(PROTOCOL_VERSION_MVD);
-        MSG_WriteLong(mvd->version);
+        MSG_WriteShort(mvd->version);
         MSG_WriteShort(mvd->flags);
     } else {
         MSG_WriteByte(mvd_serverdata | (mvd->flags << SVCMD_BITS));
         MSG_WriteLong(PROTOCOL_VERSION_MVD);
-        MSG_WriteLong(mvd->version);
+        MSG_WriteShort(mvd->version);
     }
     MSG_WriteLong(mvd->servercount);
     MSG_WriteString(mvd->gamedir);
@@ -1921,6 +1937,43 @@ static void emit_gamestate(mvd_t *mvd)
     // TODO: write private layouts/configstrings
 }
 
+// Checks if the channel is the one named by mvd_relay_channel.
+static bool relay_channel(const mvd_t *mvd)
+{
+    const char *s = mvd_relay_channel->string;
+
+    if (COM_IsUint(s)) {
+        return mvd->id == Q_atoi(s);
+    }
+
+    return !strcmp(mvd->name, s);
+}
+
+// Forwards message just parsed by the channel to GTV clients of this server.
+// Only the single channel named by mvd_relay_channel is relayed, messages of
+// other channels are not forwarded.
+void MVD_RelayMessage(mvd_t *mvd, const void *data, size_t len)
+{
+    if (mvd->state && relay_channel(mvd)) {
+        SV_MvdRelayData(mvd->id, data, len);
+    }
+}
+
+// Writes gamestate of the relayed channel for GTV clients that join late.
+bool MVD_RelayGamestate(int id)
+{
+    mvd_t *mvd;
+
+    FOR_EACH_MVD(mvd) {
+        if (mvd->id == id && mvd->state) {
+            emit_gamestate(mvd);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void MVD_StreamedRecord_f(void)
 {
     char buffer[MAX_OSPATH];
@@ -2446,6 +2499,9 @@ static void MVD_Seek_f(void)
 
 done:
     mvd->demoseeking = false;
+
+    // relayed GTV clients need new gamestate after seeking
+    SV_MvdRelayReset(mvd->id);
 }
 
 static void MVD_Control_f(void)
@@ -2718,6 +2774,7 @@ void MVD_Register(void)
     mvd_username = Cvar_Get("mvd_username", "unnamed", 0);
     mvd_password = Cvar_Get("mvd_password", "", CVAR_PRIVATE);
     mvd_snaps = Cvar_Get("mvd_snaps", "10", 0);
+    mvd_relay_channel = Cvar_Get("mvd_relay_channel", "0", 0);
 
     Cmd_Register(c_mvd);
 }
@@ -134,7 +134,7 @@ typedef struct mvd_s {
     int             id;
     char            name[MAX_MVD_NAME];
     struct gtv_s    *gtv;
-    bool            (*read_frame)(struct mvd_s *);
+    bool            (*read_frame)(struct mvd_s *); // loads next message into msg_read
     bool            (*forward_cmd)(mvd_client_t *);
 
     // demo related variables
@@ -182,6 +182,12 @@ typedef struct mvd_s {
 
     // UDP client list
     list_t      clients;
+
+    // message saved for parallel parsing
+    sizebuf_t   msg;
+    byte        *msgbuf;
+    int         deferred;   // offset of gamestate left for main thread, or -1
+    char        error[MAX_STRING_CHARS];
 } mvd_t;
 
 
@@ -196,7 +202,7 @@ extern bool         mvd_dirty;
 extern bool         mvd_active;
 extern unsigned     mvd_last_activity;
 
-extern jmp_buf  mvd_jmpbuf;
+extern q_thread_local jmp_buf   mvd_jmpbuf;
 
 #if USE_DEBUG
 extern cvar_t    *mvd_shownet;
@@ -204,6 +210,7 @@ extern cvar_t    *mvd_shownet;
 
 q_noreturn q_printf(2, 3)
 void MVD_Destroyf(mvd_t *mvd, const char *fmt, ...);
+void MVD_Abort(mvd_t *mvd, const char *text);
 void MVD_Shutdown(void);
 
 mvd_t *MVD_SetChannel(int arg);
@@ -216,6 +223,7 @@ void MVD_StopRecord(mvd_t *mvd);
 
 void MVD_StreamedStop_f(void);
 void MVD_StreamedRecord_f(void);
+void MVD_RelayMessage(mvd_t *mvd, const void *data, size_t len);
 
 void MVD_Register(void);
 int MVD_Frame(void);
@@ -233,6 +241,10 @@ void MVD_ClearState(mvd_t *mvd, bool full);
 //
 
 extern mvd_client_t     *mvd_clients;   // [maxclients]
+extern bool             mvd_threaded;
+
+void MVD_LockParse(void);
+void MVD_UnlockParse(void);
 
 void MVD_SwitchChannel(mvd_client_t *client, mvd_t *mvd);
 void MVD_RemoveClient(client_t *client);
@@ -21,6 +21,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //
 
 #include "client.h"
+#include "common/jobs.h"
+#include "server/mvd/protocol.h"
 
 static cvar_t   *mvd_admin_password;
 static cvar_t   *mvd_part_filter;
@@ -33,9 +35,14 @@ static cvar_t   *mvd_stats_score;
 static cvar_t   *mvd_stats_hack;
 static cvar_t   *mvd_freeze_hack;
 static cvar_t   *mvd_chase_prefix;
+static cvar_t   *mvd_parallel;
 
 mvd_client_t    *mvd_clients;
 
+bool            mvd_threaded;   // channels are being parsed in parallel
+
+static q_thread_local int   mvd_lockdepth;
+
 mvd_player_t    mvd_dummy;
 
 static int      mvd_numplayers;
@@ -462,8 +469,10 @@ static void MVD_FollowStop(mvd_client_t *client)
     client->ps.fov = client->fov;
 
     // send delta configstrings
+    MVD_LockParse();
     if (mvd->dummy)
         MVD_WriteStringList(client, mvd->dummy->configstrings);
+    MVD_UnlockParse();
 
     client->clientNum = mvd->clientNum;
     client->oldtarget = client->target;
@@ -486,9 +495,11 @@ static void MVD_FollowStart(mvd_client_t *client, mvd_player_t *target)
     client->target = target;
 
     // send delta configstrings
+    MVD_LockParse();
     MVD_WriteStringList(client, target->configstrings);
 
     SV_ClientPrintf(client->cl, PRINT_LOW, "[MVD] Chasing %s.\n", target->name);
+    MVD_UnlockParse();
 
     MVD_SetFollowLayout(client);
     MVD_UpdateClient(client);
@@ -1790,6 +1801,7 @@ static void MVD_GameInit(void)
     mvd_stats_hack = Cvar_Get("mvd_stats_hack", "0", 0);
     mvd_freeze_hack = Cvar_Get("mvd_freeze_hack", "1", 0);
     mvd_chase_prefix = Cvar_Get("mvd_chase_prefix", "xv 0 yb -64", 0);
+    mvd_parallel = Cvar_Get("mvd_parallel", "0", 0);
     Cvar_Set("g_features", va("%d", MVD_FEATURES));
 
     mvd_clients = MVD_Mallocz(sizeof(mvd_clients[0]) * svs.maxclients);
@@ -1975,9 +1987,10 @@ static void MVD_GameClientUserinfoChanged(edict_t *ent, char *userinfo)
     mvd_client_t *client = EDICT_MVDCL(ent);
     int fov;
 
-    client->uf = Q_atoi(Info_ValueForKey(userinfo, "uf"));
+    // userinfo is client->cl->userinfo, use server side cache
+    client->uf = Q_atoi(SV_UserinfoValue(client->cl, "uf"));
 
-    fov = Q_atoi(Info_ValueForKey(userinfo, "fov"));
+    fov = Q_atoi(SV_UserinfoValue(client->cl, "fov"));
     if (fov < 1) {
         fov = 90;
     } else if (fov > 160) {
@@ -2226,6 +2239,8 @@ static void MVD_NotifyClient(mvd_client_t *client)
     if (svs.realtime - client->begin_time < 2000)
         return;
 
+    MVD_LockParse();
+
     // notify them if visibility data is missing
     if (!mvd->cm.cache) {
         SV_ClientPrintf(client->cl, PRINT_HIGH,
@@ -2238,6 +2253,8 @@ static void MVD_NotifyClient(mvd_client_t *client)
                         "[MVD] Buffering data, please wait...\n");
     }
 
+    MVD_UnlockParse();
+
     client->notified = true;
 }
 
@@ -2249,10 +2266,14 @@ void MVD_UpdateClients(mvd_t *mvd)
         && mvd->dummy && mvd->dummy->ps.pmove.pm_type == PM_FREEZE;
 
     // check for intermission
-    if (!mvd->intermission && intermission)
-        MVD_IntermissionStart(mvd);
-    else if (mvd->intermission && !intermission)
-        MVD_IntermissionStop(mvd);
+    if (mvd->intermission != intermission) {
+        MVD_LockParse();
+        if (intermission)
+            MVD_IntermissionStart(mvd);
+        else
+            MVD_IntermissionStop(mvd);
+        MVD_UnlockParse();
+    }
 
     // update UDP clients
     FOR_EACH_MVDCL(client, mvd) {
@@ -2282,10 +2303,124 @@ fail:
     MVD_StopRecord(mvd);
 }
 
-static void MVD_GameRunFrame(void)
+/*
+==============================================================================
+
+PARALLEL PARSING
+
+Messages are read from all channels serially, then parsed in parallel.
+Decoding and per-channel state updates run concurrently. Only the parts
+that write to shared state (msg_write, client message queues, zone, console,
+area flood state) are serialized with MVD_LockParse. Gamestate may respawn
+the server, so parsing stops there and the rest of the message is parsed
+serially after the join. Errors are recorded and channels destroyed after
+the join.
+
+==============================================================================
+*/
+
+void MVD_LockParse(void)
+{
+    if (mvd_threaded && mvd_lockdepth++ == 0)
+        Com_LockJobs();
+}
+
+void MVD_UnlockParse(void)
+{
+    if (mvd_lockdepth && --mvd_lockdepth == 0)
+        Com_UnlockJobs();
+}
+
+static void MVD_ParseJob(void *arg, int index, int thread)
+{
+    mvd_t *mvd = ((mvd_t **)arg)[index];
+
+    if (setjmp(mvd_jmpbuf)) {
+        // error may happen with the lock held
+        if (mvd_lockdepth) {
+            mvd_lockdepth = 0;
+            Com_UnlockJobs();
+        }
+        return;
+    }
+
+    msg_read = mvd->msg;
+    MVD_ParseMessage(mvd);
+}
+
+static void MVD_SaveMessage(mvd_t *mvd)
+{
+    if (!mvd->msgbuf) {
+        mvd->msgbuf = MVD_Malloc(MAX_MSGLEN);
+    }
+
+    memcpy(mvd->msgbuf, msg_read.data, msg_read.cursize);
+    mvd->msg = msg_read;
+    mvd->msg.data = mvd->msgbuf;
+    mvd->deferred = -1;
+    mvd->error[0] = 0;
+}
+
+static void MVD_ReadChannelsParallel(void)
+{
+    mvd_t *mvd, *next, **pending;
+    int i, count = 0;
+
+    pending = MVD_Malloc(sizeof(pending[0]) * List_Count(&mvd_channel_list));
+
+    LIST_FOR_EACH_SAFE(mvd_t, mvd, next, &mvd_channel_list, entry) {
+        if (setjmp(mvd_jmpbuf)) {
+            continue;
+        }
+
+        // read stream
+        if (!mvd->read_frame(mvd)) {
+            continue;
+        }
+
+        MVD_SaveMessage(mvd);
+        pending[count++] = mvd;
+    }
+
+    // parse all messages
+    mvd_threaded = true;
+    Com_ParallelFor(MVD_ParseJob, pending, count);
+    mvd_threaded = false;
+
+    for (i = 0; i < count; i++) {
+        mvd = pending[i];
+
+        if (mvd->error[0]) {
+            MVD_Abort(mvd, mvd->error);
+            continue;
+        }
+
+        // parse the rest of message starting with gamestate
+        if (mvd->deferred >= 0) {
+            if (setjmp(mvd_jmpbuf)) {
+                continue;
+            }
+            msg_read = mvd->msg;
+            msg_read.readcount = mvd->deferred;
+            MVD_ParseMessage(mvd);
+        }
+
+        // write this message to demofile
+        if (mvd->demorecording) {
+            msg_read = mvd->msg;
+            MVD_WriteDemoMessage(mvd);
+        }
+
+        // forward this message to GTV clients
+        MVD_RelayMessage(mvd, mvd->msg.data, mvd->msg.cursize);
+    }
+
+    Z_Free(pending);
+}
+
+static void MVD_ReadChannels(void)
 {
     mvd_t *mvd, *next;
-    int numplayers = 0;
 
     LIST_FOR_EACH_SAFE(mvd_t, mvd, next, &mvd_channel_list, entry) {
         if (setjmp(mvd_jmpbuf)) {
@@ -2294,15 +2429,53 @@ static void MVD_GameRunFrame(void)
 
         // parse stream
         if (!mvd->read_frame(mvd)) {
-            goto update;
+            continue;
         }
 
+        MVD_ParseMessage(mvd);
+
         // write this message to demofile
         if (mvd->demorecording) {
             MVD_WriteDemoMessage(mvd);
         }
 
-update:
+        // forward this message to GTV clients
+        MVD_RelayMessage(mvd, msg_read.data, msg_read.cursize);
+    }
+}
+
+static bool MVD_UseParallel(void)
+{
+    if (!mvd_parallel->integer)
+        return false;
+
+    if (Com_JobThreads() < 2)
+        return false;
+
+    if (LIST_EMPTY(&mvd_channel_list) || LIST_SINGLE(&mvd_channel_list))
+        return false;
+
+#if USE_DEBUG
+    // keep debug output in order
+    if (mvd_shownet->integer)
+        return false;
+#endif
+
+    return true;
+}
+
+static void MVD_GameRunFrame(void)
+{
+    mvd_t *mvd;
+    int numplayers = 0;
+
+    if (MVD_UseParallel()) {
+        MVD_ReadChannelsParallel();
+    } else {
+        MVD_ReadChannels();
+    }
+
+    FOR_EACH_MVD(mvd) {
         MVD_UpdateLayouts(mvd);
         numplayers += mvd->numplayers;
     }
@@ -23,7 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client.h"
 #include "server/mvd/protocol.h"
 
-static bool match_ended_hack;
+static q_thread_local bool match_ended_hack;
 
 #if USE_DEBUG
 #define SHOWNET(level, ...) \
@@ -159,6 +159,7 @@ static void MVD_ParseMulticast(mvd_t *mvd, multicast_t to, int extrabits)
     }
 
     // send the data to all relevant clients
+    MVD_LockParse();
     FOR_EACH_MVDCL(client, mvd) {
         cl = client->cl;
         if (cl->state < cs_primed) {
@@ -183,6 +184,7 @@ static void MVD_ParseMulticast(mvd_t *mvd, multicast_t to, int extrabits)
 
         cl->AddMessage(cl, data, length, reliable);
     }
+    MVD_UnlockParse();
 }
 
 static void MVD_UnicastSend(mvd_t *mvd, bool reliable, const byte *data, size_t length, mvd_player_t *player)
@@ -192,6 +194,7 @@ static void MVD_UnicastSend(mvd_t *mvd, bool reliable, const byte *data, size_t
     client_t *cl;
 
     // send to all relevant clients
+    MVD_LockParse();
     FOR_EACH_MVDCL(client, mvd) {
         cl = client->cl;
         if (cl->state < cs_spawned) {
@@ -202,6 +205,7 @@ static void MVD_UnicastSend(mvd_t *mvd, bool reliable, const byte *data, size_t
             cl->AddMessage(cl, data, length, reliable);
         }
     }
+    MVD_UnlockParse();
 }
 
 static void MVD_UnicastLayout(mvd_t *mvd, mvd_player_t *player)
@@ -253,11 +257,15 @@ static void MVD_UnicastString(mvd_t *mvd, bool reliable, mvd_player_t *player)
         MVD_Destroyf(mvd, "%s: bad index: %d", __func__, index);
     }
     if (index < mvd->csr->general) {
+        MVD_LockParse();
         Com_DPrintf("%s: common configstring: %d\n", __func__, index);
+        MVD_UnlockParse();
         return;
     }
     if (length >= sizeof(string)) {
+        MVD_LockParse();
         Com_DPrintf("%s: oversize configstring: %d\n", __func__, index);
+        MVD_UnlockParse();
         return;
     }
 
@@ -267,7 +275,9 @@ static void MVD_UnicastString(mvd_t *mvd, bool reliable, mvd_player_t *player)
         }
     }
     if (!cs) {
+        MVD_LockParse();
         cs = MVD_Malloc(sizeof(*cs) + MAX_QPATH - 1);
+        MVD_UnlockParse();
         cs->index = index;
         cs->next = player->configstrings;
         player->configstrings = cs;
@@ -303,6 +313,7 @@ static void MVD_UnicastPrint(mvd_t *mvd, bool reliable, mvd_player_t *player)
     length = msg_read.readcount - readcount;
 
     // send to all relevant clients
+    MVD_LockParse();
     FOR_EACH_MVDCL(client, mvd) {
         cl = client->cl;
         if (cl->state < cs_spawned) {
@@ -320,6 +331,7 @@ static void MVD_UnicastPrint(mvd_t *mvd, bool reliable, mvd_player_t *player)
             cl->AddMessage(cl, data, length, reliable);
         }
     }
+    MVD_UnlockParse();
 }
 
 static void MVD_UnicastStuff(mvd_t *mvd, bool reliable, mvd_player_t *player)
@@ -457,7 +469,9 @@ static void MVD_ParseSound(mvd_t *mvd, int extrabits)
 
     entity = &mvd->edicts[entnum];
     if (!entity->inuse) {
+        MVD_LockParse();
         Com_DPrintf("%s: entnum not in use: %d\n", __func__, entnum);
+        MVD_UnlockParse();
         return;
     }
 
@@ -473,6 +487,7 @@ static void MVD_ParseSound(mvd_t *mvd, int extrabits)
     }
 
     // prepare multicast message
+    MVD_LockParse();
     MSG_WriteByte(svc_sound);
     MSG_WriteByte(flags | SND_POS);
     if (mvd->csr->extended && flags & SND_INDEX16)
@@ -555,6 +570,7 @@ static void MVD_ParseSound(mvd_t *mvd, int extrabits)
 
     // clear multicast buffer
     SZ_Clear(&msg_write);
+    MVD_UnlockParse();
 }
 
 static void MVD_ParseConfigstring(mvd_t *mvd)
@@ -579,7 +595,9 @@ static void MVD_ParseConfigstring(mvd_t *mvd)
         return;
     }
 
+    MVD_LockParse();
     MVD_UpdateConfigstring(mvd, index);
+    MVD_UnlockParse();
 }
 
 static void MVD_ParsePrint(mvd_t *mvd)
@@ -599,8 +617,10 @@ static void MVD_ParsePrint(mvd_t *mvd)
     if (mvd->demoseeking)
         return;
 
+    MVD_LockParse();
     MVD_BroadcastPrintf(mvd, level, level == PRINT_CHAT ?
                         UF_MUTE_PLAYERS : 0, "%s", string);
+    MVD_UnlockParse();
 }
 
 /*
@@ -781,8 +801,12 @@ static void MVD_ParseFrame(mvd_t *mvd)
     if (!data) {
         MVD_Destroyf(mvd, "%s: read past end of message", __func__);
     }
-    if (!mvd->demoseeking)
+    if (!mvd->demoseeking) {
+        // area flood state is shared by channels on the same map
+        MVD_LockParse();
         CM_SetPortalStates(&mvd->cm, data, length);
+        MVD_UnlockParse();
+    }
 
     SHOWNET(2, "%3u:playerinfo\n", msg_read.readcount);
     MVD_ParsePacketPlayers(mvd);
@@ -1095,6 +1119,12 @@ bool MVD_ParseMessage(mvd_t *mvd)
 
         switch (cmd) {
         case mvd_serverdata:
+            // reloads the map and may respawn the server, this can't be
+            // done while other channels are parsed, leave it to main thread
+            if (mvd_threaded) {
+                mvd->deferred = msg_read.readcount - 1;
+                return ret;
+            }
             MVD_ParseServerData(mvd, extrabits);
             ret = true;
             break;
@@ -451,6 +451,8 @@ static int read_level_file(void)
             Com_Error(ERR_DROP, "Savegame configstring too long");
     }
 
+    SV_ResetConfigstringIndex();
+
     SV_ClearWorld();
 
     len = MSG_ReadByte();
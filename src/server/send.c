@@ -520,7 +520,7 @@ static bool check_entity(const client_t *client, int entnum)
 
         i = (left + right) / 2;
         j = (frame->first_entity + i) & (client->num_entities - 1);
-        j = client->entities[j].number;
+        j = ARENA_STATE(client->entities[j])->number;
         if (j < entnum)
             left = i + 1;
         else if (j > entnum)
@@ -847,6 +847,156 @@ static void write_datagram_new(client_t *client)
 }
 
 
+/*
+===============================================================================
+
+SEND PACING
+
+Instead of sending datagrams to all clients in one burst right after game
+frame, queue them and release over `sv_pace_window' milliseconds. Release
+time of each client is proportional to amount of data queued before it, so
+that outgoing byte rate stays even across the window. Queues are released
+from SV_Frame, which is woken up from NET_Sleep when next one is due.
+
+===============================================================================
+*/
+
+static bool     pace_capture;   // queue datagrams instead of sending
+static uint64_t pace_next;      // earliest pending release time, 0 if none
+
+static void pace_flush(client_t *client)
+{
+    client_pace_t *pace = &client->pace;
+    const byte *data = pace->data;
+    unsigned delay;
+
+    if (!pace->count)
+        return;
+
+    for (int i = 0; i < pace->count; i++) {
+        NET_SendPacket(client->netchan.sock, data, pace->lens[i],
+                       &client->netchan.remote_address);
+        data += pace->lens[i];
+    }
+
+    delay = Sys_Microseconds() - pace->queued;
+    pace->packets += pace->count;
+    pace->flushes++;
+    pace->total_delay += delay;
+    pace->max_delay = max(pace->max_delay, delay);
+    pace->count = 0;
+    pace->size = 0;
+}
+
+static void pace_send(void *arg, const void *data, size_t len)
+{
+    client_t *client = arg;
+    client_pace_t *pace = &client->pace;
+
+    if (pace_capture) {
+        if (!pace->data)
+            pace->data = SV_Malloc(PACE_QUEUE_SIZE);
+
+        if (pace->count < PACE_MAX_PACKETS && pace->size + len <= PACE_QUEUE_SIZE) {
+            if (!pace->count)
+                pace->queued = Sys_Microseconds();
+            memcpy(pace->data + pace->size, data, len);
+            pace->lens[pace->count++] = len;
+            pace->size += len;
+            return;
+        }
+
+        pace->overflows++;
+    }
+
+    // netchan discards out of order packets, so anything
+    // queued must go out first
+    pace_flush(client);
+    NET_SendPacket(client->netchan.sock, data, len,
+                   &client->netchan.remote_address);
+}
+
+static bool pace_enabled(const client_t *client)
+{
+    // pointless over the loopback
+    return !NET_IsLocalAddress(&client->netchan.remote_address);
+}
+
+static void pace_schedule(void)
+{
+    client_t    *client;
+    uint64_t    now, window, total, offset;
+
+    total = 0;
+    FOR_EACH_CLIENT(client) {
+        total += client->pace.size;
+    }
+
+    if (!total)
+        return;
+
+    // leave some room for the next frame
+    window = min(sv_pace_window->integer, SV_FRAMETIME / 2) * 1000;
+
+    now = Sys_Microseconds();
+    offset = 0;
+    FOR_EACH_CLIENT(client) {
+        client_pace_t *pace = &client->pace;
+        if (!pace->count)
+            continue;
+        pace->release = now + window * offset / total;
+        offset += pace->size;
+    }
+
+    pace_next = now;
+    SV_SendPacedPackets();
+}
+
+/*
+==================
+SV_SendPacedPackets
+
+Releases queued datagrams whose time has come.
+==================
+*/
+void SV_SendPacedPackets(void)
+{
+    client_t    *client;
+    uint64_t    now;
+
+    if (!pace_next)
+        return;
+
+    now = Sys_Microseconds();
+    if (now < pace_next)
+        return;
+
+    pace_next = 0;
+    FOR_EACH_CLIENT(client) {
+        client_pace_t *pace = &client->pace;
+        if (!pace->count)
+            continue;
+        if (pace->release <= now) {
+            pace_flush(client);
+            continue;
+        }
+        if (!pace_next || pace->release < pace_next)
+            pace_next = pace->release;
+    }
+}
+
+/*
+==================
+SV_PaceDeadline
+
+Returns time in microseconds when next paced queue is due, or 0 if none.
+==================
+*/
+uint64_t SV_PaceDeadline(void)
+{
+    return pace_next;
+}
+
 /*
 ===============================================================================
 
@@ -892,6 +1042,15 @@ void SV_SendClientMessages(void)
 {
     client_t    *client;
     int         cursize;
+    bool        paced = sv_pace_window->integer > 0;
+
+    // flush anything left over from previous frame
+    if (pace_next) {
+        FOR_EACH_CLIENT(client) {
+            pace_flush(client);
+        }
+        pace_next = 0;
+    }
 
     // send a message to each connected client
     FOR_EACH_CLIENT(client) {
@@ -918,6 +1077,8 @@ void SV_SendClientMessages(void)
         if (SV_RateDrop(client))
             goto advance;
 
+        pace_capture = paced && pace_enabled(client);
+
         // don't write any frame data until all fragments are sent
         if (client->netchan.fragment_pending) {
             client->frameflags |= FF_SUPPRESSED;
@@ -935,6 +1096,8 @@ void SV_SendClientMessages(void)
             write_datagram_old(client);
 
 advance:
+        pace_capture = false;
+
         // advance for next frame
         client->framenum++;
 
@@ -942,6 +1105,9 @@ finish:
         // clear all unreliable messages still left
         finish_frame(client);
     }
+
+    if (paced)
+        pace_schedule();
 }
 
 static void write_pending_download(client_t *client)
@@ -1054,6 +1220,10 @@ void SV_InitClientSend(client_t *newcl)
         List_Append(&newcl->msg_free_list, &newcl->msg_pool[i].entry);
     }
 
+    // queue datagrams when pacing
+    newcl->netchan.send_cb = pace_send;
+    newcl->netchan.send_arg = newcl;
+
     // setup protocol
     if (newcl->netchan.type == NETCHAN_NEW) {
         newcl->AddMessage = add_message_new;
@@ -1066,6 +1236,9 @@ void SV_ShutdownClientSend(client_t *client)
 {
     free_all_messages(client);
 
+    Z_Free(client->pace.data);
+    memset(&client->pace, 0, sizeof(client->pace));
+
     Z_Freep(&client->msg_pool);
     List_Init(&client->msg_free_list);
 }
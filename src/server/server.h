@@ -103,6 +103,39 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define MVD_SPAWN_INTERNAL  BIT(31)
 #define MVD_SPAWN_MASK      (MVD_SPAWN_ENABLED | MVD_SPAWN_INTERNAL)
 
+#define CS_INDEX_HASH_SIZE  1024
+
+// hash of non-empty configstrings in one index range
+typedef struct {
+    bool        built;
+    int         start, max, skip;
+    int         first_free;     // first empty slot, allocated next
+    uint16_t    heads[CS_INDEX_HASH_SIZE];
+} cs_index_t;
+
+#define INFO_CACHE_PAIRS    128
+#define INFO_CACHE_HASH     256
+
+// parsed userinfo key/value pairs, rebuilt on first lookup after change
+typedef struct {
+    bool        valid;
+    bool        overflowed;     // too many pairs, lookups are not cached
+    int         numpairs;
+    uint8_t     hash[INFO_CACHE_HASH];      // pair index + 1
+    uint16_t    keys[INFO_CACHE_PAIRS];     // offsets into buffer
+    uint16_t    values[INFO_CACHE_PAIRS];
+    char        buffer[MAX_INFO_STRING];
+} info_cache_t;
+
+// counters for hashed lookups
+typedef struct {
+    uint64_t    index_lookups;  // PF_FindIndex calls
+    uint64_t    index_scanned;  // strings linear scan would have compared
+    uint64_t    index_compared; // strings actually compared
+    uint64_t    info_lookups;   // SV_UserinfoValue calls
+    uint64_t    info_parses;    // userinfo strings parsed
+} lookup_stats_t;
+
 typedef struct {
     int         number;
     int         num_entities;
@@ -113,8 +146,20 @@ typedef struct {
     byte        areabits[MAX_MAP_AREA_BYTES];  // portalarea visibility bits
     unsigned    sentTime;                   // for ping calculations
     int         latency;
+    unsigned    key;                        // nonzero if entities are shared
+    unsigned    arena_base;                 // oldest state referenced in svs.arena
 } client_frame_t;
 
+// packed entity states referenced by client frames, shared by all clients
+// and overwritten in ring buffer order. Handles are absolute positions.
+typedef struct {
+    entity_packed_t *states;    // [size]
+    unsigned        size;       // power of two
+    unsigned        next;       // handle of next state to allocate
+} entity_arena_t;
+
+#define ARENA_STATE(h)  (&svs.arena.states[(h) & (svs.arena.size - 1)])
+
 typedef struct {
     int         solid32;
 
@@ -161,6 +206,7 @@ typedef struct {
 
     int         framenum;
     unsigned    frameresidual;
+    uint64_t    framedeadline;  // next frame start time for sv_hires_timer
 
     char        mapcmd[MAX_QPATH];          // ie: *intro.cin+base
 
@@ -169,6 +215,10 @@ typedef struct {
 
     configstring_t  configstrings[MAX_CONFIGSTRINGS];
 
+    // hashed model, sound and image indices for PF_FindIndex
+    cs_index_t      csindex[3];
+    uint16_t        csnext[MAX_CONFIGSTRINGS];  // hash chains
+
     server_entity_t entities[MAX_EDICTS];
 } server_t;
 
@@ -238,6 +288,26 @@ typedef struct {
 
 #define RATE_MESSAGES   10
 
+#define PACE_MAX_PACKETS    8
+#define PACE_QUEUE_SIZE     (MAX_PACKETLEN * 4)
+
+// datagrams queued for paced transmission
+typedef struct {
+    byte        *data;          // PACE_QUEUE_SIZE bytes, allocated on demand
+    unsigned    size;
+    unsigned    lens[PACE_MAX_PACKETS];
+    int         count;
+    uint64_t    queued;         // Sys_Microseconds() when first packet queued
+    uint64_t    release;        // Sys_Microseconds() when queue is to be sent
+
+    // statistics
+    unsigned    packets;        // total packets released
+    unsigned    flushes;        // total queues released
+    unsigned    overflows;      // packets sent immediately due to full queue
+    unsigned    max_delay;
+    uint64_t    total_delay;
+} client_pace_t;
+
 #define FOR_EACH_CLIENT(client) \
     LIST_FOR_EACH(client_t, client, &sv_clientlist, entry)
 
@@ -278,6 +348,7 @@ typedef struct client_s {
 
     // userinfo
     char            userinfo[MAX_INFO_STRING];  // name, etc
+    info_cache_t    infocache;                  // parsed userinfo
     char            name[MAX_CLIENT_NAME];      // extracted from userinfo, high bits masked
     int             messagelevel;               // for filtering printed messages
     unsigned        rate;
@@ -317,6 +388,7 @@ typedef struct client_s {
     unsigned        message_size[RATE_MESSAGES];    // used to rate drop normal packets
     int             suppress_count;                 // number of messages rate suppressed
     unsigned        send_time, send_delta;          // used to rate drop async packets
+    client_pace_t   pace;                           // used by sv_pace_window
 
     // current download
     byte            *download;      // file being downloaded
@@ -346,11 +418,12 @@ typedef struct client_s {
 
     // per-client baseline chunks
     entity_packed_t     *baselines[SV_BASELINES_CHUNKS];
+    uint64_t            baselines_hash; // equal for equal baselines
 
     // per-client packet entities
     unsigned            num_entities;   // UPDATE_BACKUP*MAX_PACKET_ENTITIES(_OLD)
     unsigned            next_entity;    // next state to use
-    entity_packed_t     *entities;      // [num_entities]
+    unsigned            *entities;      // [num_entities], handles in svs.arena
 
     // server state pointers (hack for MVD channels implementation)
     const configstring_t    *configstrings;
@@ -493,6 +566,10 @@ typedef struct {
     ratelimit_t     ratelimit_rcon;
 
     challenge_t     challenges[MAX_CHALLENGES]; // to prevent invalid IPs from connecting
+
+    entity_arena_t  arena;
+
+    lookup_stats_t  lookups;
 } server_static_t;
 
 //=============================================================================
@@ -522,6 +599,8 @@ extern cvar_t       *sv_enforcetime;
 #if USE_FPS
 extern cvar_t       *sv_fps;
 #endif
+extern cvar_t       *sv_hires_timer;
+extern cvar_t       *sv_pace_window;
 extern cvar_t       *sv_force_reconnect;
 extern cvar_t       *sv_iplimit;
 
@@ -537,6 +616,7 @@ extern cvar_t       *sv_max_download_size;
 extern cvar_t       *sv_max_packet_entities;
 extern cvar_t       *sv_trunc_packet_entities;
 extern cvar_t       *sv_prioritize_entities;
+extern cvar_t       *sv_share_frames;
 
 extern cvar_t       *sv_strafejump_hack;
 #if USE_PACKETDUP
@@ -579,6 +659,7 @@ void SV_CleanClient(client_t *client);
 void SV_InitOperatorCommands(void);
 
 void SV_UserinfoChanged(client_t *cl);
+const char *SV_UserinfoValue(client_t *cl, const char *key);
 
 bool SV_RateLimited(ratelimit_t *r);
 void SV_RateRecharge(ratelimit_t *r);
@@ -588,6 +669,8 @@ addrmatch_t *SV_MatchAddress(const list_t *list, const netadr_t *address);
 
 int SV_CountClients(void);
 
+void SV_FrameJitter_f(void);
+
 #if USE_ZLIB
 voidpf SV_zalloc(voidpf opaque, uInt items, uInt size);
 void SV_zfree(voidpf opaque, voidpf address);
@@ -624,6 +707,8 @@ void SV_FlushRedirect(int redirected, const char *outputbuf, size_t len);
 
 void SV_SendClientMessages(void);
 void SV_SendAsyncPackets(void);
+void SV_SendPacedPackets(void);
+uint64_t SV_PaceDeadline(void);
 
 void SV_Multicast(const vec3_t origin, multicast_t to);
 void SV_ClientPrintf(client_t *cl, int level, const char *fmt, ...) q_printf(3, 4);
@@ -659,6 +744,15 @@ void SV_MvdStartSound(int entnum, int channel, int flags,
 
 void SV_MvdRecord_f(void);
 void SV_MvdStop_f(void);
+#if USE_MVD_CLIENT
+void SV_MvdRelayInit(void);
+void SV_MvdRelayData(int id, const void *data, size_t len);
+void SV_MvdRelayReset(int id);
+#else
+#define SV_MvdRelayInit()               (void)0
+#define SV_MvdRelayData(id, data, len)  (void)0
+#define SV_MvdRelayReset(id)            (void)0
+#endif
 #else
 #define SV_MvdRegister()            (void)0
 #define SV_MvdPreInit()             (void)0
@@ -681,6 +775,9 @@ void SV_MvdStop_f(void);
 
 #define SV_MvdRecord_f()    (void)0
 #define SV_MvdStop_f()      (void)0
+#define SV_MvdRelayInit()               (void)0
+#define SV_MvdRelayData(id, data, len)  (void)0
+#define SV_MvdRelayReset(id)            (void)0
 #endif
 
 //
@@ -762,6 +859,8 @@ static inline void SV_CheckEntityNumber(edict_t *ent, int e, const char *func)
 
 #define SV_CheckEntityNumber(ent, e) SV_CheckEntityNumber(ent, e, __func__)
 
+void SV_InitEntityArena(void);
+void SV_FreeEntityArena(void);
 void SV_BuildClientFrame(client_t *client);
 bool SV_WriteFrameToClient_Default(client_t *client, unsigned maxsize);
 bool SV_WriteFrameToClient_Enhanced(client_t *client, unsigned maxsize);
@@ -774,6 +873,8 @@ extern const game_export_ex_t   *gex;
 
 void SV_InitGameProgs(void);
 void SV_ShutdownGameProgs(void);
+void SV_ResetConfigstringIndex(void);
+void SV_LookupStats_f(void);
 
 void PF_Pmove(void *pm);
 
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // sv_user.c -- server code for moving users
 
 #include "server.h"
+#include "common/mdfour.h"
 
 #define MSG_GAMESTATE   (MSG_RELIABLE | MSG_CLEAR | MSG_COMPRESS)
 
@@ -46,6 +47,10 @@ static void SV_CreateBaselines(void)
     int        i;
     edict_t    *ent;
     entity_packed_t *base, **chunk;
+    struct mdfour md;
+    byte       digest[16];
+
+    mdfour_begin(&md);
 
     // clear baselines from previous level
     for (i = 0; i < SV_BASELINES_CHUNKS; i++) {
@@ -96,7 +101,13 @@ static void SV_CreateBaselines(void)
         if (sv_client->esFlags & MSG_ES_LONGSOLID && !sv_client->csr->extended) {
             base->solid = sv.entities[i].solid32;
         }
+
+        mdfour_update(&md, (const byte *)base, sizeof(*base));
     }
+
+    // allows sharing encoded frames between clients
+    mdfour_result(&md, digest);
+    memcpy(&sv_client->baselines_hash, digest, sizeof(sv_client->baselines_hash));
 }
 
 static void maybe_flush_msg(size_t size)
@@ -1386,7 +1397,10 @@ Ensures that userinfo is valid and name is properly set.
 */
 static void SV_UpdateUserinfo(void)
 {
-    char *s;
+    char s[MAX_CLIENT_NAME];
+
+    // userinfo was just rewritten by client
+    sv_client->infocache.valid = false;
 
     if (!sv_client->userinfo[0]) {
         SV_DropClient(sv_client, "empty userinfo");
@@ -1399,8 +1413,7 @@ static void SV_UpdateUserinfo(void)
     }
 
     // validate name
-    s = Info_ValueForKey(sv_client->userinfo, "name");
-    s[MAX_CLIENT_NAME - 1] = 0;
+    Q_strlcpy(s, SV_UserinfoValue(sv_client, "name"), sizeof(s));
     if (COM_IsWhite(s) || (sv_client->name[0] && strcmp(sv_client->name, s) &&
                            SV_RateLimited(&sv_client->ratelimit_namechange))) {
         if (!sv_client->name[0]) {
@@ -1411,6 +1424,7 @@ static void SV_UpdateUserinfo(void)
             SV_DropClient(sv_client, "oversize userinfo");
             return;
         }
+        sv_client->infocache.valid = false;
         if (COM_IsWhite(s))
             SV_ClientPrintf(sv_client, PRINT_HIGH, "You can't have an empty name.\n");
         else
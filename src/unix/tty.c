@@ -624,8 +624,11 @@ void Sys_RunConsole(void)
         return;
     }
 
-    // make sure the next call will not block
-    tty_input->revents = 0;
+    // keep reading on the next call if buffer was filled, events may be
+    // edge-triggered
+    if (ret < (int)sizeof(text) - 1) {
+        tty_input->revents = 0;
+    }
 
     if (ret < 0) {
         if (errno == EAGAIN || errno == EIO) {